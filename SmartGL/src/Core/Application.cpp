@@ -2,6 +2,7 @@
 
 #include "Core/Application.h"
 #include "Core/Assert.h"
+#include "Core/JobSystem.h"
 #include "Core/Time.h"
 
 #include "Renderer/Renderer.h"
@@ -26,6 +27,7 @@ namespace SmartGL
             m_Window->SetEventCallback(BIND_EVENT_FN(Application::OnEvent));
 
             Renderer::Init();
+            JobSystem::Init();
 
             m_UILayer = new UI::UILayer();
             PushOverlay(m_UILayer);
@@ -33,6 +35,7 @@ namespace SmartGL
 
         Application::~Application()
         {
+            JobSystem::Shutdown();
         }
 
         void Application::Run()
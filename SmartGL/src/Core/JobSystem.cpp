@@ -0,0 +1,201 @@
+#include "precompiled.h"
+
+#include "Core/JobSystem.h"
+#include "Core/TypesDefinitions.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace SmartGL
+{
+    namespace Core
+    {
+        using Job = std::function<void()>;
+
+        struct WorkerQueue
+        {
+            std::mutex Mutex;
+            std::deque<Job> Jobs;
+        };
+
+        struct JobSystemData
+        {
+            std::vector<std::thread> Workers;
+            std::vector<Unique<WorkerQueue>> Queues; // one per worker
+
+            std::mutex SleepMutex;
+            std::condition_variable WakeUp;
+
+            std::atomic<bool> Running{false};
+            std::atomic<uint32_t> QueuedJobs{0};
+            std::atomic<uint32_t> NextQueue{0};
+        };
+
+        static JobSystemData s_Data;
+        static std::mutex s_InitMutex;
+        static bool s_ShutdownRegistered = false; // guarded by s_InitMutex
+
+        // the owner pops the most recent job (still in cache), thieves take the oldest one
+        static bool PopJob(uint32_t queueIndex, Job &job)
+        {
+            WorkerQueue &queue = *s_Data.Queues[queueIndex];
+            std::lock_guard<std::mutex> lock(queue.Mutex);
+
+            if (queue.Jobs.empty())
+                return false;
+
+            job = std::move(queue.Jobs.back());
+            queue.Jobs.pop_back();
+            return true;
+        }
+
+        static bool StealJob(uint32_t thiefIndex, Job &job)
+        {
+            uint32_t queuesCount = s_Data.Queues.size();
+
+            for (uint32_t i = 1; i <= queuesCount; i++)
+            {
+                WorkerQueue &queue = *s_Data.Queues[(thiefIndex + i) % queuesCount];
+                std::lock_guard<std::mutex> lock(queue.Mutex);
+
+                if (queue.Jobs.empty())
+                    continue;
+
+                job = std::move(queue.Jobs.front());
+                queue.Jobs.pop_front();
+                return true;
+            }
+
+            return false;
+        }
+
+        static bool RunOneJob(uint32_t queueIndex)
+        {
+            Job job;
+            if (!PopJob(queueIndex, job) && !StealJob(queueIndex, job))
+                return false;
+
+            s_Data.QueuedJobs--;
+            job();
+            return true;
+        }
+
+        static void WorkerLoop(uint32_t workerIndex)
+        {
+            while (s_Data.Running)
+            {
+                if (RunOneJob(workerIndex))
+                    continue;
+
+                std::unique_lock<std::mutex> lock(s_Data.SleepMutex);
+                s_Data.WakeUp.wait(lock, []
+                                   { return !s_Data.Running || s_Data.QueuedJobs > 0; });
+            }
+        }
+
+        void JobSystem::Init(uint32_t workersCount)
+        {
+            std::lock_guard<std::mutex> lock(s_InitMutex);
+
+            if (s_Data.Running)
+                return;
+
+            if (workersCount == 0)
+            {
+                uint32_t hardwareThreads = std::thread::hardware_concurrency();
+                workersCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+            }
+
+            s_Data.Queues.clear();
+            for (uint32_t i = 0; i < workersCount; i++)
+                s_Data.Queues.push_back(CreateUnique<WorkerQueue>());
+
+            s_Data.Running = true;
+            for (uint32_t i = 0; i < workersCount; i++)
+                s_Data.Workers.emplace_back(WorkerLoop, i);
+
+            // stop the workers before the static data is destroyed
+            if (!s_ShutdownRegistered)
+                s_ShutdownRegistered = (std::atexit(Shutdown) == 0);
+        }
+
+        void JobSystem::Shutdown()
+        {
+            std::lock_guard<std::mutex> lock(s_InitMutex);
+
+            {
+                std::lock_guard<std::mutex> sleepLock(s_Data.SleepMutex);
+                s_Data.Running = false;
+            }
+            s_Data.WakeUp.notify_all();
+
+            for (std::thread &worker : s_Data.Workers)
+                worker.join();
+
+            s_Data.Workers.clear();
+            s_Data.Queues.clear();
+            s_Data.QueuedJobs = 0;
+        }
+
+        uint32_t JobSystem::GetWorkersCount()
+        {
+            return s_Data.Workers.size();
+        }
+
+        void JobSystem::ParallelFor(uint32_t count, uint32_t chunkSize, const std::function<void(uint32_t, uint32_t)> &function)
+        {
+            if (count == 0)
+                return;
+
+            if (!s_Data.Running)
+                Init();
+
+            chunkSize = chunkSize > 0 ? chunkSize : 1;
+
+            // nothing to share, run on the calling thread
+            if (count <= chunkSize || s_Data.Queues.empty())
+            {
+                function(0, count);
+                return;
+            }
+
+            uint32_t chunksCount = (count + chunkSize - 1) / chunkSize;
+            std::atomic<uint32_t> remainingChunks{chunksCount};
+
+            // contiguous chunks go to the same worker, the others will steal what they need
+            uint32_t queuesCount = s_Data.Queues.size();
+            uint32_t firstQueue = s_Data.NextQueue++;
+            uint32_t chunksPerQueue = (chunksCount + queuesCount - 1) / queuesCount;
+
+            for (uint32_t chunk = 0; chunk < chunksCount; chunk++)
+            {
+                uint32_t begin = chunk * chunkSize;
+                uint32_t end = std::min(begin + chunkSize, count);
+
+                WorkerQueue &queue = *s_Data.Queues[(firstQueue + chunk / chunksPerQueue) % queuesCount];
+                std::lock_guard<std::mutex> lock(queue.Mutex);
+                queue.Jobs.push_front([&function, &remainingChunks, begin, end]()
+                                      {
+                                          function(begin, end);
+                                          remainingChunks--;
+                                      });
+                s_Data.QueuedJobs++;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(s_Data.SleepMutex);
+            }
+            s_Data.WakeUp.notify_all();
+
+            // help until every chunk of this call is done (this also makes nested calls safe)
+            while (remainingChunks > 0)
+            {
+                if (!RunOneJob(firstQueue % queuesCount))
+                    std::this_thread::yield();
+            }
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+namespace SmartGL
+{
+    namespace Core
+    {
+        /**
+         * @brief Shared pool of worker threads, each worker owns a queue and steals from the others when it runs dry
+         * @note The pool is started on first use with one worker per hardware thread (the calling thread is the last one)
+         */
+        class JobSystem
+        {
+        public:
+            /**
+             * @brief Start the workers, does nothing if the pool is already running
+             * @param workersCount The number of worker threads, 0 to use the number of hardware threads - 1
+             */
+            static void Init(uint32_t workersCount = 0);
+
+            /**
+             * @brief Stop and join the workers
+             */
+            static void Shutdown();
+
+            static uint32_t GetWorkersCount();
+
+            /**
+             * @brief Split [0, count) in chunks of chunkSize and run function(begin, end) on each chunk
+             * @note Blocks until every chunk is done, the calling thread runs chunks as well.
+             * The chunks are disjoint so results written by index are deterministic whatever thread runs them.
+             * @param count The size of the range
+             * @param chunkSize The number of items per job
+             * @param function Called with the [begin, end) range of a chunk
+             */
+            static void ParallelFor(uint32_t count, uint32_t chunkSize, const std::function<void(uint32_t, uint32_t)> &function);
+        };
+    }
+}
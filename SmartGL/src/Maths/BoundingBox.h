@@ -0,0 +1,96 @@
+#pragma once
+
+#include <limits>
+
+#include "glm/glm.hpp"
+
+namespace SmartGL
+{
+    namespace Maths
+    {
+        /**
+         * @brief Axis aligned bounding box, empty (Min > Max) until a point is added
+         */
+        struct BoundingBox
+        {
+            glm::vec3 Min = glm::vec3(std::numeric_limits<float>::max());
+            glm::vec3 Max = glm::vec3(-std::numeric_limits<float>::max());
+
+            inline void Expand(const glm::vec3 &point)
+            {
+                Min = glm::min(Min, point);
+                Max = glm::max(Max, point);
+            }
+
+            inline void Expand(const BoundingBox &box)
+            {
+                Min = glm::min(Min, box.Min);
+                Max = glm::max(Max, box.Max);
+            }
+
+            inline bool IsEmpty() const { return Min.x > Max.x; }
+            inline glm::vec3 GetCenter() const { return 0.5f * (Min + Max); }
+            inline glm::vec3 GetSize() const { return Max - Min; }
+
+            /**
+             * @brief Squared distance from a point to the box, 0 inside (very large for an empty box)
+             */
+            inline float Distance2(const glm::vec3 &point) const
+            {
+                glm::vec3 offset = glm::max(glm::max(Min - point, point - Max), glm::vec3(0.0f));
+                return glm::dot(offset, offset);
+            }
+
+            /**
+             * @brief Distance along a ray where it enters the box (slabs test)
+             * @param origin The origin of the ray
+             * @param inverseDirection 1 / direction of the ray, per component
+             * @param maxDistance The end of the ray
+             * @param enter Output, the distance where the ray enters the box (0 if its origin is inside)
+             * @return False if the ray misses the box before maxDistance (always for an empty box)
+             */
+            inline bool IntersectRay(const glm::vec3 &origin, const glm::vec3 &inverseDirection, float maxDistance, float &enter) const
+            {
+                if (IsEmpty())
+                    return false;
+
+                glm::vec3 t0 = (Min - origin) * inverseDirection;
+                glm::vec3 t1 = (Max - origin) * inverseDirection;
+                glm::vec3 tMin = glm::min(t0, t1);
+                glm::vec3 tMax = glm::max(t0, t1);
+                enter = glm::max(glm::max(tMin.x, tMin.y), glm::max(tMin.z, 0.0f));
+                float exit = glm::min(glm::min(tMax.x, tMax.y), glm::min(tMax.z, maxDistance));
+                return enter <= exit;
+            }
+
+            /**
+             * @brief Lower bound of the distance from a ray to the box
+             * @note 0 when the ray crosses the box (slabs test), the distance to the bounding sphere of the box otherwise
+             * @param origin The origin of the ray
+             * @param direction The normalized direction of the ray
+             */
+            inline float RayDistanceLowerBound(const glm::vec3 &origin, const glm::vec3 &direction) const
+            {
+                if (IsEmpty())
+                    return std::numeric_limits<float>::max();
+
+                // slabs test, the divisions by 0 give infinities that the min/max handle
+                glm::vec3 inverseDirection = 1.0f / direction;
+                glm::vec3 t0 = (Min - origin) * inverseDirection;
+                glm::vec3 t1 = (Max - origin) * inverseDirection;
+                glm::vec3 tMin = glm::min(t0, t1);
+                glm::vec3 tMax = glm::max(t0, t1);
+                float enter = glm::max(glm::max(tMin.x, tMin.y), glm::max(tMin.z, 0.0f));
+                float exit = glm::min(glm::min(tMax.x, tMax.y), tMax.z);
+                if (enter <= exit)
+                    return 0.0f;
+
+                glm::vec3 center = GetCenter();
+                float radius = 0.5f * glm::length(GetSize());
+                glm::vec3 offset = center - origin;
+                float along = glm::max(glm::dot(offset, direction), 0.0f);
+                return glm::max(glm::length(offset - along * direction) - radius, 0.0f);
+            }
+        };
+    }
+}
@@ -4,31 +4,75 @@
 
 #include "glad/gl.h"
 
+#include <limits>
+
 namespace SmartGL
 {
 
+    // GrowableBuffer
+
+    GrowableBuffer::GrowableBuffer(uint32_t capacity, const void *data)
+        : m_Capacity(capacity), m_Size(data ? capacity : 0)
+    {
+        // mutable storage, it is reallocated under the same name when it grows
+        glCreateBuffers(1, &m_RendererID);
+        glNamedBufferData(m_RendererID, capacity, data, GL_DYNAMIC_DRAW);
+    }
+
+    GrowableBuffer::~GrowableBuffer()
+    {
+        glDeleteBuffers(1, &m_RendererID);
+    }
+
+    void GrowableBuffer::Reserve(uint32_t size)
+    {
+        if (size <= m_Capacity)
+            return;
+
+        uint64_t capacity = std::max<uint64_t>(size, (uint64_t)(m_Capacity * GrowthFactor));
+        m_Capacity = (uint32_t)std::min<uint64_t>(capacity, std::numeric_limits<uint32_t>::max());
+        m_Size = 0;
+
+        glNamedBufferData(m_RendererID, m_Capacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    void GrowableBuffer::Upload(uint32_t size, const void *data)
+    {
+        if (size > m_Capacity)
+            Reserve(size);
+        else if (IsStreaming() && m_Size > 0)
+            glInvalidateBufferData(m_RendererID);
+
+        m_Size = size;
+        Update(0, size, data);
+    }
+
+    void GrowableBuffer::Update(uint32_t offset, uint32_t size, const void *data)
+    {
+        SMART_ASSERT(offset + size <= m_Size, "The updated range must be inside the uploaded data");
+
+        glNamedBufferSubData(m_RendererID, offset, size, data);
+    }
+
     // VertexBuffer
 
     VertexBuffer::VertexBuffer(uint32_t size)
+        : m_Storage(size)
     {
-        glCreateBuffers(1, &m_RendererID);
-        glNamedBufferStorage(m_RendererID, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
     }
 
     VertexBuffer::VertexBuffer(uint32_t size, const void *vertices)
+        : m_Storage(size, vertices)
     {
-        glCreateBuffers(1, &m_RendererID);
-        glNamedBufferStorage(m_RendererID, size, vertices, GL_DYNAMIC_STORAGE_BIT);
     }
 
     VertexBuffer::~VertexBuffer()
     {
-        glDeleteBuffers(1, &m_RendererID);
     }
 
     void VertexBuffer::Bind() const
     {
-        glBindBuffer(GL_ARRAY_BUFFER, m_RendererID);
+        glBindBuffer(GL_ARRAY_BUFFER, m_Storage.GetRendererID());
     }
 
     void VertexBuffer::Unbind() const
@@ -38,33 +82,28 @@ namespace SmartGL
 
     void VertexBuffer::SetData(uint32_t size, const void *data)
     {
-        glNamedBufferSubData(m_RendererID, 0, size, data);
+        m_Storage.Upload(size, data);
     }
 
     // IndexBuffer
 
     IndexBuffer::IndexBuffer(uint32_t count)
-        : m_Count(count)
+        : m_Storage(count * sizeof(uint32_t)), m_Count(count)
     {
-        glCreateBuffers(1, &m_RendererID);
-        glNamedBufferStorage(m_RendererID, count * sizeof(uint32_t), nullptr, GL_DYNAMIC_STORAGE_BIT);
     }
 
     IndexBuffer::IndexBuffer(uint32_t *indices, uint32_t count)
-        : m_Count(count)
+        : m_Storage(count * sizeof(uint32_t), indices), m_Count(count)
     {
-        glCreateBuffers(1, &m_RendererID);
-        glNamedBufferStorage(m_RendererID, count * sizeof(uint32_t), indices, GL_DYNAMIC_STORAGE_BIT);
     }
 
     IndexBuffer::~IndexBuffer()
     {
-        glDeleteBuffers(1, &m_RendererID);
     }
 
     void IndexBuffer::Bind() const
     {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_RendererID);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Storage.GetRendererID());
     }
 
     void IndexBuffer::Unbind() const
@@ -73,8 +112,14 @@ namespace SmartGL
     }
 
     void IndexBuffer::SetData(uint32_t count, const void *data)
+    {
+        SetData(count, data, m_Type);
+    }
+
+    void IndexBuffer::SetData(uint32_t count, const void *data, IndexType type)
     {
         m_Count = count;
-        glNamedBufferSubData(m_RendererID, 0, count * sizeof(uint32_t), data);
+        m_Type = type;
+        m_Storage.Upload(count * IndexTypeSize(type), data);
     }
 }
@@ -88,9 +88,65 @@ namespace SmartGL
         uint32_t m_Stride = 0;
     };
 
+    /**
+     * @brief GPU storage that grows when the data uploaded to it does not fit
+     * @note The storage grows geometrically (GrowthFactor) and is only reallocated on overflow. The buffer keeps its
+     * name when it grows, the vertex arrays referencing it stay valid.
+     * In streaming mode the previous content is invalidated before each upload, the driver does not wait for the draws
+     * still reading it.
+     */
+    class GrowableBuffer
+    {
+    public:
+        GrowableBuffer(uint32_t capacity, const void *data = nullptr);
+        ~GrowableBuffer();
+
+        GrowableBuffer(const GrowableBuffer &) = delete;
+        GrowableBuffer &operator=(const GrowableBuffer &) = delete;
+
+        /**
+         * @brief Replace the content of the buffer by size bytes, growing the storage if needed
+         */
+        void Upload(uint32_t size, const void *data);
+
+        /**
+         * @brief Replace a range of the content, the range must be inside the last uploaded data
+         */
+        void Update(uint32_t offset, uint32_t size, const void *data);
+
+        /**
+         * @brief Make sure size bytes fit in the storage, the content is lost if it grows
+         */
+        void Reserve(uint32_t size);
+
+        /**
+         * @brief Enable or disable the streaming mode
+         */
+        inline void SetStreaming(bool streaming) { m_Streaming = streaming; }
+        inline bool IsStreaming() const { return m_Streaming; }
+
+        inline uint32_t GetRendererID() const { return m_RendererID; }
+        inline uint32_t GetCapacity() const { return m_Capacity; }
+        inline uint32_t GetSize() const { return m_Size; }
+
+        /**
+         * @brief The factor applied to the capacity when the storage grows
+         */
+        static constexpr float GrowthFactor = 1.5f;
+
+    private:
+        uint32_t m_RendererID;
+        uint32_t m_Capacity = 0;
+        uint32_t m_Size = 0;
+        bool m_Streaming = false;
+    };
+
     class VertexBuffer
     {
     public:
+        /**
+         * @brief Create a vertex buffer with room for size bytes, it grows when more data is set
+         */
         VertexBuffer(uint32_t size);
         VertexBuffer(uint32_t size, const void *vertices);
         ~VertexBuffer();
@@ -99,19 +155,44 @@ namespace SmartGL
         void Unbind() const;
 
         const BufferLayout &GetLayout() const { return m_Layout; }
-        uint32_t GetRendererID() const { return m_RendererID; }
+        uint32_t GetRendererID() const { return m_Storage.GetRendererID(); }
+        uint32_t GetCapacity() const { return m_Storage.GetCapacity(); }
 
         void SetData(uint32_t size, const void *data);
         void SetLayout(const BufferLayout &layout) { m_Layout = layout; }
 
+        /**
+         * @brief Replace size bytes of the data at offset, the rest of the data is kept
+         */
+        void UpdateData(uint32_t offset, uint32_t size, const void *data) { m_Storage.Update(offset, size, data); }
+
+        /**
+         * @brief Invalidate the previous data before each upload (see GrowableBuffer)
+         */
+        void SetStreaming(bool streaming = true) { m_Storage.SetStreaming(streaming); }
+
     private:
-        uint32_t m_RendererID;
+        GrowableBuffer m_Storage;
         BufferLayout m_Layout;
     };
 
+    enum class IndexType
+    {
+        UInt16,
+        UInt32
+    };
+
+    inline uint32_t IndexTypeSize(IndexType type)
+    {
+        return type == IndexType::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
     class IndexBuffer
     {
     public:
+        /**
+         * @brief Create an index buffer with room for count 32 bits indices (twice as many 16 bits ones), it grows when more indices are set
+         */
         IndexBuffer(uint32_t count);
         IndexBuffer(uint32_t *indices, uint32_t count);
         ~IndexBuffer();
@@ -120,12 +201,24 @@ namespace SmartGL
         void Unbind() const;
 
         uint32_t GetCount() const { return m_Count; }
-        uint32_t GetRendererID() const { return m_RendererID; }
+        uint32_t GetRendererID() const { return m_Storage.GetRendererID(); }
+        IndexType GetIndexType() const { return m_Type; }
 
         void SetData(uint32_t count, const void *data);
 
+        /**
+         * @brief Upload indices of another type, the draw calls read the indices with this type afterwards
+         */
+        void SetData(uint32_t count, const void *data, IndexType type);
+
+        /**
+         * @brief Invalidate the previous indices before each upload (see GrowableBuffer)
+         */
+        void SetStreaming(bool streaming = true) { m_Storage.SetStreaming(streaming); }
+
     private:
-        uint32_t m_RendererID;
+        GrowableBuffer m_Storage;
         uint32_t m_Count;
+        IndexType m_Type = IndexType::UInt32;
     };
 }
@@ -105,6 +105,9 @@ namespace SmartGL
         glEnable(GL_DEPTH_TEST);
         glEnable(GL_LINE_SMOOTH);
         glEnable(GL_PROGRAM_POINT_SIZE);
+
+        // 0xFFFF or 0xFFFFFFFF (depending on the index type) ends a strip, a value never used as an index otherwise
+        glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
     }
 
     void RenderCommand::SetViewport(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
@@ -130,11 +133,25 @@ namespace SmartGL
         glClear(mask);
     }
 
+    static uint32_t GetGLIndexType(IndexType type)
+    {
+        return type == IndexType::UInt16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
     void RenderCommand::DrawIndexed(const Shared<VertexArray> &vertexArray, uint32_t indexCount)
     {
         vertexArray->Bind();
-        uint32_t count = indexCount ? indexCount : vertexArray->GetIndexBuffer()->GetCount();
-        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, nullptr);
+        const Shared<IndexBuffer> &indexBuffer = vertexArray->GetIndexBuffer();
+        uint32_t count = indexCount ? indexCount : indexBuffer->GetCount();
+        glDrawElements(GL_TRIANGLES, count, GetGLIndexType(indexBuffer->GetIndexType()), nullptr);
+    }
+
+    void RenderCommand::DrawIndexedStrips(const Shared<VertexArray> &vertexArray, uint32_t indexCount)
+    {
+        vertexArray->Bind();
+        const Shared<IndexBuffer> &indexBuffer = vertexArray->GetIndexBuffer();
+        uint32_t count = indexCount ? indexCount : indexBuffer->GetCount();
+        glDrawElements(GL_TRIANGLE_STRIP, count, GetGLIndexType(indexBuffer->GetIndexType()), nullptr);
     }
 
     void RenderCommand::DrawQuadIndexed(const Shared<VertexArray> &vertexArray, uint32_t indexCount)
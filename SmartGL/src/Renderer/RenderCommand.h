@@ -27,6 +27,11 @@ namespace SmartGL
         static void Clear(std::initializer_list<RenderBuffer> buffers);
 
         static void DrawIndexed(const Shared<VertexArray> &vertexArray, uint32_t indexCount = 0);
+
+        /**
+         * @brief Draw indexed triangle strips, the maximum value of the index type restarts a strip
+         */
+        static void DrawIndexedStrips(const Shared<VertexArray> &vertexArray, uint32_t indexCount = 0);
         static void DrawQuadIndexed(const Shared<VertexArray> &vertexArray, uint32_t indexCount = 0);
         static void DrawTriangles(const Shared<VertexArray> &vertexArray, uint32_t vertexCount, uint32_t first = 0);
         static void DrawPoints(const Shared<VertexArray> &vertexArray, uint32_t vertexCount, uint32_t first = 0);
@@ -6,6 +6,7 @@
 #include "Core/Input.h"
 #include "Core/Time.h"
 #include "Core/Random.h"
+#include "Core/JobSystem.h"
 
 #include "Events/Event.h"
 #include "Events/MouseEvent.h"
@@ -42,6 +43,7 @@
 #include "Maths/Interpolation.h"
 #include "Maths/Transform.h"
 #include "Maths/Geometry.h"
+#include "Maths/BoundingBox.h"
 
 #include "UI/UIUtils.h"
 
@@ -0,0 +1,45 @@
+#type vertex
+#version 450 core
+
+layout(location=0)in vec3 a_Position;
+layout(location=1)in vec3 a_Normal;
+
+layout(std140,binding=0)uniform Camera
+{
+	mat4 u_ViewProjection;
+};
+
+struct VertexOutput
+{
+	vec3 Normal;
+};
+
+layout(location=0)out VertexOutput Output;
+
+void main()
+{
+	Output.Normal=a_Normal;
+	gl_Position=u_ViewProjection*vec4(a_Position,1.);
+}
+
+#type fragment
+#version 450 core
+
+struct VertexOutput
+{
+	vec3 Normal;
+};
+
+layout(location=0)in VertexOutput Input;
+
+layout(location=0)out vec4 o_Color;
+
+uniform vec4 u_Color;
+
+void main()
+{
+	// two sided lighting from a fixed direction, the inside of the tube is visible through it
+	vec3 lightDirection=normalize(vec3(.4,.7,.6));
+	float diffuse=abs(dot(normalize(Input.Normal),lightDirection));
+	o_Color=vec4(u_Color.rgb*(.35+.65*diffuse),u_Color.a);
+}
@@ -0,0 +1,488 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+/**
+ * @brief Span-local evaluation of the B-Spline basis functions
+ * @note At any t only (degree + 1) basis functions are non-zero, the ones attached to the knot span containing t.
+ * These helpers find that span and build its basis functions with the non-recursive (triangular) Cox-de Boor scheme.
+ * They are header-only so the curve and the surface can share them.
+ */
+namespace BSplineBasis
+{
+    /**
+     * @brief Highest degree supported by the span-local evaluation (size of the stack buffers)
+     */
+    constexpr uint8_t MaxDegree = 15;
+
+    /**
+     * @brief Find the knot span containing t, i.e. knots[span] <= t < knots[span + 1]
+     * @param knots The knots vector
+     * @param degree The degree of the B-Spline
+     * @param nbControlPoints The number of control points
+     * @param t Values outside [knots[degree], knots[nbControlPoints]] are mapped to the first/last non-empty span
+     * @return The index of the span, between degree and nbControlPoints - 1
+     * @note Binary search, KnotSpanLookup and KnotSpanWalker are faster for repeated searches on the same knots
+     */
+    inline int FindSpan(const std::vector<float> &knots, uint8_t degree, int nbControlPoints, float t)
+    {
+        int low = degree;
+        int high = nbControlPoints;
+
+        if (t >= knots[high])
+        {
+            // last non-empty span, so that the end of the range is evaluated as well
+            int span = high - 1;
+            while (span > low && knots[span] == knots[span + 1])
+                span--;
+            return span;
+        }
+
+        if (t < knots[low])
+        {
+            // first non-empty span
+            int span = low;
+            while (span < high - 1 && knots[span] == knots[span + 1])
+                span++;
+            return span;
+        }
+
+        // binary search of the last knot lower or equal to t
+        // (kept as a plain loop so it inlines into the vector kernels)
+        while (high - low > 1)
+        {
+            int middle = (low + high) / 2;
+            bool below = t < knots[middle];
+            high = below ? middle : high;
+            low = below ? low : middle;
+        }
+        return low;
+    }
+
+    /**
+     * @brief Precomputed span search of a knots vector, finds the span of any t in constant time
+     * @note The parameter range is cut in cells of equal size (two per span), each cell stores the span containing its start.
+     * A lookup reads the span of the cell of t then steps over the few knots of the cell, the knots may be non-uniform and repeated.
+     * It returns the same span as FindSpan, the knots are copied so it stays valid when the knots vector is modified.
+     */
+    class KnotSpanLookup
+    {
+    public:
+        KnotSpanLookup() = default;
+        KnotSpanLookup(const std::vector<float> &knots, uint8_t degree) { Build(knots, degree); }
+
+        /**
+         * @brief Rebuild the lookup, to call each time the knots or the degree change
+         * @param knots The knots vector (non-decreasing, nbControlPoints + degree + 1 values)
+         * @param degree The degree of the B-Spline
+         */
+        void Build(const std::vector<float> &knots, uint8_t degree)
+        {
+            int nbControlPoints = static_cast<int>(knots.size()) - degree - 1;
+
+            m_Knots = knots;
+            m_CellSpans.clear();
+            m_FirstSpan = degree;
+            m_LastSpan = degree;
+            m_Start = 0.0f;
+            m_End = 0.0f;
+
+            if (nbControlPoints <= degree)
+                return;
+
+            m_Start = knots[degree];
+            m_End = knots[nbControlPoints];
+
+            // first and last non-empty spans, where the values outside the range are mapped
+            m_FirstSpan = degree;
+            while (m_FirstSpan < nbControlPoints - 1 && knots[m_FirstSpan] == knots[m_FirstSpan + 1])
+                m_FirstSpan++;
+            m_LastSpan = nbControlPoints - 1;
+            while (m_LastSpan > degree && knots[m_LastSpan] == knots[m_LastSpan + 1])
+                m_LastSpan--;
+
+            if (!(m_End > m_Start))
+            {
+                m_End = m_Start;
+                return;
+            }
+
+            int nbCells = 2 * (nbControlPoints - degree);
+            m_CellSpans.resize(nbCells);
+            m_InverseCellSize = nbCells / (m_End - m_Start);
+
+            int span = m_FirstSpan;
+            for (int cell = 0; cell < nbCells; cell++)
+            {
+                float cellStart = m_Start + cell / m_InverseCellSize;
+                while (span < m_LastSpan && knots[span + 1] <= cellStart)
+                    span++;
+                m_CellSpans[cell] = span;
+            }
+        }
+
+        /**
+         * @brief Find the knot span containing t, see FindSpan
+         */
+        inline int Find(float t) const
+        {
+            if (!(t > m_Start))
+                return m_FirstSpan;
+            if (t >= m_End)
+                return m_LastSpan;
+
+            int cell = std::min(static_cast<int>((t - m_Start) * m_InverseCellSize), static_cast<int>(m_CellSpans.size()) - 1);
+            int span = m_CellSpans[cell];
+
+            while (m_Knots[span + 1] <= t)
+                span++;
+            // the cell index may be rounded up at its boundary
+            while (m_Knots[span] > t)
+                span--;
+
+            return span;
+        }
+
+        inline int GetFirstSpan() const { return m_FirstSpan; }
+        inline int GetLastSpan() const { return m_LastSpan; }
+        inline const float *GetKnots() const { return m_Knots.data(); }
+
+    private:
+        std::vector<float> m_Knots;
+        std::vector<int> m_CellSpans;
+
+        float m_Start = 0.0f;
+        float m_End = 0.0f;
+        float m_InverseCellSize = 0.0f;
+        int m_FirstSpan = 0;
+        int m_LastSpan = 0;
+    };
+
+    /**
+     * @brief Span search for sorted sweeps: starts from the span of the previous parameter and steps forward
+     * @note Parameters going backward, or jumping over many spans, fall back to the lookup so any order stays correct
+     */
+    class KnotSpanWalker
+    {
+    public:
+        KnotSpanWalker(const KnotSpanLookup &lookup)
+            : m_Lookup(lookup), m_Span(lookup.GetFirstSpan()) {}
+
+        /**
+         * @brief Find the knot span containing t, see FindSpan
+         */
+        inline int Find(float t)
+        {
+            const float *knots = m_Lookup.GetKnots();
+
+            if (t < knots[m_Span])
+                return m_Span = m_Lookup.Find(t);
+
+            for (int steps = 0; m_Span < m_Lookup.GetLastSpan() && knots[m_Span + 1] <= t; steps++)
+            {
+                if (steps == MaxSteps)
+                    return m_Span = m_Lookup.Find(t);
+                m_Span++;
+            }
+
+            return m_Span;
+        }
+
+    private:
+        static constexpr int MaxSteps = 4;
+
+        const KnotSpanLookup &m_Lookup;
+        int m_Span;
+    };
+
+    /**
+     * @brief Parameterise a polygon with its cumulated chord lengths raised to a power
+     * @note exponent = 1 is the chord length parameterisation, 0.5 the centripetal one (smoother on sharp turns).
+     * Coincident points get a small share of the mean chord so that the parameters stay strictly increasing.
+     * @param points The points of the polygon
+     * @param count The number of points
+     * @param exponent The power applied to each chord length
+     * @param parameters Output, one value per point from 0 to 1
+     */
+    inline void ComputeChordParameters(const glm::vec3 *points, std::size_t count, float exponent, float *parameters)
+    {
+        if (count == 0)
+            return;
+
+        parameters[0] = 0.0f;
+        if (count < 2)
+            return;
+
+        // the chords are stored in the parameters until they are cumulated
+        float total = 0.0f;
+        for (std::size_t i = 1; i < count; i++)
+        {
+            parameters[i] = std::pow(glm::length(points[i] - points[i - 1]), exponent);
+            total += parameters[i];
+        }
+
+        float minimum = total > 0.0f ? 1e-3f * total / (count - 1) : 1.0f;
+        total = 0.0f;
+        for (std::size_t i = 1; i < count; i++)
+        {
+            total += std::max(parameters[i], minimum);
+            parameters[i] = total;
+        }
+
+        for (std::size_t i = 1; i + 1 < count; i++)
+            parameters[i] /= total;
+        parameters[count - 1] = 1.0f;
+    }
+
+    inline void ComputeChordParameters(const std::vector<glm::vec3> &points, float exponent, std::vector<float> &parameters)
+    {
+        parameters.resize(points.size());
+        ComputeChordParameters(points.data(), points.size(), exponent, parameters.data());
+    }
+
+    /**
+     * @brief Build a clamped knots vector following a parameterisation (averaging technique)
+     * @note Each interior knot is the mean of degree consecutive parameters so that the basis function
+     * of each control point peaks near its parameter
+     * @param parameters One value per control point, from 0 to 1
+     * @param degree The degree of the B-Spline
+     * @param end The last knot, the knots go from 0 to end
+     * @param knots Output, parameters.size() + degree + 1 values
+     */
+    inline void ComputeAveragedKnots(const std::vector<float> &parameters, uint8_t degree, float end, std::vector<float> &knots)
+    {
+        int nbControlPoints = static_cast<int>(parameters.size());
+
+        knots.assign(nbControlPoints + degree + 1, end);
+        for (int i = 0; i <= degree; i++)
+            knots[i] = 0.0f;
+
+        for (int j = 1; j < nbControlPoints - degree; j++)
+        {
+            float sum = 0.0f;
+            for (int i = j; i < j + degree; i++)
+                sum += parameters[i];
+            knots[j + degree] = end * sum / degree;
+        }
+    }
+
+    /**
+     * @brief Compute the (degree + 1) non-zero basis functions of a knot span at t
+     * @param knots The knots vector
+     * @param span The knot span containing t (see FindSpan)
+     * @param degree The degree of the B-Spline
+     * @param t
+     * @param basis Output, basis[i] is the weight of the control point (span - degree + i)
+     */
+    inline void ComputeBasisFunctions(const float *knots, int span, uint8_t degree, float t, float *basis)
+    {
+        float left[MaxDegree + 1];
+        float right[MaxDegree + 1];
+
+        basis[0] = 1.0f;
+
+        // each pass raises the degree of the basis functions by one,
+        // reusing the lower degree values stored in basis (triangular scheme)
+        for (int j = 1; j <= degree; j++)
+        {
+            left[j] = t - knots[span + 1 - j];
+            right[j] = knots[span + j] - t;
+
+            float saved = 0.0f;
+            for (int r = 0; r < j; r++)
+            {
+                float temp = basis[r] / (right[r + 1] + left[j - r]);
+                basis[r] = saved + right[r + 1] * temp;
+                saved = left[j - r] * temp;
+            }
+            basis[j] = saved;
+        }
+    }
+
+    /**
+     * @brief Same as above with the knots stored in a vector
+     */
+    inline void ComputeBasisFunctions(const std::vector<float> &knots, int span, uint8_t degree, float t, float *basis)
+    {
+        ComputeBasisFunctions(knots.data(), span, degree, t, basis);
+    }
+
+    /**
+     * @brief Highest derivative order computed by ComputeBasisFunctionsDerivatives
+     */
+    constexpr int MaxDerivative = 2;
+
+    /**
+     * @brief Compute the (degree + 1) non-zero basis functions of a knot span and their derivatives at t in one pass
+     * @param knots The knots vector
+     * @param span The knot span containing t (see FindSpan)
+     * @param degree The degree of the B-Spline
+     * @param t
+     * @param nbDerivatives The highest derivative order to compute (at most MaxDerivative)
+     * @param derivatives Output, derivatives[k][i] is the k-th derivative of the weight of the control point (span - degree + i)
+     */
+    inline void ComputeBasisFunctionsDerivatives(const std::vector<float> &knots, int span, uint8_t degree, float t, int nbDerivatives, float derivatives[][MaxDegree + 1])
+    {
+        // ndu stores the basis functions (upper triangle) and the knot differences (lower triangle)
+        float ndu[MaxDegree + 1][MaxDegree + 1];
+        float left[MaxDegree + 1];
+        float right[MaxDegree + 1];
+        float a[2][MaxDegree + 1];
+
+        ndu[0][0] = 1.0f;
+        for (int j = 1; j <= degree; j++)
+        {
+            left[j] = t - knots[span + 1 - j];
+            right[j] = knots[span + j] - t;
+
+            float saved = 0.0f;
+            for (int r = 0; r < j; r++)
+            {
+                ndu[j][r] = right[r + 1] + left[j - r];
+                float temp = ndu[r][j - 1] / ndu[j][r];
+                ndu[r][j] = saved + right[r + 1] * temp;
+                saved = left[j - r] * temp;
+            }
+            ndu[j][j] = saved;
+        }
+
+        for (int j = 0; j <= degree; j++)
+            derivatives[0][j] = ndu[j][degree];
+
+        // the derivatives of a degree p basis function vanish above order p
+        for (int k = degree + 1; k <= nbDerivatives; k++)
+            for (int j = 0; j <= degree; j++)
+                derivatives[k][j] = 0.0f;
+        int maxOrder = nbDerivatives < degree ? nbDerivatives : degree;
+
+        // the k-th derivative of each function is a combination of the degree (p - k) functions,
+        // the coefficients a are built incrementally from the (k - 1)-th ones
+        for (int r = 0; r <= degree; r++)
+        {
+            int s1 = 0, s2 = 1;
+            a[0][0] = 1.0f;
+
+            for (int k = 1; k <= maxOrder; k++)
+            {
+                float d = 0.0f;
+                int rk = r - k;
+                int pk = degree - k;
+
+                if (r >= k)
+                {
+                    a[s2][0] = a[s1][0] / ndu[pk + 1][rk];
+                    d = a[s2][0] * ndu[rk][pk];
+                }
+
+                int j1 = rk >= -1 ? 1 : -rk;
+                int j2 = r - 1 <= pk ? k - 1 : degree - r;
+                for (int j = j1; j <= j2; j++)
+                {
+                    a[s2][j] = (a[s1][j] - a[s1][j - 1]) / ndu[pk + 1][rk + j];
+                    d += a[s2][j] * ndu[rk + j][pk];
+                }
+
+                if (r <= pk)
+                {
+                    a[s2][k] = -a[s1][k - 1] / ndu[pk + 1][r];
+                    d += a[s2][k] * ndu[r][pk];
+                }
+
+                derivatives[k][r] = d;
+                std::swap(s1, s2);
+            }
+        }
+
+        // multiply by the factors p! / (p - k)!
+        float factor = degree;
+        for (int k = 1; k <= maxOrder; k++)
+        {
+            for (int j = 0; j <= degree; j++)
+                derivatives[k][j] *= factor;
+            factor *= degree - k;
+        }
+    }
+
+    /**
+     * @brief Evaluate the blossom (polar form) of the polynomial piece of a knot span
+     * @note A de Boor pass where each level inserts its own argument: with all the arguments equal to t it is the point at t.
+     * The control points of the piece for any knots are blossoms of consecutive knots, which is what knot insertion computes.
+     * The narrowest level takes the first argument (Oslo order): with sorted arguments starting in the span, every blend is convex.
+     * Only the degree + 1 control points of the span are read.
+     * @param knots The knots vector
+     * @param controlPoints The control points of the whole curve
+     * @param span The knot span of the polynomial piece
+     * @param degree The degree of the B-Spline
+     * @param arguments The degree arguments of the blossom
+     */
+    template <typename Point>
+    inline Point EvaluateBlossom(const float *knots, const Point *controlPoints, int span, uint8_t degree, const float *arguments)
+    {
+        Point points[MaxDegree + 1];
+        for (int j = 0; j <= degree; j++)
+            points[j] = controlPoints[span - degree + j];
+
+        for (int r = 1; r <= degree; r++)
+        {
+            float t = arguments[degree - r];
+            for (int j = degree; j >= r; j--)
+            {
+                float lowKnot = knots[span - degree + j];
+                float highKnot = knots[span + 1 + j - r];
+                float alpha = (t - lowKnot) / (highKnot - lowKnot);
+                points[j] = (1.0f - alpha) * points[j - 1] + alpha * points[j];
+            }
+        }
+        return points[degree];
+    }
+
+    /**
+     * @brief Extract the Bezier control points of a non-empty knot span
+     * @note Equivalent to inserting the two knots of the span until they reach a multiplicity of degree:
+     * the i-th Bezier point is the blossom of the curve evaluated at (degree - i) times knots[span] and i times knots[span + 1].
+     * Only the degree + 1 control points of the span are read.
+     * @param knots The knots vector
+     * @param controlPoints The control points of the whole curve
+     * @param span The knot span to extract
+     * @param degree The degree of the B-Spline
+     * @param bezier Output, degree + 1 Bezier control points
+     */
+    template <typename Point>
+    inline void ExtractBezierSegment(const std::vector<float> &knots, const Point *controlPoints, int span, uint8_t degree, Point *bezier)
+    {
+        float arguments[MaxDegree];
+
+        for (int i = 0; i <= degree; i++)
+        {
+            for (int r = 0; r < degree; r++)
+                arguments[r] = r < i ? knots[span + 1] : knots[span];
+            bezier[i] = EvaluateBlossom(knots.data(), controlPoints, span, degree, arguments);
+        }
+    }
+
+    /**
+     * @brief Evaluate a Bezier segment with the de Casteljau algorithm (numerically stable)
+     * @param bezier The degree + 1 Bezier control points
+     * @param degree The degree of the segment
+     * @param u A value between 0 and 1
+     */
+    template <typename Point, typename Scalar>
+    inline Point EvaluateBezier(const Point *bezier, uint8_t degree, Scalar u)
+    {
+        Point points[MaxDegree + 1];
+        for (int i = 0; i <= degree; i++)
+            points[i] = bezier[i];
+
+        for (int r = 1; r <= degree; r++)
+            for (int i = 0; i <= degree - r; i++)
+                points[i] = (Scalar(1) - u) * points[i] + u * points[i + 1];
+
+        return points[0];
+    }
+}
@@ -1,26 +1,63 @@
 #include "BSplineCurve.h"
+#include "BSplineKernel.h"
+#include "Core/Assert.h"
 #include "Core/Log.h"
+#include "Core/JobSystem.h"
 
 #include "glm/gtc/constants.hpp"
 
 #include <iostream>
 #include <algorithm>
+#include <iterator>
+#include <limits>
+
+// work given to each job of the pool, small enough to balance 32 cores on a curve of a few hundred segments
+static constexpr uint32_t SamplesPerJob = 8192;
+static constexpr uint32_t BezierSegmentsPerJob = 256;
+static constexpr uint32_t BatchParametersPerJob = 16384;
+static constexpr uint32_t AdaptiveSegmentsPerJob = 64;
+
+// refined points per tile of the subdivision mode, the buffers of a tile stay in the cache through all the levels
+static constexpr uint32_t SubdivisionTileSamples = 2048;
+
+// limits the adaptive tessellation to 4096 edges per segment when the tolerances cannot be met
+static constexpr int MaxSubdivisionDepth = 12;
+
+/**
+ * @brief Split the segments [firstSegment, lastSegment] in ranges of segmentsPerJob and process them on the job system
+ * @note The segments are independent, each job only writes the data of its own range so the output does not depend on the scheduling
+ */
+static void ParallelForSegments(int firstSegment, int lastSegment, uint32_t segmentsPerJob, const std::function<void(int, int)> &function)
+{
+    if (firstSegment > lastSegment)
+        return;
+
+    SmartGL::Core::JobSystem::ParallelFor(lastSegment - firstSegment + 1, segmentsPerJob, [&](uint32_t begin, uint32_t end)
+                                          { function(firstSegment + begin, firstSegment + end - 1); });
+}
 
 BSplineCurve::BSplineCurve(uint8_t degree)
-    : m_Attributes(BSplineAttributes(degree))
+    : m_Attributes(BSplineAttributes(glm::min(degree, BSplineBasis::MaxDegree)))
 {
     InitKnotVector();
 }
 
 BSplineCurve::BSplineCurve(uint8_t degree, std::vector<glm::vec3> controlPoints)
-    : m_ControlPoints(controlPoints), m_Attributes(BSplineAttributes(degree))
+    : BSplineCurve(degree, controlPoints, std::vector<float>(controlPoints.size(), 1.0f))
 {
-    InitKnotVector();
+}
+
+BSplineCurve::BSplineCurve(uint8_t degree, std::vector<glm::vec3> controlPoints, std::vector<float> weights)
+    : m_Attributes(BSplineAttributes(glm::min(degree, BSplineBasis::MaxDegree)))
+{
+    SetControlPoints(controlPoints, weights);
 }
 
 BSplineCurve::~BSplineCurve()
 {
     m_ControlPoints.clear();
+    m_Weights.clear();
+    m_HomogeneousControlPoints.clear();
     m_Attributes.Knots.clear();
     m_Points.clear();
     m_Knots.clear();
@@ -29,134 +66,1961 @@ BSplineCurve::~BSplineCurve()
 void BSplineCurve::Evaluate()
 {
     int nbControlPoints = m_ControlPoints.size();
-    int nbPoints = m_Precision * nbControlPoints;
+    m_Version++;
+
+    // not enough control points to define a single segment
+    if (nbControlPoints < m_Attributes.Order)
+    {
+        m_Points.clear();
+        m_Parameters.clear();
+        m_ArcLengths.clear();
+        m_SegmentsStartLength.clear();
+        m_SegmentsBounds.clear();
+        m_BoundsTree.clear();
+        m_FullEvaluation = true;
+        m_BezierSegmentsValid = false;
+        return;
+    }
+
+    int nbSegments = GetSegmentsCount();
+    int firstDirty = glm::max(m_DirtyFirstSegment, 0);
+    int lastDirty = glm::min(m_DirtyLastSegment, nbSegments - 1);
+
+    // the arc lengths and the bounding boxes are computed on the Bezier form, the tables follow the same segments
+    auto computeBezierSegments = [this](int first, int last)
+    {
+        ComputeBezierSegments(first, last);
+        ComputeArcLengths(first, last);
+        ComputeSegmentsBounds(first, last);
+    };
+    auto evaluateSegments = [this](int first, int last)
+    { EvaluateSegments(first, last); };
+    uint32_t segmentsPerJob = glm::max(SamplesPerJob / m_Precision, 1u);
+
+    // the segments before the first modified (or shifted) one keep their start length
+    int firstMovedSegment = m_DirtyFirstSegment <= m_DirtyLastSegment ? glm::clamp(m_DirtyFirstSegment, 0, nbSegments) : nbSegments;
+
+    if (!HasValidBezierSegments())
+    {
+        m_BezierSegments.resize(nbSegments * m_Attributes.Order);
+        m_ArcLengths.resize(nbSegments * ArcLengthSubdivisions);
+        m_SegmentsBounds.resize(nbSegments);
+        ParallelForSegments(0, nbSegments - 1, BezierSegmentsPerJob, computeBezierSegments);
+        m_BezierSegmentsValid = true;
+        firstMovedSegment = 0;
+    }
+    else
+        ParallelForSegments(firstDirty, lastDirty, BezierSegmentsPerJob, computeBezierSegments);
+
+    m_SegmentsStartLength.resize(nbSegments + 1);
+    m_SegmentsStartLength[0] = 0.0;
+    for (int segment = firstMovedSegment; segment < nbSegments; segment++)
+        m_SegmentsStartLength[segment + 1] = m_SegmentsStartLength[segment] + m_ArcLengths[(segment + 1) * ArcLengthSubdivisions - 1];
+    UpdateBoundsTree(firstMovedSegment);
+
+    if (m_TessellationMode == CurveTessellationMode::Adaptive)
+    {
+        TessellateAdaptive();
+
+        m_FullEvaluation = true;
+        m_DirtyFirstSegment = 0;
+        m_DirtyLastSegment = -1;
+        return;
+    }
+    m_Parameters.clear();
+
+    // the other knots vectors are sampled uniformly
+    if (m_TessellationMode == CurveTessellationMode::Subdivision && HasUniformKnots())
+    {
+        EvaluateSubdivision();
+
+        m_FullEvaluation = true;
+        m_DirtyFirstSegment = 0;
+        m_DirtyLastSegment = -1;
+        return;
+    }
+
+    // the samples are written straight into m_Points, each job fills the samples of its segments
+    if (!HasValidSamples())
+    {
+        m_Points.resize(nbSegments * m_Precision + 1);
+        ParallelForSegments(0, nbSegments - 1, segmentsPerJob, evaluateSegments);
+    }
+    else
+        ParallelForSegments(firstDirty, lastDirty, segmentsPerJob, evaluateSegments);
+
+    // the end point of the curve closes the last segment (which may have been shifted)
+    m_Points.back() = EvaluateAt(GetMaxT());
+
+    m_FullEvaluation = false;
+    m_DirtyFirstSegment = 0;
+    m_DirtyLastSegment = -1;
+}
+
+void BSplineCurve::EvaluateSegments(int firstSegment, int lastSegment)
+{
     uint8_t degree = m_Attributes.Degree;
+    double step = 1.0 / (double)m_Precision;
 
-    m_Points.clear();
-    m_Points.resize(nbPoints);
+    // forward differencing amplifies the rounding errors with the number of steps,
+    // the differences are recomputed from the Bezier form at the start of each block
+    constexpr int blockSize = 32;
+
+    // the differences are those of the homogeneous curve, each sample is projected back
+    glm::dvec4 bezier[BSplineBasis::MaxDegree + 1];
+    glm::dvec4 differences[BSplineBasis::MaxDegree + 1];
 
-    float delta = m_Attributes.Knots[nbControlPoints] - m_Attributes.Knots[degree];
+    for (int segment = firstSegment; segment <= lastSegment; segment++)
+    {
+        const glm::vec4 *segmentBezier = m_BezierSegments.data() + segment * m_Attributes.Order;
+        for (int i = 0; i <= degree; i++)
+            bezier[i] = glm::dvec4(segmentBezier[i]);
+
+        glm::vec3 *points = m_Points.data() + segment * m_Precision;
 
-    for (int i = 0; i < nbPoints; i++) // precision
-        for (int j = 0; j < nbControlPoints; j++)
+        for (int first = 0; first < m_Precision; first += blockSize) // precision
         {
-            float t = m_Attributes.Knots[degree] + ((float)i * delta) / (float)nbPoints;
+            // initial forward differences from the values at u, u + step, ..., u + degree * step
+            for (int i = 0; i <= degree; i++)
+                differences[i] = BSplineBasis::EvaluateBezier(bezier, degree, (first + i) * step);
 
-            float weight = ComputeWeight(j, degree, t);
-            m_Points[i] += weight * m_ControlPoints[j];
+            for (int order = 1; order <= degree; order++)
+                for (int i = degree; i >= order; i--)
+                    differences[i] -= differences[i - 1];
+
+            // the degree-th difference is constant, each sample costs degree additions
+            int count = std::min(blockSize, m_Precision - first);
+            for (int i = 0; i < count; i++)
+            {
+                points[first + i] = glm::vec3(glm::dvec3(differences[0]) / differences[0].w);
+                for (int j = 0; j < degree; j++)
+                    differences[j] += differences[j + 1];
+            }
         }
+    }
 }
 
-glm::vec3 BSplineCurve::EvaluateAt(float t) const
+/**
+ * @brief Check if a (rational) Bezier segment can be replaced by its chord
+ * @note With positive weights the curve lies in the convex hull of its projected control points: bounding their distance to the chord bounds the curve.
+ * The tangents of a polynomial segment are spanned by the legs of the control polygon so their turn bounds the turn of the curve
+ * (a close estimate only for rational segments)
+ */
+static bool IsFlat(const glm::vec4 *homogeneousBezier, uint8_t degree, const CurveTessellationTolerance &tolerance)
+{
+    glm::vec3 bezier[BSplineBasis::MaxDegree + 1];
+    for (int i = 0; i <= degree; i++)
+        bezier[i] = glm::vec3(homogeneousBezier[i]) / homogeneousBezier[i].w;
+
+    glm::vec3 chord = bezier[degree] - bezier[0];
+    float chordLength2 = glm::dot(chord, chord);
+    float maxDeviation2 = tolerance.ChordalDeviation * tolerance.ChordalDeviation;
+
+    for (int i = 1; i < degree; i++)
+    {
+        glm::vec3 offset = bezier[i] - bezier[0];
+        float projection = chordLength2 > 0.0f ? glm::clamp(glm::dot(offset, chord) / chordLength2, 0.0f, 1.0f) : 0.0f;
+        glm::vec3 deviation = offset - projection * chord;
+        if (glm::dot(deviation, deviation) > maxDeviation2)
+            return false;
+    }
+
+    float turn = 0.0f;
+    glm::vec3 previousLeg(0.0f);
+    for (int i = 0; i < degree; i++)
+    {
+        glm::vec3 leg = bezier[i + 1] - bezier[i];
+        float legLength = glm::length(leg);
+        if (legLength <= 0.0f)
+            continue;
+
+        leg /= legLength;
+        if (previousLeg != glm::vec3(0.0f))
+            turn += glm::acos(glm::clamp(glm::dot(previousLeg, leg), -1.0f, 1.0f));
+        previousLeg = leg;
+    }
+
+    return turn <= tolerance.Angle;
+}
+
+/**
+ * @brief Split a (rational) Bezier segment at 0.5
+ * @note de Casteljau in homogeneous space, the sides of the triangle are the control points of both halves
+ * @param left Output, the degree + 1 control points of the first half
+ * @param right Output, the degree + 1 control points of the second half
+ */
+static void SplitBezierInHalves(const glm::vec4 *bezier, uint8_t degree, glm::vec4 *left, glm::vec4 *right)
+{
+    glm::vec4 work[BSplineBasis::MaxDegree + 1];
+    for (int i = 0; i <= degree; i++)
+        work[i] = bezier[i];
+
+    left[0] = work[0];
+    right[degree] = work[degree];
+    for (int r = 1; r <= degree; r++)
+    {
+        for (int i = 0; i <= degree - r; i++)
+            work[i] = 0.5f * (work[i] + work[i + 1]);
+        left[r] = work[0];
+        right[degree - r] = work[degree - r];
+    }
+}
+
+/**
+ * @brief Split a Bezier segment in halves until each piece is flat, the first point of each piece is emitted in order
+ * @param bezier The degree + 1 Bezier control points of the piece
+ * @param degree The degree of the piece
+ * @param start The curve parameter at the start of the piece
+ * @param end The curve parameter at the end of the piece
+ * @param depth The number of splits already done
+ */
+static void SubdivideBezier(const glm::vec4 *bezier, uint8_t degree, float start, float end, int depth, const CurveTessellationTolerance &tolerance,
+                            std::vector<glm::vec3> &points, std::vector<float> &parameters)
+{
+    if (depth == MaxSubdivisionDepth || IsFlat(bezier, degree, tolerance))
+    {
+        points.push_back(glm::vec3(bezier[0]) / bezier[0].w);
+        parameters.push_back(start);
+        return;
+    }
+
+    glm::vec4 left[BSplineBasis::MaxDegree + 1];
+    glm::vec4 right[BSplineBasis::MaxDegree + 1];
+    SplitBezierInHalves(bezier, degree, left, right);
+
+    float middle = 0.5f * (start + end);
+    SubdivideBezier(left, degree, start, middle, depth + 1, tolerance, points, parameters);
+    SubdivideBezier(right, degree, middle, end, depth + 1, tolerance, points, parameters);
+}
+
+void BSplineCurve::TessellateAdaptive()
 {
+    int nbSegments = GetSegmentsCount();
     uint8_t degree = m_Attributes.Degree;
 
-    glm::vec3 point(0.0f);
+    // each job tessellates its own range of segments, the ranges are concatenated in order afterwards
+    uint32_t nbJobs = (nbSegments + AdaptiveSegmentsPerJob - 1) / AdaptiveSegmentsPerJob;
+    std::vector<std::vector<glm::vec3>> jobsPoints(nbJobs);
+    std::vector<std::vector<float>> jobsParameters(nbJobs);
 
-    // compute the point on the curve at t
-    // by summing the weighted control points
-    for (int i = 0; i < m_ControlPoints.size(); ++i)
-        point += ComputeWeight(i, degree, t) * m_ControlPoints[i];
+    ParallelForSegments(0, nbSegments - 1, AdaptiveSegmentsPerJob, [&](int firstSegment, int lastSegment)
+                        {
+                            uint32_t job = firstSegment / AdaptiveSegmentsPerJob;
 
-    return point;
+                            for (int segment = firstSegment; segment <= lastSegment; segment++)
+                            {
+                                int span = segment + degree;
+                                float start = m_Attributes.Knots[span];
+                                float end = m_Attributes.Knots[span + 1];
+
+                                // an empty span is a single point, already emitted by its neighbours
+                                if (start == end)
+                                    continue;
+
+                                const glm::vec4 *bezier = m_BezierSegments.data() + segment * m_Attributes.Order;
+                                SubdivideBezier(bezier, degree, start, end, 0, m_TessellationTolerance, jobsPoints[job], jobsParameters[job]);
+                            } });
+
+    m_Points.clear();
+    m_Parameters.clear();
+    for (uint32_t job = 0; job < nbJobs; job++)
+    {
+        m_Points.insert(m_Points.end(), jobsPoints[job].begin(), jobsPoints[job].end());
+        m_Parameters.insert(m_Parameters.end(), jobsParameters[job].begin(), jobsParameters[job].end());
+    }
+
+    m_Points.push_back(EvaluateAt(GetMaxT()));
+    m_Parameters.push_back(GetMaxT());
 }
 
-void BSplineCurve::InitKnotVector()
+bool BSplineCurve::HasUniformKnots() const
 {
-    int numControlPoints = m_ControlPoints.size();
+    const std::vector<float> &knots = m_Attributes.Knots;
+    if (m_Attributes.Degree == 0 || knots.size() < 2)
+        return false;
 
-    // the number of knots is equal to the number of control points + the degree + 1
-    int numKnots = numControlPoints + m_Attributes.Order;
+    float spacing = knots[1] - knots[0];
+    if (!(spacing > 0.0f))
+        return false;
 
-    m_Attributes.Knots.clear();
-    m_Attributes.Knots.resize(numKnots);
+    for (std::size_t i = 2; i < knots.size(); i++)
+        if (glm::abs(knots[i] - knots[i - 1] - spacing) > 1e-4f * spacing)
+            return false;
+
+    return true;
+}
+
+void BSplineCurve::EvaluateSubdivision()
+{
+    uint8_t degree = m_Attributes.Degree;
+    int levels = m_SubdivisionLevels;
+    int nbSegments = GetSegmentsCount();
+    m_Points.resize((nbSegments << levels) + 1);
+
+    // the basis functions of a uniform B-Spline at the start of a span, the last one is 0
+    float knots[2 * BSplineBasis::MaxDegree + 2];
+    for (int i = 0; i < 2 * degree + 2; i++)
+        knots[i] = static_cast<float>(i);
+    float stencil[BSplineBasis::MaxDegree + 1];
+    BSplineBasis::ComputeBasisFunctions(knots, degree, degree, static_cast<float>(degree), stencil);
+
+    uint32_t segmentsPerTile = glm::max(SubdivisionTileSamples >> levels, 1u);
+    uint32_t segmentsPerJob = glm::max(SamplesPerJob >> levels, 1u);
+
+    ParallelForSegments(0, nbSegments - 1, segmentsPerJob, [&](int firstSegment, int lastSegment)
+                        {
+                            std::size_t capacity = (segmentsPerTile << levels) + 2 * degree;
+                            ControlPointsSoA points;
+                            ControlPointsSoA scratch;
+                            points.Reserve(capacity);
+                            scratch.Reserve(capacity);
+
+                            std::vector<float> *coordinates[4] = {&points.X, &points.Y, &points.Z, &points.W};
+                            std::vector<float> *scratches[4] = {&scratch.X, &scratch.Y, &scratch.Z, &scratch.W};
+                            const std::vector<float> *controlPoints[4] = {&m_ControlPointsSoA.X, &m_ControlPointsSoA.Y, &m_ControlPointsSoA.Z, &m_ControlPointsSoA.W};
+
+                            // the segments of a tile only depend on their degree + 1 control points, the tiles are subdivided separately
+                            for (int first = firstSegment; first <= lastSegment; first += segmentsPerTile)
+                            {
+                                int last = glm::min(first + (int)segmentsPerTile - 1, lastSegment);
+                                for (int c = 0; c < 4; c++)
+                                {
+                                    coordinates[c]->assign(controlPoints[c]->begin() + first, controlPoints[c]->begin() + last + degree + 1);
+                                    BSplineSIMD::SubdivideUniform(*coordinates[c], *scratches[c], degree, levels);
+                                }
+
+                                // the point i is on the curve at the refined knot i of the tile, the next tile writes the shared end point
+                                int count = (last - first + 1) << levels;
+                                if (last == nbSegments - 1)
+                                    count++;
+
+                                BSplineSIMD::ApplyStencil(points, stencil, degree, m_Points.data() + (first << levels), count);
+                            } });
+}
+
+// 5 points Gauss-Legendre quadrature on [-1, 1], exact for polynomials up to degree 9
+static constexpr int GaussLegendrePointsCount = 5;
+static constexpr float GaussLegendreNodes[GaussLegendrePointsCount] = {0.0f, -0.5384693101056831f, 0.5384693101056831f, -0.9061798459386640f, 0.9061798459386640f};
+static constexpr float GaussLegendreWeights[GaussLegendrePointsCount] = {0.5688888888888889f, 0.4786286704993665f, 0.4786286704993665f, 0.2369268850561891f, 0.2369268850561891f};
 
-    for (int i = 0; i < numKnots; ++i)
+/**
+ * @brief Speed (norm of the derivative) of a rational Bezier segment with respect to its local parameter u
+ * @note The derivative of a degree p Bezier segment is the degree (p - 1) Bezier segment of the differences p * (b[i + 1] - b[i]),
+ * it is built once per segment. The derivative of the projected curve C = A / w is (A' - w' * C) / w
+ */
+struct BezierSpeed
+{
+    const glm::vec4 *Bezier;
+    glm::vec4 Hodograph[BSplineBasis::MaxDegree];
+    uint8_t Degree;
+
+    BezierSpeed(const glm::vec4 *bezier, uint8_t degree)
+        : Bezier(bezier), Degree(degree)
+    {
+        for (int i = 0; i < degree; i++)
+            Hodograph[i] = (float)degree * (bezier[i + 1] - bezier[i]);
+    }
+
+    float At(float u) const
+    {
+        if (Degree == 0)
+            return 0.0f;
+
+        glm::vec4 point = BSplineBasis::EvaluateBezier(Bezier, Degree, u);
+        glm::vec4 derivative = BSplineBasis::EvaluateBezier(Hodograph, Degree - 1, u);
+
+        glm::vec3 position = glm::vec3(point) / point.w;
+        return glm::length((glm::vec3(derivative) - derivative.w * position) / point.w);
+    }
+
+    /**
+     * @brief The length of the segment between the local parameters u0 and u1
+     */
+    float Integrate(float u0, float u1) const
+    {
+        float halfRange = 0.5f * (u1 - u0);
+        float middle = 0.5f * (u0 + u1);
+
+        float length = 0.0f;
+        for (int i = 0; i < GaussLegendrePointsCount; i++)
+            length += GaussLegendreWeights[i] * At(middle + halfRange * GaussLegendreNodes[i]);
+
+        return length * halfRange;
+    }
+};
+
+/**
+ * @brief Values of the Bernstein polynomials of a degree (and of the degree below for the hodograph)
+ * at the quadrature nodes of the arc length subdivisions, the nodes are the same for every segment
+ */
+struct ArcLengthQuadrature
+{
+    static constexpr int NodesCount = BSplineCurve::ArcLengthSubdivisions * GaussLegendrePointsCount;
+
+    float Bernstein[NodesCount][BSplineBasis::MaxDegree + 1];
+    float HodographBernstein[NodesCount][BSplineBasis::MaxDegree];
+    float Weights[NodesCount];
+
+    void Init(uint8_t degree)
+    {
+        for (int k = 0; k < BSplineCurve::ArcLengthSubdivisions; k++)
+            for (int g = 0; g < GaussLegendrePointsCount; g++)
+            {
+                int node = k * GaussLegendrePointsCount + g;
+                float u = (k + 0.5f + 0.5f * GaussLegendreNodes[g]) / BSplineCurve::ArcLengthSubdivisions;
+                Weights[node] = GaussLegendreWeights[g] * 0.5f / BSplineCurve::ArcLengthSubdivisions;
+
+                ComputeBernstein(degree, u, Bernstein[node]);
+                if (degree > 0)
+                    ComputeBernstein(degree - 1, u, HodographBernstein[node]);
+            }
+    }
+
+    static void ComputeBernstein(uint8_t degree, float u, float *bernstein)
     {
-        switch (m_Type)
+        // raise the degree one step at a time, B(j, r) = (1 - u) * B(j, r - 1) + u * B(j - 1, r - 1)
+        bernstein[0] = 1.0f;
+        for (int r = 1; r <= degree; r++)
         {
-        case BSplineType::Uniform:
-            m_Attributes.Knots[i] = static_cast<float>(i);
-            break;
+            float saved = 0.0f;
+            for (int j = 0; j < r; j++)
+            {
+                float temp = bernstein[j];
+                bernstein[j] = saved + (1.0f - u) * temp;
+                saved = u * temp;
+            }
+            bernstein[r] = saved;
+        }
+    }
 
-        case BSplineType::OpenUniform:
-            if (i <= m_Attributes.Degree)
-                m_Attributes.Knots[i] = 0.0f; // Repeat the first knot
-            else if (m_Attributes.Degree < i && i <= m_Attributes.Knots.size() - m_Attributes.Degree - 1)
-                m_Attributes.Knots[i] = static_cast<float>(i - m_Attributes.Degree);
-            else
-                m_Attributes.Knots[i] = static_cast<float>(numControlPoints - m_Attributes.Order + 2); // Repeat the last knot
+    static const ArcLengthQuadrature &Get(uint8_t degree)
+    {
+        static const std::vector<ArcLengthQuadrature> s_Quadratures = []
+        {
+            std::vector<ArcLengthQuadrature> quadratures(BSplineBasis::MaxDegree + 1);
+            for (int degree = 0; degree <= BSplineBasis::MaxDegree; degree++)
+                quadratures[degree].Init(degree);
+            return quadratures;
+        }();
+
+        return s_Quadratures[degree];
+    }
+};
+
+void BSplineCurve::ComputeArcLengths(int firstSegment, int lastSegment)
+{
+    uint8_t degree = m_Attributes.Degree;
+    const ArcLengthQuadrature &quadrature = ArcLengthQuadrature::Get(degree);
+
+    for (int segment = firstSegment; segment <= lastSegment; segment++)
+    {
+        BezierSpeed speed(m_BezierSegments.data() + segment * m_Attributes.Order, degree);
+        float *arcLengths = m_ArcLengths.data() + segment * ArcLengthSubdivisions;
+
+        float length = 0.0f;
+        for (int k = 0; k < ArcLengthSubdivisions; k++)
+        {
+            for (int g = 0; g < GaussLegendrePointsCount && degree > 0; g++)
+            {
+                int node = k * GaussLegendrePointsCount + g;
+
+                // same as speed.At(u) with the precomputed Bernstein values
+                glm::vec4 point(0.0f);
+                glm::vec4 derivative(0.0f);
+                for (int i = 0; i < degree; i++)
+                {
+                    point += quadrature.Bernstein[node][i] * speed.Bezier[i];
+                    derivative += quadrature.HodographBernstein[node][i] * speed.Hodograph[i];
+                }
+                point += quadrature.Bernstein[node][degree] * speed.Bezier[degree];
+
+                glm::vec3 position = glm::vec3(point) / point.w;
+                length += quadrature.Weights[node] * glm::length((glm::vec3(derivative) - derivative.w * position) / point.w);
+            }
+            arcLengths[k] = length;
+        }
+    }
+}
+
+float BSplineCurve::GetLength() const
+{
+    return m_SegmentsStartLength.empty() ? 0.0f : (float)m_SegmentsStartLength.back();
+}
+
+float BSplineCurve::LengthAtParameter(float t) const
+{
+    if (m_SegmentsStartLength.empty())
+        return 0.0f;
+
+    uint8_t degree = m_Attributes.Degree;
+    int span = m_SpanLookup.Find(t);
+    int segment = span - degree;
+
+    float start = m_Attributes.Knots[span];
+    float end = m_Attributes.Knots[span + 1];
+    float u = glm::clamp((t - start) / (end - start), 0.0f, 1.0f);
+
+    // whole subdivisions from the table, the rest is integrated
+    int k = glm::min((int)(u * ArcLengthSubdivisions), ArcLengthSubdivisions - 1);
+    float length = k > 0 ? m_ArcLengths[segment * ArcLengthSubdivisions + k - 1] : 0.0f;
+    length += BezierSpeed(m_BezierSegments.data() + segment * m_Attributes.Order, degree).Integrate((float)k / ArcLengthSubdivisions, u);
+
+    return (float)m_SegmentsStartLength[segment] + length;
+}
+
+float BSplineCurve::ParameterAtLength(float s) const
+{
+    if (m_SegmentsStartLength.empty())
+        return GetMinT();
+
+    // last segment starting before s
+    int nbSegments = GetSegmentsCount();
+    int segment = std::upper_bound(m_SegmentsStartLength.begin(), m_SegmentsStartLength.begin() + nbSegments, (double)s) - m_SegmentsStartLength.begin() - 1;
+
+    return ParameterAtLength(s, glm::max(segment, 0));
+}
+
+float BSplineCurve::ParameterAtLength(float s, int segment) const
+{
+    uint8_t degree = m_Attributes.Degree;
+    const float *arcLengths = m_ArcLengths.data() + segment * ArcLengthSubdivisions;
+    BezierSpeed speed(m_BezierSegments.data() + segment * m_Attributes.Order, degree);
+
+    float start = m_Attributes.Knots[segment + degree];
+    float end = m_Attributes.Knots[segment + degree + 1];
+    float length = glm::clamp(s - (float)m_SegmentsStartLength[segment], 0.0f, arcLengths[ArcLengthSubdivisions - 1]);
+
+    // subdivision containing the length
+    int k = std::lower_bound(arcLengths, arcLengths + ArcLengthSubdivisions - 1, length) - arcLengths;
+    float u0 = (float)k / ArcLengthSubdivisions;
+    float u1 = (float)(k + 1) / ArcLengthSubdivisions;
+    float length0 = k > 0 ? arcLengths[k - 1] : 0.0f;
+    float length1 = arcLengths[k];
+
+    // the length is almost linear in a subdivision, a few Newton steps on s(u) - s = 0 refine the linear guess
+    float u = length1 > length0 ? u0 + (length - length0) / (length1 - length0) * (u1 - u0) : u0;
+    for (int i = 0; i < 3; i++)
+    {
+        float derivative = speed.At(u);
+        if (derivative <= 0.0f)
             break;
-            exit(1);
 
-        default:
-            SMART_LOG_CRITICAL("Unknown BSplineType");
-            exit(1);
+        float error = length0 + speed.Integrate(u0, u) - length;
+        u = glm::clamp(u - error / derivative, u0, u1);
+        if (glm::abs(error) <= 1e-6f * length1)
             break;
-        }
     }
+
+    return start + u * (end - start);
+}
+
+glm::vec3 BSplineCurve::EvaluateAtLength(float s) const
+{
+    return EvaluateAt(ParameterAtLength(s));
 }
 
-float BSplineCurve::ComputeWeight(int index, uint8_t degree, float t) const
+void BSplineCurve::ResampleByLength(float fromLength, float toLength, uint32_t count, std::vector<float> &parameters) const
 {
+    parameters.resize(count);
+    if (count == 0)
+        return;
+
+    if (m_SegmentsStartLength.empty())
+    {
+        std::fill(parameters.begin(), parameters.end(), GetMinT());
+        return;
+    }
+
+    int nbSegments = GetSegmentsCount();
+    float step = count > 1 ? (toLength - fromLength) / (count - 1) : 0.0f;
 
-    // get the knots of the current segment
-    float currentKnot = m_Attributes.Knots[index];
-    float nextKnot = m_Attributes.Knots[index + 1];
+    SmartGL::Core::JobSystem::ParallelFor(count, BatchParametersPerJob, [&](uint32_t begin, uint32_t end)
+                                          {
+                                              // the lengths are sorted, the segment is searched once per job then only moves forward
+                                              // (or backward when fromLength > toLength)
+                                              float s = fromLength + begin * step;
+                                              int segment = std::upper_bound(m_SegmentsStartLength.begin(), m_SegmentsStartLength.begin() + nbSegments, (double)s) - m_SegmentsStartLength.begin() - 1;
+                                              segment = glm::max(segment, 0);
 
-    // if the degree is 0, the weight is 1 if t is between the current knot and the next knot, 0 otherwise
-    // that's the stopping condition of the recursive function
-    if (degree == 0)
-        return (t >= currentKnot && t < nextKnot) ? 1.0f : 0.0f;
+                                              for (uint32_t i = begin; i < end; i++)
+                                              {
+                                                  s = fromLength + i * step;
 
-    float weight = 0.0f;
+                                                  while (segment + 1 < nbSegments && m_SegmentsStartLength[segment + 1] <= s)
+                                                      segment++;
+                                                  while (segment > 0 && m_SegmentsStartLength[segment] > s)
+                                                      segment--;
+
+                                                  parameters[i] = ParameterAtLength(s, segment);
+                                              } });
+}
 
-    // the Box-Cox formula
+void BSplineCurve::ResampleByLength(uint32_t count, std::vector<float> &parameters, std::vector<glm::vec3> &points) const
+{
+    ResampleByLength(0.0f, GetLength(), count, parameters);
+    EvaluateBatch(parameters, points);
+}
 
-    float denominator = m_Attributes.Knots[index + degree] - currentKnot;
+// closest point queries: work given to each job, samples and maximum number of Newton steps in a straight piece of a segment,
+// cosine of the angle between the legs and the chord under which a piece is straight and deepest split of a segment
+static constexpr uint32_t ClosestPointQueriesPerJob = 1024;
+static constexpr int ClosestPointSamples = 8;
+static constexpr int ClosestPointRefinementSteps = 16;
+static constexpr float ClosestPointStraightness = 0.9f;
+static constexpr int ClosestPointMaxDepth = 12;
 
-    // current knot
-    if (denominator != 0.0f)
-        weight = (t - currentKnot) / denominator * ComputeWeight(index, degree - 1, t);
+/**
+ * @brief Point and derivatives (with respect to u) of a rational Bezier segment at u
+ * @note The last levels of the de Casteljau triangle give the derivatives of the homogeneous curve A,
+ * the quotient rule gives those of the projected curve C = A / w
+ */
+static CurvePointDerivatives EvaluateBezierDerivatives(const glm::vec4 *bezier, uint8_t degree, float u)
+{
+    glm::vec4 points[BSplineBasis::MaxDegree + 1];
+    for (int i = 0; i <= degree; i++)
+        points[i] = bezier[i];
 
-    denominator = m_Attributes.Knots[index + degree + 1] - nextKnot;
+    glm::vec4 homogeneous[3] = {glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f)};
+    for (int r = 1; r <= degree; r++)
+    {
+        if (r == degree - 1)
+            homogeneous[2] = (float)(degree * (degree - 1)) * (points[2] - 2.0f * points[1] + points[0]);
+        if (r == degree)
+            homogeneous[1] = (float)degree * (points[1] - points[0]);
 
-    // next knot
-    if (denominator != 0.0f)
-        weight += (m_Attributes.Knots[index + degree + 1] - t) / denominator * ComputeWeight(index + 1, degree - 1, t);
+        for (int i = 0; i <= degree - r; i++)
+            points[i] = (1.0f - u) * points[i] + u * points[i + 1];
+    }
+    homogeneous[0] = points[0];
 
-    return weight;
+    CurvePointDerivatives point;
+    float weight = homogeneous[0].w;
+    point.Position = glm::vec3(homogeneous[0]) / weight;
+    point.Velocity = (glm::vec3(homogeneous[1]) - homogeneous[1].w * point.Position) / weight;
+    point.Acceleration = (glm::vec3(homogeneous[2]) - 2.0f * homogeneous[1].w * point.Velocity - homogeneous[2].w * point.Position) / weight;
+    return point;
 }
 
-CurveFrenetFrameComponents BSplineCurve::GetFrenetFrameAt(float t) const
+/**
+ * @brief Distance to a point, the closest point of the curve is a zero of f(u) = C'(u).(C(u) - P)
+ */
+struct PointQuery
 {
-    auto [Velocity, Acceleration] = GetFiniteDifferencesDerivatives(t);
+    glm::vec3 Point;
 
-    glm::vec3 tangent = glm::normalize(Velocity);
-    glm::vec3 normal = glm::normalize(glm::cross(Velocity, glm::cross(Acceleration, Velocity)));
-    glm::vec3 binormal = glm::cross(tangent, normal);
+    inline float LowerBound(const SmartGL::Maths::BoundingBox &box) const { return glm::sqrt(box.Distance2(Point)); }
+    inline float Distance(const glm::vec3 &position) const { return glm::length(position - Point); }
+    inline float RayParameter(const glm::vec3 &) const { return 0.0f; }
 
-    return CurveFrenetFrameComponents{tangent, normal, binormal};
+    /**
+     * @brief f and its derivative for a Newton step
+     */
+    inline void Residual(const CurvePointDerivatives &point, float &f, float &derivative) const
+    {
+        glm::vec3 offset = point.Position - Point;
+        f = glm::dot(point.Velocity, offset);
+        derivative = glm::dot(point.Acceleration, offset) + glm::dot(point.Velocity, point.Velocity);
+    }
+};
+
+/**
+ * @brief Distance to a ray, the offset of the curve is measured perpendicular to the ray (or from the origin behind it)
+ */
+struct RayQuery
+{
+    glm::vec3 Origin;
+    glm::vec3 Direction;
+
+    inline float LowerBound(const SmartGL::Maths::BoundingBox &box) const { return box.RayDistanceLowerBound(Origin, Direction); }
+    inline float RayParameter(const glm::vec3 &position) const { return glm::max(glm::dot(position - Origin, Direction), 0.0f); }
+    inline float Distance(const glm::vec3 &position) const { return glm::length(Offset(position)); }
+
+    inline glm::vec3 Offset(const glm::vec3 &position) const
+    {
+        glm::vec3 offset = position - Origin;
+        return offset - RayParameter(position) * Direction;
+    }
+
+    inline void Residual(const CurvePointDerivatives &point, float &f, float &derivative) const
+    {
+        // the offset is orthogonal to the direction in front of the origin,
+        // so only the part of the velocity orthogonal to the ray changes its length
+        glm::vec3 offset = Offset(point.Position);
+        glm::vec3 velocity = point.Velocity;
+        if (glm::dot(point.Position - Origin, Direction) > 0.0f)
+            velocity -= glm::dot(velocity, Direction) * Direction;
+
+        f = glm::dot(point.Velocity, offset);
+        derivative = glm::dot(point.Acceleration, offset) + glm::dot(velocity, velocity);
+    }
+};
+
+/**
+ * @brief Refine a local minimum of the distance to a query inside [low, high]
+ * @note Newton steps on the residual of the query, replaced by a bisection when they leave the bracket
+ * (the ray distance has a kink where the closest point of the ray reaches its origin)
+ * @param low A parameter where the residual is negative or zero
+ * @param high A parameter where the residual is positive or zero
+ * @param current The parameter the steps start from, inside [low, high]
+ * @param bestDistance Input, the distance of the best point so far, output the distance of the best point found
+ * @param u Output, the local parameter of the best point if one closer than bestDistance is found
+ */
+template <typename Query>
+static void RefineOnSegment(const glm::vec4 *bezier, uint8_t degree, const Query &query, float low, float high, float current,
+                            float &bestDistance, float &u)
+{
+    for (int step = 0; step < ClosestPointRefinementSteps; step++)
+    {
+        CurvePointDerivatives point = EvaluateBezierDerivatives(bezier, degree, current);
+
+        // f is the derivative of the squared distance (halved), its sign tells on which side the minimum is
+        float f, derivative;
+        query.Residual(point, f, derivative);
+        if (f > 0.0f)
+            high = current;
+        else
+            low = current;
+
+        float next = derivative > 0.0f ? current - f / derivative : -1.0f;
+        if (!(next > low && next < high))
+            next = 0.5f * (low + high);
+
+        glm::vec4 nextPoint = BSplineBasis::EvaluateBezier(bezier, degree, next);
+        float distance = query.Distance(glm::vec3(nextPoint) / nextPoint.w);
+        if (distance < bestDistance)
+        {
+            bestDistance = distance;
+            u = next;
+        }
+
+        if (glm::abs(next - current) <= 1e-6f)
+            break;
+        current = next;
+    }
 }
 
-float BSplineCurve::GetCurvatureAt(float t) const
+/**
+ * @brief Check if a piece of a segment runs nearly straight along its chord
+ * @note The tangents of a (rational) Bezier piece are positive combinations of the legs of its control polygon,
+ * when every leg stays close to the direction of the chord the piece can barely turn back toward a query
+ * @param points The degree + 1 projected control points of the piece
+ */
+static bool IsStraight(const glm::vec3 *points, uint8_t degree)
+{
+    glm::vec3 chord = points[degree] - points[0];
+    float chordLength = glm::length(chord);
+    if (!(chordLength > 0.0f))
+        return false;
+
+    for (int i = 0; i < degree; i++)
+    {
+        glm::vec3 leg = points[i + 1] - points[i];
+        if (glm::dot(leg, chord) < ClosestPointStraightness * glm::length(leg) * chordLength)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Find the minima of the distance to a query on a nearly straight piece
+ * @note The residual of the query is sampled uniformly, every interval where it goes from negative to positive
+ * brackets a local minimum of the distance and is refined
+ * @param piece The degree + 1 homogeneous control points of the piece
+ * @param start The local parameter of the segment at the start of the piece
+ * @param end The local parameter of the segment at the end of the piece
+ * @param bestDistance Input, the distance of the best point so far, output the distance of the best point found
+ * @param u Output, the local parameter of the best point if one closer than bestDistance is found
+ */
+template <typename Query>
+static void RefineOnPiece(const glm::vec4 *piece, uint8_t degree, const Query &query, float start, float end, float &bestDistance, float &u)
+{
+    float residuals[ClosestPointSamples + 1];
+    float distances[ClosestPointSamples + 1];
+    for (int i = 0; i <= ClosestPointSamples; i++)
+    {
+        CurvePointDerivatives point = EvaluateBezierDerivatives(piece, degree, (float)i / ClosestPointSamples);
+
+        float derivative;
+        query.Residual(point, residuals[i], derivative);
+        distances[i] = query.Distance(point.Position);
+    }
+
+    float localU = -1.0f;
+    for (int i = 0; i < ClosestPointSamples; i++)
+    {
+        if (!(residuals[i] <= 0.0f && residuals[i + 1] >= 0.0f))
+            continue;
+
+        float low = (float)i / ClosestPointSamples;
+        float high = (float)(i + 1) / ClosestPointSamples;
+        RefineOnSegment(piece, degree, query, low, high, distances[i] < distances[i + 1] ? low : high, bestDistance, localU);
+    }
+
+    if (localU >= 0.0f)
+        u = start + localU * (end - start);
+}
+
+/**
+ * @brief Search the point of a piece of a segment closest to a query
+ * @note The piece is split in halves, nearest half first, while the box of its hull is closer than the best point so far
+ * and it is not straight, then the minima of the straight pieces are refined (see RefineOnPiece).
+ * @param piece The degree + 1 homogeneous control points of the piece
+ * @param start The local parameter of the segment at the start of the piece
+ * @param end The local parameter of the segment at the end of the piece
+ * @param depth The number of splits already done
+ * @param bestDistance Input, the distance of the best point so far, output the distance of the best point found
+ * @param u Output, the local parameter of the best point if one closer than bestDistance is found
+ */
+template <typename Query>
+static void SearchPiece(const glm::vec4 *piece, uint8_t degree, const Query &query, float start, float end, int depth,
+                        float &bestDistance, float &u)
 {
-    auto [Velocity, Acceleration] = GetFiniteDifferencesDerivatives(t);
+    glm::vec3 points[BSplineBasis::MaxDegree + 1];
+    for (int i = 0; i <= degree; i++)
+        points[i] = glm::vec3(piece[i]) / piece[i].w;
+
+    // the ends of the piece are points of the curve
+    float startDistance = query.Distance(points[0]);
+    float endDistance = query.Distance(points[degree]);
+    if (startDistance < bestDistance)
+    {
+        bestDistance = startDistance;
+        u = start;
+    }
+    if (endDistance < bestDistance)
+    {
+        bestDistance = endDistance;
+        u = end;
+    }
+
+    if (depth == ClosestPointMaxDepth || IsStraight(points, degree))
+    {
+        RefineOnPiece(piece, degree, query, start, end, bestDistance, u);
+        return;
+    }
+
+    glm::vec4 halves[2][BSplineBasis::MaxDegree + 1];
+    SplitBezierInHalves(piece, degree, halves[0], halves[1]);
+
+    float lowerBounds[2];
+    for (int half = 0; half < 2; half++)
+    {
+        SmartGL::Maths::BoundingBox bounds;
+        for (int i = 0; i <= degree; i++)
+            bounds.Expand(glm::vec3(halves[half][i]) / halves[half][i].w);
+        lowerBounds[half] = query.LowerBound(bounds);
+    }
 
-    float curvature = glm::length(glm::cross(Velocity, Acceleration)) / glm::pow<float>(glm::length(Velocity), 3);
-    return curvature;
+    float middle = 0.5f * (start + end);
+    int first = lowerBounds[1] < lowerBounds[0] ? 1 : 0;
+    for (int half : {first, 1 - first})
+    {
+        // the best distance may have dropped while searching the other half
+        if (lowerBounds[half] < bestDistance)
+            SearchPiece(halves[half], degree, query, half == 0 ? start : middle, half == 0 ? middle : end, depth + 1, bestDistance, u);
+    }
 }
 
-CurveDerivativesComponenets BSplineCurve::GetFiniteDifferencesDerivatives(float t) const
+template <typename Query>
+CurveProjection BSplineCurve::FindClosest(const Query &query, int &segment) const
 {
-    float epsilon = 1e-2f;
+    CurveProjection projection = {GetMinT(), glm::vec3(0.0f), std::numeric_limits<float>::max(), 0.0f};
+    if (m_BoundsTree.empty())
+        return projection;
+
+    uint8_t degree = m_Attributes.Degree;
+    int nbSegments = GetSegmentsCount();
+    int nbLeaves = m_BoundsTree.size() / 2;
+
+    float bestDistance = std::numeric_limits<float>::max();
+    float bestU = 0.0f;
+    int bestSegment = -1;
+
+    // only the points closer than the best one of the segments already visited are searched
+    auto visitSegment = [&](int candidate)
+    {
+        float distance = bestDistance;
+        SearchPiece(m_BezierSegments.data() + candidate * m_Attributes.Order, degree, query, 0.0f, 1.0f, 0, distance, bestU);
+        if (distance < bestDistance)
+        {
+            bestDistance = distance;
+            bestSegment = candidate;
+        }
+    };
+
+    // a good first distance lets the walk skip most of the boxes
+    int hint = segment;
+    if (hint >= 0 && hint < nbSegments)
+        visitSegment(hint);
+
+    // depth first, the nearest child is visited first and the other one kept with its distance
+    struct Node
+    {
+        int Index;
+        float Distance;
+    };
+    Node stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = {1, query.LowerBound(m_BoundsTree[1])};
+
+    while (stackSize > 0)
+    {
+        Node node = stack[--stackSize];
+        if (node.Distance >= bestDistance)
+            continue;
 
-    glm::vec3 current_t = EvaluateAt(t);
-    glm::vec3 next_t = EvaluateAt(t + epsilon);
-    glm::vec3 prev_t = EvaluateAt(t - epsilon);
+        if (node.Index >= nbLeaves)
+        {
+            int candidate = node.Index - nbLeaves;
+            if (candidate != hint)
+                visitSegment(candidate);
+            continue;
+        }
+
+        Node left = {2 * node.Index, query.LowerBound(m_BoundsTree[2 * node.Index])};
+        Node right = {2 * node.Index + 1, query.LowerBound(m_BoundsTree[2 * node.Index + 1])};
+        if (left.Distance > right.Distance)
+            std::swap(left, right);
+
+        if (right.Distance < bestDistance)
+            stack[stackSize++] = right;
+        if (left.Distance < bestDistance)
+            stack[stackSize++] = left;
+    }
+
+    if (bestSegment < 0)
+        return projection;
 
-    glm::vec3 velocity = (next_t - prev_t) / (2.0f * epsilon);
-    glm::vec3 acceleration = (next_t - 2.0f * current_t + prev_t) / (epsilon * epsilon);
+    int span = bestSegment + degree;
+    float start = m_Attributes.Knots[span];
+    float end = m_Attributes.Knots[span + 1];
+    glm::vec4 point = BSplineBasis::EvaluateBezier(m_BezierSegments.data() + bestSegment * m_Attributes.Order, degree, bestU);
 
-    return CurveDerivativesComponenets{velocity, acceleration};
+    projection.T = start + bestU * (end - start);
+    projection.Position = glm::vec3(point) / point.w;
+    projection.Distance = bestDistance;
+    projection.RayParameter = query.RayParameter(projection.Position);
+
+    segment = bestSegment;
+    return projection;
+}
+
+CurveProjection BSplineCurve::ClosestPoint(const glm::vec3 &point) const
+{
+    int segment = -1;
+    return FindClosest(PointQuery{point}, segment);
+}
+
+CurveProjection BSplineCurve::ClosestPointToRay(const glm::vec3 &origin, const glm::vec3 &direction) const
+{
+    int segment = -1;
+    return FindClosest(RayQuery{origin, direction}, segment);
+}
+
+void BSplineCurve::ClosestPoints(const glm::vec3 *points, CurveProjection *out, std::size_t count) const
+{
+    SmartGL::Core::JobSystem::ParallelFor(count, ClosestPointQueriesPerJob, [&](uint32_t begin, uint32_t end)
+                                          {
+                                              int segment = -1;
+                                              for (uint32_t i = begin; i < end; i++)
+                                                  out[i] = FindClosest(PointQuery{points[i]}, segment);
+                                          });
+}
+
+void BSplineCurve::ClosestPoints(const std::vector<glm::vec3> &points, std::vector<CurveProjection> &out) const
+{
+    out.resize(points.size());
+    ClosestPoints(points.data(), out.data(), points.size());
+}
+
+void BSplineCurve::ComputeSegmentsBounds(int firstSegment, int lastSegment)
+{
+    // with positive weights a segment lies in the convex hull of its projected Bezier control points
+    for (int segment = firstSegment; segment <= lastSegment; segment++)
+    {
+        const glm::vec4 *bezier = m_BezierSegments.data() + segment * m_Attributes.Order;
+
+        SmartGL::Maths::BoundingBox bounds;
+        for (int i = 0; i <= m_Attributes.Degree; i++)
+            bounds.Expand(glm::vec3(bezier[i]) / bezier[i].w);
+        m_SegmentsBounds[segment] = bounds;
+    }
+}
+
+void BSplineCurve::UpdateBoundsTree(int firstSegment)
+{
+    int nbSegments = GetSegmentsCount();
+    int nbLeaves = 1;
+    while (nbLeaves < nbSegments)
+        nbLeaves *= 2;
+
+    if (m_BoundsTree.size() != 2 * (std::size_t)nbLeaves)
+    {
+        m_BoundsTree.assign(2 * nbLeaves, SmartGL::Maths::BoundingBox());
+        firstSegment = 0;
+    }
+
+    // the leaves left by removed segments must be emptied too
+    int previousSegmentsCount = m_BoundsTreeSegmentsCount;
+    m_BoundsTreeSegmentsCount = nbSegments;
+    firstSegment = glm::min(firstSegment, previousSegmentsCount);
+    if (firstSegment >= glm::max(nbSegments, previousSegmentsCount))
+        return;
+
+    for (int segment = firstSegment; segment < nbLeaves; segment++)
+        m_BoundsTree[nbLeaves + segment] = segment < nbSegments ? m_SegmentsBounds[segment] : SmartGL::Maths::BoundingBox();
+
+    // refit the parents of the updated leaves, level by level
+    for (int first = (nbLeaves + firstSegment) / 2, last = (2 * nbLeaves - 1) / 2; first >= 1; first /= 2, last /= 2)
+    {
+        for (int node = first; node <= last; node++)
+        {
+            m_BoundsTree[node] = m_BoundsTree[2 * node];
+            m_BoundsTree[node].Expand(m_BoundsTree[2 * node + 1]);
+        }
+    }
+}
+
+void BSplineCurve::ComputeBezierSegments(int firstSegment, int lastSegment)
+{
+    uint8_t degree = m_Attributes.Degree;
+
+    for (int segment = firstSegment; segment <= lastSegment; segment++)
+    {
+        int span = segment + degree;
+        glm::vec4 *bezier = m_BezierSegments.data() + segment * m_Attributes.Order;
+
+        // an empty span (repeated knot) is a single point of the curve
+        if (m_Attributes.Knots[span] == m_Attributes.Knots[span + 1])
+        {
+            std::fill(bezier, bezier + m_Attributes.Order, glm::vec4(EvaluateAt(m_Attributes.Knots[span]), 1.0f));
+            continue;
+        }
+
+        BSplineBasis::ExtractBezierSegment(m_Attributes.Knots, m_HomogeneousControlPoints.data(), span, degree, bezier);
+    }
+}
+
+void BSplineCurve::InvalidateSegments(int firstSegment, int lastSegment)
+{
+    if (m_DirtyFirstSegment > m_DirtyLastSegment)
+    {
+        m_DirtyFirstSegment = firstSegment;
+        m_DirtyLastSegment = lastSegment;
+        return;
+    }
+
+    m_DirtyFirstSegment = glm::min(m_DirtyFirstSegment, firstSegment);
+    m_DirtyLastSegment = glm::max(m_DirtyLastSegment, lastSegment);
+}
+
+bool BSplineCurve::HasValidSamples() const
+{
+    if (m_FullEvaluation || m_ControlPoints.size() < m_Attributes.Order)
+        return false;
+
+    return m_Points.size() == GetSegmentsCount() * m_Precision + 1;
+}
+
+bool BSplineCurve::HasValidBezierSegments() const
+{
+    if (!m_BezierSegmentsValid || m_ControlPoints.size() < m_Attributes.Order)
+        return false;
+
+    return m_BezierSegments.size() == GetSegmentsCount() * m_Attributes.Order;
+}
+
+void BSplineCurve::InsertSegment(int segment, bool validSamples)
+{
+    if (validSamples)
+        m_Points.insert(m_Points.begin() + segment * m_Precision, m_Precision, glm::vec3(0.0f));
+    m_BezierSegments.insert(m_BezierSegments.begin() + segment * m_Attributes.Order, m_Attributes.Order, glm::vec4(0.0f));
+    m_ArcLengths.insert(m_ArcLengths.begin() + segment * ArcLengthSubdivisions, ArcLengthSubdivisions, 0.0f);
+    m_SegmentsBounds.insert(m_SegmentsBounds.begin() + segment, SmartGL::Maths::BoundingBox());
+
+    // segments still waiting for an evaluation moved as well
+    if (m_DirtyFirstSegment <= m_DirtyLastSegment)
+    {
+        m_DirtyFirstSegment += m_DirtyFirstSegment >= segment ? 1 : 0;
+        m_DirtyLastSegment += m_DirtyLastSegment >= segment ? 1 : 0;
+    }
+}
+
+void BSplineCurve::EraseSegment(int segment, bool validSamples)
+{
+    if (validSamples)
+        m_Points.erase(m_Points.begin() + segment * m_Precision, m_Points.begin() + (segment + 1) * m_Precision);
+    m_BezierSegments.erase(m_BezierSegments.begin() + segment * m_Attributes.Order, m_BezierSegments.begin() + (segment + 1) * m_Attributes.Order);
+    m_ArcLengths.erase(m_ArcLengths.begin() + segment * ArcLengthSubdivisions, m_ArcLengths.begin() + (segment + 1) * ArcLengthSubdivisions);
+    m_SegmentsBounds.erase(m_SegmentsBounds.begin() + segment);
+
+    if (m_DirtyFirstSegment <= m_DirtyLastSegment)
+    {
+        m_DirtyFirstSegment -= m_DirtyFirstSegment > segment ? 1 : 0;
+        m_DirtyLastSegment -= m_DirtyLastSegment >= segment ? 1 : 0;
+    }
+}
+
+void BSplineCurve::SetControlPoints(const std::vector<glm::vec3> &controlPoints, const std::vector<float> &weights)
+{
+    m_ControlPoints = controlPoints;
+    m_Weights = weights;
+
+    m_HomogeneousControlPoints.resize(controlPoints.size());
+    for (std::size_t i = 0; i < controlPoints.size(); i++)
+        m_HomogeneousControlPoints[i] = glm::vec4(weights[i] * controlPoints[i], weights[i]);
+    m_ControlPointsSoA.Assign(controlPoints, weights);
+
+    InitKnotVector();
+    m_FullEvaluation = true;
+    m_BezierSegmentsValid = false;
+}
+
+void BSplineCurve::SetWeight(std::size_t index, float weight)
+{
+    SMART_ASSERT(weight > 0.0f, "The weights must be strictly positive");
+
+    m_Weights[index] = weight;
+    m_HomogeneousControlPoints[index] = glm::vec4(weight * m_ControlPoints[index], weight);
+    m_ControlPointsSoA.Set(index, m_ControlPoints[index], weight);
+
+    int i = static_cast<int>(index);
+    InvalidateSegments(i - m_Attributes.Degree, i);
+}
+
+void BSplineCurve::SetControlPoint(std::size_t index, const glm::vec3 &position)
+{
+    float weight = m_Weights[index];
+    m_ControlPoints[index] = position;
+    m_HomogeneousControlPoints[index] = glm::vec4(weight * position, weight);
+    m_ControlPointsSoA.Set(index, position, weight);
+
+    // the control point i only weights the segments [i - degree, i]
+    int i = static_cast<int>(index);
+    InvalidateSegments(i - m_Attributes.Degree, i);
+}
+
+void BSplineCurve::InsertControlPoint(std::size_t index, const glm::vec3 &position, float weight)
+{
+    bool validSamples = HasValidSamples();
+    bool validBezierSegments = HasValidBezierSegments();
+    int nbSegments = validBezierSegments ? GetSegmentsCount() : 0;
+
+    m_ControlPoints.insert(m_ControlPoints.begin() + index, position);
+    m_Weights.insert(m_Weights.begin() + index, weight);
+    m_HomogeneousControlPoints.insert(m_HomogeneousControlPoints.begin() + index, glm::vec4(weight * position, weight));
+    m_ControlPointsSoA.Insert(index, position, weight);
+    InitKnotVector();
+
+    // a parameterised knots vector changes everywhere
+    if (!validBezierSegments || m_Type == BSplineType::ChordLength || m_Type == BSplineType::Centripetal)
+    {
+        m_FullEvaluation = true;
+        m_BezierSegmentsValid = false;
+        return;
+    }
+
+    // the segments after the new point keep their shape, they only move one segment further
+    int i = static_cast<int>(index);
+    InsertSegment(glm::min(i, nbSegments), validSamples);
+    InvalidateSegments(i - m_Attributes.Degree, i);
+
+    // the clamped knots of an open uniform curve change the shape of its first and last segments
+    if (m_Type == BSplineType::OpenUniform)
+    {
+        InvalidateSegments(0, m_Attributes.Degree - 1);
+        InvalidateSegments(nbSegments + 1 - m_Attributes.Degree, nbSegments);
+    }
+}
+
+void BSplineCurve::RemoveControlPoint(std::size_t index)
+{
+    bool validSamples = HasValidSamples();
+    bool validBezierSegments = HasValidBezierSegments();
+    int nbSegments = validBezierSegments ? GetSegmentsCount() : 0;
+
+    m_ControlPoints.erase(m_ControlPoints.begin() + index);
+    m_Weights.erase(m_Weights.begin() + index);
+    m_HomogeneousControlPoints.erase(m_HomogeneousControlPoints.begin() + index);
+    m_ControlPointsSoA.Erase(index);
+    InitKnotVector();
+
+    if (!validBezierSegments || m_ControlPoints.size() < m_Attributes.Order || m_Type == BSplineType::ChordLength || m_Type == BSplineType::Centripetal)
+    {
+        m_FullEvaluation = true;
+        m_BezierSegmentsValid = false;
+        return;
+    }
+
+    // the segments after the removed point keep their shape, they only move one segment back
+    int i = static_cast<int>(index);
+    EraseSegment(glm::min(i, nbSegments - 1), validSamples);
+    InvalidateSegments(i - m_Attributes.Degree, i - 1);
+
+    if (m_Type == BSplineType::OpenUniform)
+    {
+        InvalidateSegments(0, m_Attributes.Degree - 1);
+        InvalidateSegments(nbSegments - 1 - m_Attributes.Degree, nbSegments - 2);
+    }
+}
+
+int BSplineCurve::InsertKnot(float t, int times)
+{
+    std::vector<float> &knots = m_Attributes.Knots;
+    std::vector<glm::vec4> &points = m_HomogeneousControlPoints;
+    int degree = m_Attributes.Degree;
+
+    if (m_ControlPoints.size() < m_Attributes.Order || !(t > GetMinT() && t < GetMaxT()))
+        return 0;
+
+    int span = m_SpanLookup.Find(t);
+    int multiplicity = 0;
+    while (multiplicity < degree && knots[span - multiplicity] == t)
+        multiplicity++;
+
+    times = glm::min(times, degree - multiplicity);
+    if (times <= 0)
+        return 0;
+
+    bool validSamples = HasValidSamples();
+    bool validBezierSegments = HasValidBezierSegments();
+    int segment = span - degree;
+
+    points.reserve(points.size() + times);
+    knots.reserve(knots.size() + times);
+
+    for (int r = 0; r < times; r++)
+    {
+        // the points after the span move one index further, the degree points before are blended with their predecessor
+        // (from the last one, the predecessor is still the old point)
+        points.push_back(points.back());
+        for (int i = static_cast<int>(points.size()) - 2; i > span; i--)
+            points[i] = points[i - 1];
+
+        for (int i = span; i > span - degree; i--)
+        {
+            float alpha = (t - knots[i]) / (knots[i + degree] - knots[i]);
+            points[i] = alpha * points[i] + (1.0f - alpha) * points[i - 1];
+        }
+
+        knots.insert(knots.begin() + span + 1, t);
+        span++;
+    }
+
+    SyncControlPoints();
+    m_SpanLookup.Build(knots, m_Attributes.Degree);
+
+    if (!validBezierSegments)
+    {
+        m_FullEvaluation = true;
+        m_BezierSegmentsValid = false;
+        return times;
+    }
+
+    // the shape is unchanged: only the split segment has new Bezier forms, the others move
+    for (int r = 0; r < times; r++)
+        InsertSegment(segment + 1, validSamples);
+    InvalidateSegments(segment, segment + times);
+
+    return times;
+}
+
+void BSplineCurve::RefineKnots(const std::vector<float> &knots)
+{
+    SMART_ASSERT(std::is_sorted(knots.begin(), knots.end()), "The knots to insert must be non-decreasing");
+
+    int nbControlPoints = m_ControlPoints.size();
+    int degree = m_Attributes.Degree;
+
+    if (nbControlPoints < m_Attributes.Order)
+        return;
+
+    // the refined knots vector, merged with the new knots inside the range
+    auto first = std::upper_bound(knots.begin(), knots.end(), GetMinT());
+    auto last = std::lower_bound(first, knots.end(), GetMaxT());
+    if (first == last)
+        return;
+
+    const std::vector<float> &oldKnots = m_Attributes.Knots;
+    m_ScratchKnots.clear();
+    m_ScratchKnots.reserve(oldKnots.size() + (last - first));
+    std::merge(oldKnots.begin(), oldKnots.end(), first, last, std::back_inserter(m_ScratchKnots));
+
+    for (std::size_t i = 1; i + degree + 1 < m_ScratchKnots.size(); i++)
+        SMART_ASSERT(m_ScratchKnots[i] != m_ScratchKnots[i + degree], "A knot is repeated more than degree times");
+
+    // the new control point j is the blossom at the refined knots (j + 1, ..., j + degree),
+    // evaluated on the old span containing the refined knot j (found by walking, the knots are sorted)
+    int nbRefined = m_ScratchKnots.size() - m_Attributes.Order;
+    m_ScratchControlPoints.resize(nbRefined);
+
+    int span = degree;
+    for (int j = 0; j < nbRefined; j++)
+    {
+        while (span < nbControlPoints - 1 && oldKnots[span + 1] <= m_ScratchKnots[j])
+            span++;
+        m_ScratchControlPoints[j] = BSplineBasis::EvaluateBlossom(oldKnots.data(), m_HomogeneousControlPoints.data(), span, degree, m_ScratchKnots.data() + j + 1);
+    }
+
+    // the old arrays become the scratch buffers of the next call
+    std::swap(m_HomogeneousControlPoints, m_ScratchControlPoints);
+    std::swap(m_Attributes.Knots, m_ScratchKnots);
+
+    SyncControlPoints();
+    m_SpanLookup.Build(m_Attributes.Knots, m_Attributes.Degree);
+    m_FullEvaluation = true;
+    m_BezierSegmentsValid = false;
+}
+
+int BSplineCurve::RemoveKnot(float t, int times, float tolerance)
+{
+    const std::vector<float> &knots = m_Attributes.Knots;
+    int nbControlPoints = m_ControlPoints.size();
+    int degree = m_Attributes.Degree;
+
+    if (nbControlPoints < m_Attributes.Order)
+        return 0;
+
+    // the last occurrence of the knot among the interior knots
+    int r = std::upper_bound(knots.begin() + degree + 1, knots.begin() + nbControlPoints, t) - knots.begin() - 1;
+    if (r <= degree || knots[r] != t || !(t > GetMinT()))
+        return 0;
+
+    int s = 1;
+    while (knots[r - s] == t)
+        s++;
+
+    bool validSamples = HasValidSamples();
+    bool validBezierSegments = HasValidBezierSegments();
+    float scale = HomogeneousErrorScale();
+
+    // the bounds of the successive removals add up
+    float totalError = 0.0f;
+    float error;
+    int removed = 0;
+
+    while (removed < times && s > 0 && TryRemoveKnot(r, s, (tolerance - totalError) / scale, error))
+    {
+        totalError += error * scale;
+        removed++;
+
+        // the two spans around the knot merge, the control points [r - degree, r - s] changed
+        if (validBezierSegments)
+        {
+            EraseSegment(r - 1 - degree, validSamples);
+            InvalidateSegments(r - 2 * degree, r - s);
+        }
+
+        r--;
+        s--;
+    }
+
+    if (removed == 0)
+        return 0;
+
+    SyncControlPoints();
+    m_SpanLookup.Build(m_Attributes.Knots, m_Attributes.Degree);
+
+    if (!validBezierSegments)
+    {
+        m_FullEvaluation = true;
+        m_BezierSegmentsValid = false;
+    }
+
+    return removed;
+}
+
+int BSplineCurve::ReduceKnots(float tolerance)
+{
+    const std::vector<float> &knots = m_Attributes.Knots;
+    int degree = m_Attributes.Degree;
+
+    if (m_ControlPoints.size() < m_Attributes.Order)
+        return 0;
+
+    float scale = HomogeneousErrorScale();
+
+    // the error bound accumulated on each knot span by the removals
+    std::vector<float> spanErrors(knots.size(), 0.0f);
+    int removed = 0;
+    bool changed = true;
+
+    while (changed)
+    {
+        changed = false;
+
+        for (int r = degree + 1; r < static_cast<int>(m_HomogeneousControlPoints.size()); r++)
+        {
+            // only the last occurrence of an interior knot is removed
+            if (knots[r + 1] == knots[r] || !(knots[r] > knots[degree]))
+                continue;
+
+            int s = 1;
+            while (knots[r - s] == knots[r])
+                s++;
+
+            // the removal changes the control points [r - degree, r - s], so the spans they weight
+            int firstSpan = r - degree;
+            int lastSpan = r - s + degree;
+            float accumulated = *std::max_element(spanErrors.begin() + firstSpan, spanErrors.begin() + lastSpan + 1);
+
+            float error;
+            if (!TryRemoveKnot(r, s, (tolerance - accumulated) / scale, error))
+                continue;
+
+            for (int span = firstSpan; span <= lastSpan; span++)
+                spanErrors[span] += error * scale;
+
+            // the spans on both sides of the knot merge
+            spanErrors[r - 1] = glm::max(spanErrors[r - 1], spanErrors[r]);
+            spanErrors.erase(spanErrors.begin() + r);
+
+            removed++;
+            changed = true;
+            r--;
+        }
+    }
+
+    if (removed == 0)
+        return 0;
+
+    SyncControlPoints();
+    m_SpanLookup.Build(m_Attributes.Knots, m_Attributes.Degree);
+    m_FullEvaluation = true;
+    m_BezierSegmentsValid = false;
+
+    return removed;
+}
+
+bool BSplineCurve::TryRemoveKnot(int r, int s, float tolerance, float &error)
+{
+    std::vector<float> &knots = m_Attributes.Knots;
+    std::vector<glm::vec4> &points = m_HomogeneousControlPoints;
+    int degree = m_Attributes.Degree;
+    float u = knots[r];
+
+    if (tolerance < 0.0f)
+        return false;
+
+    // the control points [first, last] are solved from both ends towards the middle, temp holds [first - 1, last + 1]
+    int first = r - degree;
+    int last = r - s;
+    int offset = first - 1;
+
+    glm::vec4 temp[BSplineBasis::MaxDegree + 2];
+    temp[0] = points[offset];
+    temp[last + 1 - offset] = points[last + 1];
+
+    int i = first;
+    int j = last;
+    int ii = 1;
+    int jj = last - offset;
+    while (j - i > 0)
+    {
+        float alphaI = (u - knots[i]) / (knots[i + degree + 1] - knots[i]);
+        float alphaJ = (u - knots[j]) / (knots[j + degree + 1] - knots[j]);
+        temp[ii] = (points[i] - (1.0f - alphaI) * temp[ii - 1]) / alphaI;
+        temp[jj] = (points[j] - alphaJ * temp[jj + 1]) / (1.0f - alphaJ);
+        i++;
+        ii++;
+        j--;
+        jj--;
+    }
+
+    // the knot is removable when both solutions agree, the gap between them bounds the change of the curve
+    if (j - i < 0)
+        error = glm::distance(temp[ii - 1], temp[jj + 1]);
+    else
+    {
+        float alphaI = (u - knots[i]) / (knots[i + degree + 1] - knots[i]);
+        error = glm::distance(points[i], alphaI * temp[ii + 1] + (1.0f - alphaI) * temp[ii - 1]);
+    }
+
+    if (error > tolerance)
+        return false;
+
+    i = first;
+    j = last;
+    while (j - i > 0)
+    {
+        points[i] = temp[i - offset];
+        points[j] = temp[j - offset];
+        i++;
+        j--;
+    }
+
+    // erase never reallocates
+    knots.erase(knots.begin() + r);
+    points.erase(points.begin() + (2 * r - s - degree) / 2);
+    return true;
+}
+
+float BSplineCurve::HomogeneousErrorScale() const
+{
+    auto weights = std::minmax_element(m_Weights.begin(), m_Weights.end());
+
+    // a polynomial curve is its own homogeneous curve
+    if (*weights.first == 1.0f && *weights.second == 1.0f)
+        return 1.0f;
+
+    float maxLength = 0.0f;
+    for (const glm::vec3 &point : m_ControlPoints)
+        maxLength = glm::max(maxLength, glm::length(point));
+
+    return (1.0f + maxLength) / *weights.first;
+}
+
+void BSplineCurve::SyncControlPoints()
+{
+    std::size_t nbControlPoints = m_HomogeneousControlPoints.size();
+    m_ControlPoints.resize(nbControlPoints);
+    m_Weights.resize(nbControlPoints);
+
+    for (std::size_t i = 0; i < nbControlPoints; i++)
+    {
+        const glm::vec4 &point = m_HomogeneousControlPoints[i];
+        m_ControlPoints[i] = glm::vec3(point) / point.w;
+        m_Weights[i] = point.w;
+    }
+    m_ControlPointsSoA.Assign(m_ControlPoints, m_Weights);
+}
+
+/**
+ * @brief The span and the (degree + 1) basis functions of each parameter, the parameters are sorted so the spans are walked
+ * @param spans Output, count spans
+ * @param basis Output, count * (degree + 1) values
+ */
+static void ComputeSortedBasisFunctions(const float *knots, int degree, int nbControlPoints, const float *parameters, int count, int *spans, float *basis)
+{
+    auto compute = [&](auto &&computeBasis)
+    {
+        int span = degree;
+        for (int k = 0; k < count; k++)
+        {
+            while (span < nbControlPoints - 1 && knots[span + 1] <= parameters[k])
+                span++;
+            spans[k] = span;
+            computeBasis(span, parameters[k], basis + k * (degree + 1));
+        }
+    };
+
+    // unrolled basis functions for the common degrees
+    bool specialised = BSplineKernels::DispatchDegree(degree, [&](auto degreeConstant)
+    {
+        constexpr int Degree = decltype(degreeConstant)::value;
+        compute([knots](int span, float t, float *out)
+                { BSplineKernel<Degree>::ComputeBasisFunctions(knots, span, t, out); });
+    });
+
+    if (!specialised)
+        compute([knots, degree](int span, float t, float *out)
+                { BSplineBasis::ComputeBasisFunctions(knots, span, degree, t, out); });
+}
+
+float BSplineCurve::Fit(const std::vector<glm::vec3> &points, uint8_t degree, uint32_t nbControlPoints, float tolerance)
+{
+    return Fit(points.data(), points.size(), degree, nbControlPoints, tolerance);
+}
+
+float BSplineCurve::Fit(const glm::vec3 *points, std::size_t count, uint8_t degree, uint32_t nbControlPoints, float tolerance)
+{
+    degree = glm::min(degree, BSplineBasis::MaxDegree);
+    SMART_ASSERT(count > degree, "Fitting needs more points than the degree");
+
+    int nbPoints = static_cast<int>(count);
+    int n = glm::clamp(static_cast<int>(nbControlPoints), degree + 1, nbPoints);
+
+    m_Attributes.Degree = degree;
+    m_Attributes.Order = degree + 1;
+
+    m_FitParameters.resize(nbPoints);
+    BSplineBasis::ComputeChordParameters(points, count, 1.0f, m_FitParameters.data());
+    const float *parameters = m_FitParameters.data();
+
+    // clamped knots sharing the points evenly between the spans (Piegl & Tiller), so that every basis function weights some points
+    std::vector<float> &knots = m_Attributes.Knots;
+    knots.resize(n + degree + 1);
+    std::fill(knots.begin(), knots.begin() + degree + 1, 0.0f);
+    std::fill(knots.end() - degree - 1, knots.end(), 1.0f);
+
+    float step = static_cast<float>(nbPoints) / (n - degree);
+    for (int j = 1; j < n - degree; j++)
+    {
+        int i = static_cast<int>(j * step);
+        float alpha = j * step - i;
+        knots[degree + j] = (1.0f - alpha) * parameters[i - 1] + alpha * parameters[i];
+    }
+
+    float error;
+    while (true)
+    {
+        SolveFit(points, nbPoints, n);
+        error = ComputeFitError(points, nbPoints);
+        if (error <= tolerance || n >= nbPoints)
+            break;
+
+        // each span missing the tolerance is split between its points, the error of a piece of length h
+        // decreases as h^(degree + 1) so the number of pieces follows the excess. The spans with a single point are final
+        m_ScratchKnots.clear();
+        int first = 0;
+        for (int span = degree; span < n; span++)
+        {
+            int last = first;
+            while (last < nbPoints && (parameters[last] < knots[span + 1] || span == n - 1))
+                last++;
+
+            int spanPoints = last - first;
+            if (m_FitSpanErrors[span] > tolerance && spanPoints >= 2)
+            {
+                int pieces = static_cast<int>(std::ceil(std::pow(m_FitSpanErrors[span] / tolerance, 1.0f / (degree + 1))));
+                pieces = glm::clamp(pieces, 2, spanPoints);
+
+                for (int piece = 1; piece < pieces && n + static_cast<int>(m_ScratchKnots.size()) < nbPoints; piece++)
+                {
+                    int middle = first + piece * spanPoints / pieces;
+                    m_ScratchKnots.push_back(0.5f * (parameters[middle - 1] + parameters[middle]));
+                }
+            }
+            first = last;
+        }
+
+        if (m_ScratchKnots.empty())
+            break;
+
+        // both are sorted, merged from the end the knots vector grows in place
+        int i = static_cast<int>(knots.size()) - 1;
+        int j = static_cast<int>(m_ScratchKnots.size()) - 1;
+        knots.resize(knots.size() + m_ScratchKnots.size());
+        for (int k = static_cast<int>(knots.size()) - 1; j >= 0; k--)
+            knots[k] = i >= 0 && knots[i] > m_ScratchKnots[j] ? knots[i--] : m_ScratchKnots[j--];
+
+        n += m_ScratchKnots.size();
+    }
+
+    SyncControlPoints();
+    m_SpanLookup.Build(knots, degree);
+    m_FullEvaluation = true;
+    m_BezierSegmentsValid = false;
+
+    return error;
+}
+
+void BSplineCurve::SolveFit(const glm::vec3 *points, int count, int nbControlPoints)
+{
+    const std::vector<float> &knots = m_Attributes.Knots;
+    int degree = m_Attributes.Degree;
+    int bandWidth = degree + 1;
+
+    m_FitSpans.resize(count);
+    m_FitBasis.resize(count * bandWidth);
+    ComputeSortedBasisFunctions(knots.data(), degree, nbControlPoints, m_FitParameters.data(), count, m_FitSpans.data(), m_FitBasis.data());
+
+    m_HomogeneousControlPoints.resize(nbControlPoints);
+    m_HomogeneousControlPoints.front() = glm::vec4(points[0], 1.0f);
+    m_HomogeneousControlPoints.back() = glm::vec4(points[count - 1], 1.0f);
+
+    // the row i of the system is the control point i + 1
+    int nbUnknowns = nbControlPoints - 2;
+    if (nbUnknowns <= 0)
+        return;
+
+    m_FitBand.assign(nbUnknowns * bandWidth, 0.0);
+    m_FitRightHandSide.assign(nbUnknowns, glm::dvec3(0.0));
+
+    // normal equations, each interior point adds the products of its degree + 1 basis functions
+    glm::dvec3 firstPoint(points[0]);
+    glm::dvec3 lastPoint(points[count - 1]);
+
+    for (int k = 1; k < count - 1; k++)
+    {
+        int span = m_FitSpans[k];
+        const float *basis = m_FitBasis.data() + k * bandWidth;
+
+        // the share of the fixed end control points is known
+        glm::dvec3 target(points[k]);
+        if (span == degree)
+            target -= static_cast<double>(basis[0]) * firstPoint;
+        if (span == nbControlPoints - 1)
+            target -= static_cast<double>(basis[degree]) * lastPoint;
+
+        for (int a = 0; a <= degree; a++)
+        {
+            int row = span - degree + a - 1;
+            if (row < 0 || row >= nbUnknowns)
+                continue;
+
+            m_FitRightHandSide[row] += static_cast<double>(basis[a]) * target;
+            for (int b = 0; b <= a; b++)
+            {
+                int column = span - degree + b - 1;
+                if (column >= 0)
+                    m_FitBand[row * bandWidth + row - column] += static_cast<double>(basis[a]) * basis[b];
+            }
+        }
+    }
+
+    // banded Cholesky factorisation in place, L(i, j) is stored at [i * bandWidth + i - j].
+    // A control point without any point to follow has a null row, its pivot is floored to keep the solution finite
+    for (int i = 0; i < nbUnknowns; i++)
+    {
+        double *row = m_FitBand.data() + i * bandWidth;
+        double diagonal = row[0];
+        int firstColumn = glm::max(i - degree, 0);
+
+        for (int j = firstColumn; j <= i; j++)
+        {
+            const double *rowJ = m_FitBand.data() + j * bandWidth;
+            double sum = row[i - j];
+            for (int k = firstColumn; k < j; k++)
+                sum -= row[i - k] * rowJ[j - k];
+
+            if (j < i)
+                row[i - j] = sum / rowJ[0];
+            else
+                row[0] = std::sqrt(glm::max(sum, 1e-12 * glm::max(diagonal, 1.0)));
+        }
+    }
+
+    // L y = b then L^T x = y
+    for (int i = 0; i < nbUnknowns; i++)
+    {
+        const double *row = m_FitBand.data() + i * bandWidth;
+        glm::dvec3 sum = m_FitRightHandSide[i];
+        for (int k = glm::max(i - degree, 0); k < i; k++)
+            sum -= row[i - k] * m_FitRightHandSide[k];
+        m_FitRightHandSide[i] = sum / row[0];
+    }
+
+    for (int i = nbUnknowns - 1; i >= 0; i--)
+    {
+        glm::dvec3 sum = m_FitRightHandSide[i];
+        for (int k = i + 1; k <= glm::min(i + degree, nbUnknowns - 1); k++)
+            sum -= m_FitBand[k * bandWidth + k - i] * m_FitRightHandSide[k];
+        m_FitRightHandSide[i] = sum / m_FitBand[i * bandWidth];
+
+        m_HomogeneousControlPoints[i + 1] = glm::vec4(glm::vec3(m_FitRightHandSide[i]), 1.0f);
+    }
+}
+
+float BSplineCurve::ComputeFitError(const glm::vec3 *points, int count)
+{
+    const std::vector<float> &knots = m_Attributes.Knots;
+    int degree = m_Attributes.Degree;
+
+    m_FitSpanErrors.assign(knots.size(), 0.0f);
+    float error = 0.0f;
+
+    // the basis functions of the solve are still those of the current knots
+    for (int k = 0; k < count; k++)
+    {
+        int span = m_FitSpans[k];
+        const float *basis = m_FitBasis.data() + k * (degree + 1);
+
+        // the fitted curve is polynomial, the weights are 1
+        glm::vec3 point(0.0f);
+        for (int j = 0; j <= degree; j++)
+            point += basis[j] * glm::vec3(m_HomogeneousControlPoints[span - degree + j]);
+
+        float distance = glm::distance(point, points[k]);
+        m_FitSpanErrors[span] = glm::max(m_FitSpanErrors[span], distance);
+        error = glm::max(error, distance);
+    }
+
+    return error;
+}
+
+glm::vec3 BSplineCurve::EvaluateAt(float t) const
+{
+    int nbControlPoints = m_ControlPoints.size();
+    uint8_t degree = m_Attributes.Degree;
+
+    glm::vec3 point(0.0f);
+
+    if (nbControlPoints < m_Attributes.Order)
+        return point;
+
+    int span = m_SpanLookup.Find(t);
+
+    // unrolled kernel for the common degrees
+    glm::vec4 homogeneousPoint(0.0f);
+    bool specialised = BSplineKernels::DispatchDegree(degree, [&](auto degreeConstant)
+    {
+        constexpr int Degree = decltype(degreeConstant)::value;
+        homogeneousPoint = BSplineKernel<Degree, 4>::Evaluate(m_Attributes.Knots.data(), m_HomogeneousControlPoints.data(), span, t);
+    });
+
+    if (!specialised)
+    {
+        // compute the homogeneous point on the curve at t
+        // by summing the control points of the span weighted by the non-zero basis functions
+        float basis[BSplineBasis::MaxDegree + 1];
+        BSplineBasis::ComputeBasisFunctions(m_Attributes.Knots, span, degree, t, basis);
+
+        for (int i = 0; i <= degree; ++i)
+            homogeneousPoint += basis[i] * m_HomogeneousControlPoints[span - degree + i];
+    }
+
+    point = glm::vec3(homogeneousPoint) / homogeneousPoint.w;
+    return point;
+}
+
+void BSplineCurve::EvaluateBatch(const float *ts, glm::vec3 *out, std::size_t count) const
+{
+    if (m_ControlPoints.size() < m_Attributes.Order)
+    {
+        std::fill(out, out + count, glm::vec3(0.0f));
+        return;
+    }
+
+    BSplineBatchData data = {m_Attributes.Knots, m_ControlPointsSoA, m_Attributes.Degree, m_SpanLookup};
+    SmartGL::Core::JobSystem::ParallelFor(count, BatchParametersPerJob, [&](uint32_t begin, uint32_t end)
+                                          { BSplineSIMD::EvaluateBatch(data, ts + begin, out + begin, end - begin); });
+}
+
+void BSplineCurve::EvaluateBatch(const std::vector<float> &ts, std::vector<glm::vec3> &out) const
+{
+    out.resize(ts.size());
+    EvaluateBatch(ts.data(), out.data(), ts.size());
+}
+
+void BSplineCurve::InitKnotVector()
+{
+    ComputeKnotVector(m_Type, m_Attributes.Degree, m_ControlPoints, m_Attributes.Knots);
+    m_SpanLookup.Build(m_Attributes.Knots, m_Attributes.Degree);
+}
+
+void BSplineCurve::ComputeKnotVector(BSplineType type, uint8_t degree, const std::vector<glm::vec3> &controlPoints, std::vector<float> &knots)
+{
+    int numControlPoints = controlPoints.size();
+    int order = degree + 1;
+
+    // the number of knots is equal to the number of control points + the degree + 1
+    int numKnots = numControlPoints + order;
+
+    knots.clear();
+    knots.resize(numKnots);
+
+    switch (type)
+    {
+    case BSplineType::Uniform:
+        for (int i = 0; i < numKnots; ++i)
+            knots[i] = static_cast<float>(i);
+        break;
+
+    case BSplineType::OpenUniform:
+        for (int i = 0; i < numKnots; ++i)
+        {
+            if (i <= degree)
+                knots[i] = 0.0f; // Repeat the first knot
+            else if (degree < i && i <= (int)knots.size() - degree - 1)
+                knots[i] = static_cast<float>(i - degree);
+            else
+                knots[i] = static_cast<float>(numControlPoints - order + 2); // Repeat the last knot
+        }
+        break;
+
+    case BSplineType::ChordLength:
+    case BSplineType::Centripetal:
+    {
+        // same range as the open uniform knots, one unit per segment on average
+        std::vector<float> parameters;
+        BSplineBasis::ComputeChordParameters(controlPoints, type == BSplineType::ChordLength ? 1.0f : 0.5f, parameters);
+        float end = static_cast<float>(glm::max(numControlPoints - degree, 1));
+        BSplineBasis::ComputeAveragedKnots(parameters, degree, end, knots);
+        break;
+    }
+
+    default:
+        SMART_LOG_CRITICAL("Unknown BSplineType");
+        exit(1);
+        break;
+    }
+}
+
+void BSplineCurve::SetKnotVector(const std::vector<float> &knots)
+{
+    uint8_t degree = m_Attributes.Degree;
+    SMART_ASSERT(knots.size() == m_ControlPoints.size() + m_Attributes.Order, "The knots vector must have (control points + degree + 1) values");
+    SMART_ASSERT(std::is_sorted(knots.begin(), knots.end()), "The knots vector must be non-decreasing");
+
+    // a knot repeated more than degree times inside the range splits the curve (and empties the Bezier extraction)
+    for (std::size_t i = 1; i + degree + 1 < knots.size(); i++)
+        SMART_ASSERT(knots[i] != knots[i + degree], "A knot is repeated more than degree times");
+
+    m_Attributes.Knots = knots;
+    m_SpanLookup.Build(m_Attributes.Knots, degree);
+    m_FullEvaluation = true;
+    m_BezierSegmentsValid = false;
+}
+
+void BSplineCurve::SetType(BSplineType type)
+{
+    m_Type = type;
+    InitKnotVector();
+    m_FullEvaluation = true;
+    m_BezierSegmentsValid = false;
+}
+
+CurvePointDerivatives BSplineCurve::EvaluateDerivativesAt(float t) const
+{
+    int nbControlPoints = m_ControlPoints.size();
+    uint8_t degree = m_Attributes.Degree;
+
+    CurvePointDerivatives point = {glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f)};
+
+    if (nbControlPoints < m_Attributes.Order)
+        return point;
+
+    // the basis functions and their derivatives share the same span and the same triangular table
+    float derivatives[BSplineBasis::MaxDerivative + 1][BSplineBasis::MaxDegree + 1];
+    int span = m_SpanLookup.Find(t);
+    BSplineBasis::ComputeBasisFunctionsDerivatives(m_Attributes.Knots, span, degree, t, 2, derivatives);
+
+    // derivatives of the homogeneous curve A(t) = (w * C(t), w(t))
+    glm::vec4 homogeneous[3] = {glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f)};
+    for (int i = 0; i <= degree; ++i)
+    {
+        const glm::vec4 &controlPoint = m_HomogeneousControlPoints[span - degree + i];
+        homogeneous[0] += derivatives[0][i] * controlPoint;
+        homogeneous[1] += derivatives[1][i] * controlPoint;
+        homogeneous[2] += derivatives[2][i] * controlPoint;
+    }
+
+    // quotient rule: w * C = A, so w * C' = A' - w' * C and w * C'' = A'' - 2 * w' * C' - w'' * C
+    float weight = homogeneous[0].w;
+    point.Position = glm::vec3(homogeneous[0]) / weight;
+    point.Velocity = (glm::vec3(homogeneous[1]) - homogeneous[1].w * point.Position) / weight;
+    point.Acceleration = (glm::vec3(homogeneous[2]) - 2.0f * homogeneous[1].w * point.Velocity - homogeneous[2].w * point.Position) / weight;
+
+    return point;
+}
+
+CurveFrenetFrameComponents BSplineCurve::ComputeFrenetFrame(const CurvePointDerivatives &derivatives)
+{
+    const glm::vec3 &velocity = derivatives.Velocity;
+    const glm::vec3 &acceleration = derivatives.Acceleration;
+
+    glm::vec3 tangent = glm::normalize(velocity);
+    glm::vec3 normal = glm::normalize(glm::cross(velocity, glm::cross(acceleration, velocity)));
+    glm::vec3 binormal = glm::cross(tangent, normal);
+
+    return CurveFrenetFrameComponents{tangent, normal, binormal};
+}
+
+float BSplineCurve::ComputeCurvature(const CurvePointDerivatives &derivatives)
+{
+    const glm::vec3 &velocity = derivatives.Velocity;
+    const glm::vec3 &acceleration = derivatives.Acceleration;
+
+    return glm::length(glm::cross(velocity, acceleration)) / glm::pow<float>(glm::length(velocity), 3);
+}
+
+CurveFrenetFrameComponents BSplineCurve::GetFrenetFrameAt(float t) const
+{
+    return ComputeFrenetFrame(EvaluateDerivativesAt(t));
+}
+
+float BSplineCurve::GetCurvatureAt(float t) const
+{
+    return ComputeCurvature(EvaluateDerivativesAt(t));
 }
@@ -5,6 +5,11 @@
 
 #include "glm/glm.hpp"
 
+#include "Maths/BoundingBox.h"
+
+#include "BSplineBasis.h"
+#include "BSplineSIMD.h"
+
 struct BSplineAttributes
 {
 
@@ -36,6 +41,55 @@ enum class BSplineType
      * @note The courve starts at the first control point and ends at the last control point
      */
     OpenUniform,
+
+    /**
+     * @brief Clamped knots vector following the lengths of the control polygon legs
+     * @note The knots are computed when the control points are set, inserted or removed, moving a control point keeps them
+     */
+    ChordLength,
+
+    /**
+     * @brief Clamped knots vector following the square roots of the control polygon legs lengths
+     * @note Less overshoot than the chord length on sharp turns, the knots are kept when a control point moves
+     */
+    Centripetal,
+};
+
+enum class CurveTessellationMode
+{
+    /**
+     * @brief Each segment is sampled with the same number of points (see SetPrecision)
+     */
+    Uniform,
+
+    /**
+     * @brief Each segment is subdivided until the tolerances are met (see SetTessellationTolerance)
+     * @note Straight parts get few points and tight bends many, the parameter of each point is kept (see GetParameters)
+     */
+    Adaptive,
+
+    /**
+     * @brief The control points are refined by Lane-Riesenfeld subdivision (see SetSubdivisionLevels)
+     * @note Only for uniform knots, each level costs a few additions per point and gives the points of the uniform mode with 2^levels samples per segment.
+     * The other knots vectors are sampled like the uniform mode
+     */
+    Subdivision,
+};
+
+/**
+ * @brief Tolerances of the adaptive tessellation, a piece of the curve is kept as a single edge when both are met
+ */
+struct CurveTessellationTolerance
+{
+    /**
+     * @brief Maximum distance between the curve and the edge replacing it
+     */
+    float ChordalDeviation = 1e-3f;
+
+    /**
+     * @brief Maximum rotation of the tangent along the piece of curve replaced by an edge (radians)
+     */
+    float Angle = 0.1f;
 };
 
 struct CurveFrenetFrameComponents
@@ -51,26 +105,76 @@ struct CurveDerivativesComponenets
     glm::vec3 Acceleration;
 };
 
+/**
+ * @brief A point of the curve with its first and second derivatives, computed in one pass
+ */
+struct CurvePointDerivatives
+{
+    glm::vec3 Position;
+    glm::vec3 Velocity;
+    glm::vec3 Acceleration;
+};
+
+/**
+ * @brief Result of a closest point query
+ */
+struct CurveProjection
+{
+    float T;              // parameter of the closest point
+    glm::vec3 Position;   // closest point of the curve
+    float Distance;       // distance between the curve and the query
+    float RayParameter;   // distance along the ray of the point closest to the curve (ray queries only)
+};
+
 class BSplineCurve
 {
 public:
     BSplineCurve() = default;
     BSplineCurve(uint8_t degree);
     BSplineCurve(uint8_t degree, std::vector<glm::vec3> controlPoints);
+
+    /**
+     * @brief Create a rational B-Spline (NURBS) curve
+     * @param degree The degree of the curve
+     * @param controlPoints The control points
+     * @param weights The weight of each control point (strictly positive), a curve with equal weights is a plain B-Spline
+     */
+    BSplineCurve(uint8_t degree, std::vector<glm::vec3> controlPoints, std::vector<float> weights);
     ~BSplineCurve();
 
     /**
-     * @brief Evaluate all the points of the B-Spline curve
+     * @brief Evaluate the points of the B-Spline curve
+     * @note Each segment (knot span) is sampled with m_Precision points, plus the end point of the curve.
+     * Only the segments invalidated since the last call are re-evaluated (see SetControlPoint).
+     * The segments are shared between the threads of the job system, the result does not depend on the threads count
      */
     void Evaluate();
 
     /**
      * @brief Evaluate the B-Spline curve at a given t
+     * @note The homogeneous point is evaluated then divided by its weight (rational curve)
      * @param t A value between the minimum value and the maximum value of the knots vector
      * @return The point on the curve at t
      */
     glm::vec3 EvaluateAt(float t) const;
 
+    /**
+     * @brief Evaluate the B-Spline curve at many parameters at once
+     * @note Uses the widest vector instruction set of the CPU (AVX-512, AVX2) with a scalar fallback,
+     * large batches are split between the threads of the job system
+     * @param ts The parameters, between the minimum value and the maximum value of the knots vector
+     * @param out Output, count points
+     * @param count The number of parameters
+     */
+    void EvaluateBatch(const float *ts, glm::vec3 *out, std::size_t count) const;
+
+    /**
+     * @brief Evaluate the B-Spline curve at many parameters at once
+     * @param ts The parameters
+     * @param out Output, resized to the number of parameters
+     */
+    void EvaluateBatch(const std::vector<float> &ts, std::vector<glm::vec3> &out) const;
+
     /**
      * @brief Evaluate the frenet frame at a given t
      * @param t A value between the minimum value and the maximum value of the knots vector
@@ -79,10 +183,41 @@ public:
     CurveFrenetFrameComponents GetFrenetFrameAt(float t) const;
 
     /**
-     * @brief Compute the knots vector based on the type of B-Spline (uniform, open uniform)
+     * @brief Evaluate the point, the velocity and the acceleration at a given t from the basis functions derivatives
+     * @note The derivatives of the rational curve are exact, they are obtained from the homogeneous ones with the quotient rule
+     * @param t A value between the minimum value and the maximum value of the knots vector
+     * @return The position, first and second derivatives at t
+     */
+    CurvePointDerivatives EvaluateDerivativesAt(float t) const;
+
+    /**
+     * @brief Compute the frenet frame from already evaluated derivatives
+     * @param derivatives The derivatives at the point (see EvaluateDerivativesAt)
+     * @return The tangent, normal and binormal vectors
+     */
+    static CurveFrenetFrameComponents ComputeFrenetFrame(const CurvePointDerivatives &derivatives);
+
+    /**
+     * @brief Compute the curvature from already evaluated derivatives
+     * @param derivatives The derivatives at the point (see EvaluateDerivativesAt)
+     * @return The curvature
+     */
+    static float ComputeCurvature(const CurvePointDerivatives &derivatives);
+
+    /**
+     * @brief Compute the knots vector based on the type of B-Spline (uniform, open uniform, chord length, centripetal)
      */
     void InitKnotVector();
 
+    /**
+     * @brief Compute the knots vector of a type of B-Spline
+     * @param type The type of knots vector
+     * @param degree The degree of the B-Spline
+     * @param controlPoints The control points (only read by the chord length and centripetal types)
+     * @param knots Output, controlPoints.size() + degree + 1 values
+     */
+    static void ComputeKnotVector(BSplineType type, uint8_t degree, const std::vector<glm::vec3> &controlPoints, std::vector<float> &knots);
+
     /**
      * @brief Compute the curvature at a given t
      * @param t A value between the minimum value and the maximum value of the knots vector
@@ -90,63 +225,440 @@ public:
      */
     float GetCurvatureAt(float t) const;
 
+    /**
+     * @brief Number of subdivisions of each segment in the arc length table
+     */
+    static constexpr int ArcLengthSubdivisions = 16;
+
+    /**
+     * @brief The length of the curve, from the arc length table built by the last Evaluate
+     */
+    float GetLength() const;
+
+    /**
+     * @brief The length of the curve between its start and t
+     * @param t A value between the minimum value and the maximum value of the knots vector
+     */
+    float LengthAtParameter(float t) const;
+
+    /**
+     * @brief The parameter of the point at the length s from the start of the curve (inverse of LengthAtParameter)
+     * @note O(log n) search of the segment and of its subdivision in the arc length table, then a few Newton steps
+     * @param s A length between 0 and GetLength(), clamped otherwise
+     */
+    float ParameterAtLength(float s) const;
+
+    /**
+     * @brief Evaluate the point at the length s from the start of the curve
+     * @param s A length between 0 and GetLength(), clamped otherwise
+     */
+    glm::vec3 EvaluateAtLength(float s) const;
+
+    /**
+     * @brief Compute the parameters of count points equally spaced along the curve between two lengths (both included)
+     * @note The lengths are sorted so the table is walked instead of searched for each point, large batches are split between the threads of the job system
+     * @param fromLength The length of the first point
+     * @param toLength The length of the last point
+     * @param count The number of points
+     * @param parameters Output, count parameters
+     */
+    void ResampleByLength(float fromLength, float toLength, uint32_t count, std::vector<float> &parameters) const;
+
+    /**
+     * @brief Sample the whole curve with count points equally spaced along the curve (constant speed)
+     * @param count The number of points
+     * @param parameters Output, count parameters
+     * @param points Output, count points
+     */
+    void ResampleByLength(uint32_t count, std::vector<float> &parameters, std::vector<glm::vec3> &points) const;
+
+    /**
+     * @brief Find the point of the curve closest to a point
+     * @note The hierarchy of the segments bounding boxes is walked nearest box first, the boxes farther than the best point are skipped.
+     * Each remaining segment is split the same way until its pieces are nearly straight, then every local minimum of a piece
+     * is refined with Newton steps. Uses the segments of the last Evaluate
+     * @param point The query point
+     */
+    CurveProjection ClosestPoint(const glm::vec3 &point) const;
+
+    /**
+     * @brief Find the point of the curve closest to a ray (picking)
+     * @param origin The origin of the ray
+     * @param direction The normalized direction of the ray
+     */
+    CurveProjection ClosestPointToRay(const glm::vec3 &origin, const glm::vec3 &direction) const;
+
+    /**
+     * @brief ClosestPoint of many points, large batches are split between the threads of the job system
+     * @note Each query first tries the segment found for the previous point, coherent points are the fastest
+     * @param points The query points
+     * @param out Output, count projections
+     * @param count
+     */
+    void ClosestPoints(const glm::vec3 *points, CurveProjection *out, std::size_t count) const;
+
+    /**
+     * @brief Same as above on vectors, out is resized to the number of points
+     */
+    void ClosestPoints(const std::vector<glm::vec3> &points, std::vector<CurveProjection> &out) const;
+
+    /**
+     * @brief Bounding box of each segment (box of its Bezier control points, which contain the segment)
+     */
+    inline const std::vector<SmartGL::Maths::BoundingBox> &GetSegmentsBounds() const { return m_SegmentsBounds; }
+
     inline const std::vector<glm::vec3> &GetPoints() const { return m_Points; }
 
+    /**
+     * @brief The parameter of each point of GetPoints in adaptive mode, empty in uniform mode
+     */
+    inline const std::vector<float> &GetParameters() const { return m_Parameters; }
+
+    inline void SetTessellationMode(CurveTessellationMode mode)
+    {
+        m_TessellationMode = mode;
+        m_FullEvaluation = true;
+    }
+    inline CurveTessellationMode GetTessellationMode() const { return m_TessellationMode; }
+
+    /**
+     * @brief Set the number of subdivision levels of the subdivision mode, each segment gets 2^levels points
+     */
+    inline void SetSubdivisionLevels(uint8_t levels)
+    {
+        m_SubdivisionLevels = glm::clamp(levels, (uint8_t)1, MaxSubdivisionLevels);
+        m_FullEvaluation = true;
+    }
+    inline uint8_t GetSubdivisionLevels() const { return m_SubdivisionLevels; }
+
+    /**
+     * @brief Highest number of subdivision levels, as many points per segment as the highest precision
+     */
+    static constexpr uint8_t MaxSubdivisionLevels = 10;
+
+    inline void SetTessellationTolerance(const CurveTessellationTolerance &tolerance) { m_TessellationTolerance = tolerance; }
+    inline const CurveTessellationTolerance &GetTessellationTolerance() const { return m_TessellationTolerance; }
+
+    /**
+     * @brief Set the control points, all the weights are reset to 1
+     */
     inline void SetControlPoints(const std::vector<glm::vec3> &controlPoints)
     {
-        m_ControlPoints = controlPoints;
-        InitKnotVector();
+        SetControlPoints(controlPoints, std::vector<float>(controlPoints.size(), 1.0f));
     }
+
+    /**
+     * @brief Set the control points and their weights
+     * @param controlPoints The control points
+     * @param weights The weight of each control point (strictly positive)
+     */
+    void SetControlPoints(const std::vector<glm::vec3> &controlPoints, const std::vector<float> &weights);
+
+    /**
+     * @brief Change the weight of a single control point, it pulls the curve towards the point when greater than the others
+     * @note Only the degree + 1 segments influenced by the control point will be re-evaluated
+     * @param index The index of the control point
+     * @param weight The new weight (strictly positive)
+     */
+    void SetWeight(std::size_t index, float weight);
+
+    /**
+     * @brief Move a single control point (its weight is kept), only the degree + 1 segments it influences will be re-evaluated
+     * @param index The index of the control point
+     * @param position The new position
+     */
+    void SetControlPoint(std::size_t index, const glm::vec3 &position);
+
+    /**
+     * @brief Insert a control point, the samples of the untouched segments are shifted instead of re-evaluated
+     * @param index The index of the new control point
+     * @param position The position of the new control point
+     * @param weight The weight of the new control point
+     */
+    void InsertControlPoint(std::size_t index, const glm::vec3 &position, float weight = 1.0f);
+
+    /**
+     * @brief Remove a control point, the samples of the untouched segments are shifted instead of re-evaluated
+     * @param index The index of the control point to remove
+     */
+    void RemoveControlPoint(std::size_t index);
+
     inline const std::vector<glm::vec3> &GetControlPoints() const { return m_ControlPoints; }
+    inline const std::vector<float> &GetWeights() const { return m_Weights; }
     inline const std::size_t GetControlPointsCount() const { return m_ControlPoints.size(); }
 
-    inline void SetKnotVector(std::vector<float> &knots)
-    {
-        m_Attributes.Knots = knots;
-    }
+    /**
+     * @brief Set an arbitrary knots vector, it is replaced by the one of the type when control points are inserted or removed
+     * @param knots Non-decreasing values, the number of control points + degree + 1 of them.
+     * Repeated knots are allowed, at most degree times inside the range
+     */
+    void SetKnotVector(const std::vector<float> &knots);
     inline const std::vector<float> &GetKnotsVector() const { return m_Attributes.Knots; }
     inline const std::vector<glm::vec3> &GetKnotsPoints() const { return m_Knots; }
 
+    /**
+     * @brief Insert a knot without changing the shape of the curve (Boehm's algorithm)
+     * @note The control points around the knot are updated in place and one is added per insertion,
+     * only the split segment is re-evaluated. Like SetKnotVector, the knots are replaced by the ones of the type when control points are inserted or removed
+     * @param t The knot, strictly inside the range of the curve
+     * @param times The number of insertions, limited so that the multiplicity of the knot stays at most degree
+     * @return The number of knots inserted
+     */
+    int InsertKnot(float t, int times = 1);
+
+    /**
+     * @brief Insert many knots at once without changing the shape of the curve (Oslo algorithm)
+     * @note Each new control point is the blossom of the curve at degree consecutive knots of the refined vector,
+     * they are computed in scratch buffers kept between the calls. The whole curve is re-evaluated
+     * @param knots Non-decreasing values, the ones outside the range of the curve are ignored
+     */
+    void RefineKnots(const std::vector<float> &knots);
+
+    /**
+     * @brief Remove a knot as long as the curve moves less than the tolerance (Tiller's algorithm)
+     * @note The control points are updated in place, only the segments around the knot are re-evaluated
+     * @param t The knot to remove
+     * @param times The maximum number of removals
+     * @param tolerance The maximum distance between the old and the new curve
+     * @return The number of knots removed
+     */
+    int RemoveKnot(float t, int times, float tolerance);
+
+    /**
+     * @brief Remove as many knots as possible while the curve moves less than the tolerance (data reduction)
+     * @note The error bound of each removal is accumulated on the spans it changes, a knot is only removed
+     * if the bounds of these spans stay under the tolerance. The whole curve is re-evaluated
+     * @param tolerance The maximum distance between the old and the new curve
+     * @return The number of knots removed
+     */
+    int ReduceKnots(float tolerance);
+
+    /**
+     * @brief Replace the curve with the least squares approximation of sampled points
+     * @note The points get chord length parameters and the curve interpolates the first and the last one.
+     * The normal equations are banded (each point weights degree + 1 control points), they are solved by a banded Cholesky
+     * factorisation in O(n * degree^2). While the error is above the tolerance, the spans that miss it are split between their points
+     * and the system is solved again.
+     * The buffers are kept by the curve: fitting many polylines with the same curve does not allocate once they are large enough.
+     * Like SetKnotVector, the knots are replaced by the ones of the type when control points are inserted or removed
+     * @param points The points to approximate, in order
+     * @param count The number of points, more than the degree
+     * @param degree The degree of the curve
+     * @param nbControlPoints The number of control points to start with (at most the number of points)
+     * @param tolerance The maximum distance between a point and the curve at its parameter
+     * @return The maximum distance between a point and the curve at its parameter
+     */
+    float Fit(const glm::vec3 *points, std::size_t count, uint8_t degree, uint32_t nbControlPoints, float tolerance);
+
+    /**
+     * @brief Replace the curve with the least squares approximation of sampled points
+     */
+    float Fit(const std::vector<glm::vec3> &points, uint8_t degree, uint32_t nbControlPoints, float tolerance);
+
+    /**
+     * @brief Change the type of the knots vector, the knots are recomputed
+     */
+    void SetType(BSplineType type);
+    inline BSplineType GetType() const { return m_Type; }
+
     inline void SetDegree(uint8_t degree)
     {
+        degree = glm::min(degree, BSplineBasis::MaxDegree);
         m_Attributes.Degree = degree;
         m_Attributes.Order = degree + 1;
+        InitKnotVector();
+        m_FullEvaluation = true;
+        m_BezierSegmentsValid = false;
     }
     inline uint8_t GetDegree() const { return m_Attributes.Degree; }
     inline uint8_t GetOrder() const { return m_Attributes.Order; }
 
     inline uint32_t GetSegmentsCount() const { return (m_ControlPoints.size() + 1) - m_Attributes.Order; }
 
-    inline void SetPrecision(uint16_t precision) { m_Precision = glm::clamp(precision, (uint16_t)64, (uint16_t)1024); }
+    /**
+     * @brief Set the number of samples per segment
+     * @note The polynomial form of the segments does not depend on the precision, it is kept
+     */
+    inline void SetPrecision(uint16_t precision)
+    {
+        m_Precision = glm::clamp(precision, (uint16_t)64, (uint16_t)1024);
+        m_FullEvaluation = true;
+    }
     inline uint16_t GetPrecision() const { return m_Precision; }
 
+    /**
+     * @brief Incremented by each Evaluate, what is built from the curve can be cached with it
+     */
+    inline uint64_t GetVersion() const { return m_Version; }
+
     inline float GetMinT() const { return m_Attributes.Knots[m_Attributes.Degree]; }
     inline float GetMaxT() const { return m_Attributes.Knots[m_Attributes.Knots.size() - m_Attributes.Degree - 1]; }
 
 private:
     /**
-     * @brief Recursive function to compute the weight of a control point at a given t
-     * @param index The index of the knot concerned by the segment
-     * @param degree The current degree in the recursive function
-     * @param t
+     * @brief Evaluate the samples of the segments [firstSegment, lastSegment]
+     * @note The samples are uniformly spaced in each segment, they are generated by forward differencing
+     * of the Bezier form of the segment: degree additions per sample
      */
-    float ComputeWeight(int index, uint8_t degree, float t) const;
+    void EvaluateSegments(int firstSegment, int lastSegment);
 
     /**
-     * @brief Compute the derivatives of the curve at a given t
-     * @param t
-     * @param count The number of derivatives to compute (default = 3)
-     * @return The velocity and acceleration vectors at t
+     * @brief Replace m_Points with the adaptive tessellation of the whole curve and fill m_Parameters
+     * @note Each Bezier segment is split in halves until its control polygon, which contains the curve, meets the tolerances
      */
-    CurveDerivativesComponenets GetFiniteDifferencesDerivatives(float t) const;
+    void TessellateAdaptive();
+
+    /**
+     * @brief Replace m_Points with the control polygon of the curve subdivided m_SubdivisionLevels times, projected on the curve
+     * @note The refined control points are moved to the curve at the refined knots by the basis functions at a knot (the limit stencil),
+     * they are the samples of the uniform mode with 2^levels points per segment.
+     * The curve is subdivided by tiles of a few segments (with their control points), the jobs of the job system share the tiles
+     */
+    void EvaluateSubdivision();
+
+    /**
+     * @brief Check that the knots are equally spaced, the condition of the subdivision mode
+     */
+    bool HasUniformKnots() const;
+
+    /**
+     * @brief Convert the segments [firstSegment, lastSegment] to their polynomial (Bezier) form by knot insertion
+     */
+    void ComputeBezierSegments(int firstSegment, int lastSegment);
+
+    /**
+     * @brief Integrate the lengths of the subdivisions of the segments [firstSegment, lastSegment] (Gauss-Legendre quadrature)
+     */
+    void ComputeArcLengths(int firstSegment, int lastSegment);
+
+    /**
+     * @brief Compute the bounding boxes of the segments [firstSegment, lastSegment]
+     */
+    void ComputeSegmentsBounds(int firstSegment, int lastSegment);
+
+    /**
+     * @brief Refit the bounding boxes hierarchy above the segments from firstSegment to the end
+     */
+    void UpdateBoundsTree(int firstSegment);
+
+    /**
+     * @brief Walk the bounding boxes hierarchy to find the point of the curve closest to a query (see the queries in the source file)
+     * @param segment In: a segment to try first (or -1), out: the segment of the closest point
+     */
+    template <typename Query>
+    CurveProjection FindClosest(const Query &query, int &segment) const;
+
+    /**
+     * @brief ParameterAtLength when the segment containing s is already known
+     */
+    float ParameterAtLength(float s, int segment) const;
+
+    /**
+     * @brief Flag the segments [firstSegment, lastSegment] to be re-evaluated by the next Evaluate
+     */
+    void InvalidateSegments(int firstSegment, int lastSegment);
+
+    /**
+     * @brief Make room for a segment at the given index in the per-segment tables, it is computed by the next Evaluate
+     */
+    void InsertSegment(int segment, bool validSamples);
+
+    /**
+     * @brief Remove a segment from the per-segment tables, the following ones move one segment back
+     */
+    void EraseSegment(int segment, bool validSamples);
+
+    /**
+     * @brief Remove the knot of index r once if the homogeneous curve moves less than the tolerance
+     * @param r The index of the last occurrence of the knot, an interior knot
+     * @param s The multiplicity of the knot
+     * @param tolerance The maximum distance between the old and the new homogeneous curve
+     * @param error Output, the bound of this distance
+     * @return True if the knot was removed
+     */
+    bool TryRemoveKnot(int r, int s, float tolerance, float &error);
+
+    /**
+     * @brief Solve the least squares control points of Fit for the current knots and m_FitParameters
+     * @note The first and last control points are the first and last points, the others are the unknowns of the banded system.
+     * The span and the basis functions of each point are kept in m_FitSpans and m_FitBasis
+     */
+    void SolveFit(const glm::vec3 *points, int count, int nbControlPoints);
+
+    /**
+     * @brief The maximum distance between the points and the curve at their parameter, the maximum of each span goes to m_FitSpanErrors
+     * @note Reads the basis functions of the last SolveFit
+     */
+    float ComputeFitError(const glm::vec3 *points, int count);
+
+    /**
+     * @brief Scale from a distance between homogeneous curves to a bound of the distance between the projected curves
+     */
+    float HomogeneousErrorScale() const;
+
+    /**
+     * @brief Copy the homogeneous control points back to the control points, the weights and the structure of arrays
+     */
+    void SyncControlPoints();
+
+    /**
+     * @brief Check that m_Points holds the samples of the current control points, knots and precision
+     */
+    bool HasValidSamples() const;
+
+    /**
+     * @brief Check that m_BezierSegments holds the polynomial form of the current control points and knots
+     */
+    bool HasValidBezierSegments() const;
 
 private:
     BSplineType m_Type = BSplineType::Uniform;
     BSplineAttributes m_Attributes;
+    BSplineBasis::KnotSpanLookup m_SpanLookup; // rebuilt with the knots
 
     std::vector<glm::vec3> m_ControlPoints;
+    std::vector<float> m_Weights;
+    std::vector<glm::vec4> m_HomogeneousControlPoints; // (w * x, w * y, w * z, w), the evaluation works in this space
+    ControlPointsSoA m_ControlPointsSoA;                // copy of the homogeneous control points read by the batch kernels
+    std::vector<glm::vec4> m_ScratchControlPoints;      // reused by RefineKnots
+    std::vector<float> m_ScratchKnots;
+
+    // reused by Fit: the parameter, span and basis functions of each point, the lower band of the normal equations
+    // (degree + 1 values per row), its right hand side and the error of each knot span
+    std::vector<float> m_FitParameters;
+    std::vector<int> m_FitSpans;
+    std::vector<float> m_FitBasis;
+    std::vector<double> m_FitBand;
+    std::vector<glm::dvec3> m_FitRightHandSide;
+    std::vector<float> m_FitSpanErrors;
     std::vector<glm::vec3> m_Points;
+    std::vector<float> m_Parameters; // parameter of each point in adaptive mode
+    std::vector<glm::vec4> m_BezierSegments; // (degree + 1) homogeneous Bezier control points per segment
+
+    // arc length table, the cumulated length of each subdivision from the start of its segment
+    // and the cumulated length at the start of each segment (plus the total length)
+    std::vector<float> m_ArcLengths;
+    std::vector<double> m_SegmentsStartLength;
+
+    // bounding box of each segment and their hierarchy: a complete binary tree stored in an array,
+    // the node i has the children 2i and 2i + 1, the leaves (one per segment, padded to a power of 2) come last
+    std::vector<SmartGL::Maths::BoundingBox> m_SegmentsBounds;
+    std::vector<SmartGL::Maths::BoundingBox> m_BoundsTree;
+    int m_BoundsTreeSegmentsCount = 0;
     std::vector<glm::vec3> m_Knots;
 
-    uint16_t m_Precision = 256;
+    uint16_t m_Precision = 1024;
+
+    CurveTessellationMode m_TessellationMode = CurveTessellationMode::Uniform;
+    CurveTessellationTolerance m_TessellationTolerance;
+    uint8_t m_SubdivisionLevels = 6;
+
+    // segments to re-evaluate, the range is empty when last < first
+    // (m_FullEvaluation also stays set in adaptive mode, m_Points does not hold the uniform samples)
+    bool m_FullEvaluation = true;
+    bool m_BezierSegmentsValid = false;
+    int m_DirtyFirstSegment = 0;
+    int m_DirtyLastSegment = -1;
+
+    uint64_t m_Version = 0;
 };
@@ -0,0 +1,170 @@
+#include "BSplineCurveSet.h"
+#include "BSplineKernel.h"
+#include "Core/Assert.h"
+#include "Core/JobSystem.h"
+
+#include <algorithm>
+
+// average number of samples given to each job of the pool
+static constexpr uint64_t SamplesPerJob = 8192;
+
+/**
+ * @brief Sample each segment of a curve uniformly, then its end point
+ * @param knots The knots of the curve
+ * @param controlPoints The arena holding the homogeneous control points of the curve
+ * @param firstControlPoint The index of the first control point of the curve in the arena
+ * @param degree The degree of the curve
+ * @param nbControlPoints The number of control points of the curve
+ * @param precision The number of samples per segment
+ * @param computeBasis Called with (span, t, basis) to fill the (degree + 1) basis functions of the span at t
+ * @param out Output, (nbControlPoints - degree) * precision + 1 points
+ */
+template <typename ComputeBasis>
+static void SampleCurve(const float *knots, const ControlPointsSoA &controlPoints, uint32_t firstControlPoint, int degree, int nbControlPoints,
+                        uint16_t precision, ComputeBasis &&computeBasis, glm::vec3 *out)
+{
+    const float *x = controlPoints.X.data() + firstControlPoint;
+    const float *y = controlPoints.Y.data() + firstControlPoint;
+    const float *z = controlPoints.Z.data() + firstControlPoint;
+    const float *w = controlPoints.W.data() + firstControlPoint;
+
+    float basis[BSplineBasis::MaxDegree + 1];
+
+    auto evaluate = [&](int span, float t)
+    {
+        computeBasis(span, t, basis);
+
+        glm::vec4 point(0.0f);
+        for (int j = 0; j <= degree; j++)
+        {
+            int index = span - degree + j;
+            point += basis[j] * glm::vec4(x[index], y[index], z[index], w[index]);
+        }
+        return glm::vec3(point) / point.w;
+    };
+
+    // the span of each segment is known, no search is needed
+    for (int span = degree; span < nbControlPoints; span++)
+    {
+        glm::vec3 *points = out + (span - degree) * precision;
+        float start = knots[span];
+        float length = knots[span + 1] - start;
+
+        // an empty span (repeated knot) shrinks to the point at its knot, evaluated in the next non-empty span
+        if (!(length > 0.0f))
+        {
+            int next = span;
+            while (next < nbControlPoints - 1 && !(knots[next + 1] > knots[next]))
+                next++;
+            std::fill(points, points + precision, evaluate(next, start));
+            continue;
+        }
+
+        for (int i = 0; i < precision; i++)
+            points[i] = evaluate(span, start + length * i / precision);
+    }
+
+    int last = nbControlPoints - 1;
+    while (last > degree && !(knots[last + 1] > knots[last]))
+        last--;
+    out[(nbControlPoints - degree) * precision] = evaluate(last, knots[nbControlPoints]);
+}
+
+void BSplineCurveSet::Reserve(std::size_t nbCurves, std::size_t nbControlPoints, uint8_t maxDegree)
+{
+    m_Curves.reserve(nbCurves);
+    m_ControlPoints.Reserve(nbControlPoints);
+    m_Knots.reserve(nbControlPoints + nbCurves * (maxDegree + 1));
+    m_PointsOffsets.reserve(nbCurves + 1);
+}
+
+uint32_t BSplineCurveSet::AddCurve(uint8_t degree, const std::vector<glm::vec3> &controlPoints, BSplineType type)
+{
+    m_ScratchWeights.assign(controlPoints.size(), 1.0f);
+    return AddCurve(degree, controlPoints, m_ScratchWeights, type);
+}
+
+uint32_t BSplineCurveSet::AddCurve(uint8_t degree, const std::vector<glm::vec3> &controlPoints, const std::vector<float> &weights, BSplineType type)
+{
+    degree = glm::min(degree, BSplineBasis::MaxDegree);
+    BSplineCurve::ComputeKnotVector(type, degree, controlPoints, m_ScratchKnots);
+    return AddCurve(degree, controlPoints, weights, m_ScratchKnots);
+}
+
+uint32_t BSplineCurveSet::AddCurve(uint8_t degree, const std::vector<glm::vec3> &controlPoints, const std::vector<float> &weights, const std::vector<float> &knots)
+{
+    degree = glm::min(degree, BSplineBasis::MaxDegree);
+    SMART_ASSERT(weights.size() == controlPoints.size(), "One weight per control point is expected");
+    SMART_ASSERT(knots.size() == controlPoints.size() + degree + 1, "The knots vector must have (control points + degree + 1) values");
+
+    BSplineCurveRange curve;
+    curve.FirstControlPoint = m_ControlPoints.Size();
+    curve.ControlPointsCount = controlPoints.size();
+    curve.FirstKnot = m_Knots.size();
+    curve.Degree = degree;
+
+    m_ControlPoints.Append(controlPoints, weights);
+    m_Knots.insert(m_Knots.end(), knots.begin(), knots.end());
+    m_Curves.push_back(curve);
+
+    return m_Curves.size() - 1;
+}
+
+void BSplineCurveSet::Clear()
+{
+    m_Curves.clear();
+    m_ControlPoints.Clear();
+    m_Knots.clear();
+    m_Points.clear();
+    m_PointsOffsets.clear();
+}
+
+void BSplineCurveSet::Evaluate()
+{
+    std::size_t nbCurves = m_Curves.size();
+
+    // the offsets of the curves in the flat buffer
+    m_PointsOffsets.resize(nbCurves + 1);
+    m_PointsOffsets[0] = 0;
+    for (std::size_t i = 0; i < nbCurves; i++)
+    {
+        const BSplineCurveRange &curve = m_Curves[i];
+        uint32_t nbPoints = curve.ControlPointsCount > curve.Degree ? (curve.ControlPointsCount - curve.Degree) * m_Precision + 1 : 0;
+        m_PointsOffsets[i + 1] = m_PointsOffsets[i] + nbPoints;
+    }
+
+    m_Points.resize(m_PointsOffsets.back());
+    if (m_Points.empty())
+        return;
+
+    // each job writes the samples of its own curves, the output does not depend on the scheduling
+    uint32_t curvesPerJob = std::max<uint64_t>(SamplesPerJob * nbCurves / m_Points.size(), 1);
+    SmartGL::Core::JobSystem::ParallelFor(nbCurves, curvesPerJob, [this](uint32_t begin, uint32_t end)
+                                          {
+                                              for (uint32_t i = begin; i < end; i++)
+                                                  EvaluateCurve(m_Curves[i], m_Points.data() + m_PointsOffsets[i]);
+                                          });
+}
+
+void BSplineCurveSet::EvaluateCurve(const BSplineCurveRange &curve, glm::vec3 *out) const
+{
+    int degree = curve.Degree;
+    int nbControlPoints = curve.ControlPointsCount;
+
+    if (nbControlPoints <= degree)
+        return;
+
+    const float *knots = m_Knots.data() + curve.FirstKnot;
+
+    // unrolled basis functions for the common degrees
+    bool specialised = BSplineKernels::DispatchDegree(degree, [&](auto degreeConstant)
+    {
+        constexpr int Degree = decltype(degreeConstant)::value;
+        SampleCurve(knots, m_ControlPoints, curve.FirstControlPoint, Degree, nbControlPoints, m_Precision, [knots](int span, float t, float *basis)
+                    { BSplineKernel<Degree>::ComputeBasisFunctions(knots, span, t, basis); }, out);
+    });
+
+    if (!specialised)
+        SampleCurve(knots, m_ControlPoints, curve.FirstControlPoint, degree, nbControlPoints, m_Precision, [knots, degree](int span, float t, float *basis)
+                    { BSplineBasis::ComputeBasisFunctions(knots, span, degree, t, basis); }, out);
+}
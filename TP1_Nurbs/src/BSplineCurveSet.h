@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "BSplineCurve.h"
+#include "BSplineSIMD.h"
+
+/**
+ * @brief Placement of a curve in the arenas of a BSplineCurveSet
+ */
+struct BSplineCurveRange
+{
+    uint32_t FirstControlPoint;
+    uint32_t ControlPointsCount;
+    uint32_t FirstKnot; // the curve has ControlPointsCount + Degree + 1 knots
+    uint8_t Degree;
+};
+
+/**
+ * @brief Many (rational) B-Spline curves stored together and evaluated in a single pass
+ * @note The control points of all the curves share one structure of arrays and their knots one array,
+ * adding a curve appends to these arenas so there is no allocation per curve.
+ * The samples of all the curves go to one flat buffer, the samples of a curve start at its points offset.
+ */
+class BSplineCurveSet
+{
+public:
+    BSplineCurveSet() = default;
+    ~BSplineCurveSet() = default;
+
+    /**
+     * @brief Reserve the arenas to avoid their reallocations while the curves are added
+     * @param nbCurves The expected number of curves
+     * @param nbControlPoints The expected number of control points of all the curves
+     * @param maxDegree The highest expected degree
+     */
+    void Reserve(std::size_t nbCurves, std::size_t nbControlPoints, uint8_t maxDegree = 3);
+
+    /**
+     * @brief Add a curve with the knots vector of a type of B-Spline
+     * @param degree The degree of the curve
+     * @param controlPoints The control points of the curve
+     * @param type The type of knots vector
+     * @return The index of the curve
+     */
+    uint32_t AddCurve(uint8_t degree, const std::vector<glm::vec3> &controlPoints, BSplineType type = BSplineType::Uniform);
+
+    /**
+     * @brief Add a rational curve with the knots vector of a type of B-Spline
+     * @param weights The weight of each control point (strictly positive)
+     */
+    uint32_t AddCurve(uint8_t degree, const std::vector<glm::vec3> &controlPoints, const std::vector<float> &weights, BSplineType type = BSplineType::Uniform);
+
+    /**
+     * @brief Add a rational curve with an arbitrary knots vector
+     * @param knots Non-decreasing values, the number of control points + degree + 1 of them
+     */
+    uint32_t AddCurve(uint8_t degree, const std::vector<glm::vec3> &controlPoints, const std::vector<float> &weights, const std::vector<float> &knots);
+
+    /**
+     * @brief Remove all the curves, the arenas keep their capacity
+     */
+    void Clear();
+
+    /**
+     * @brief Evaluate the samples of all the curves in parallel
+     * @note Each segment of a curve is sampled uniformly like a BSplineCurve with the same precision
+     * (segments count * precision + 1 points per curve), the curves with too few control points have no sample
+     */
+    void Evaluate();
+
+    /**
+     * @brief Set the number of samples per segment of every curve
+     */
+    inline void SetPrecision(uint16_t precision) { m_Precision = glm::max(precision, (uint16_t)1); }
+    inline uint16_t GetPrecision() const { return m_Precision; }
+
+    inline std::size_t GetCurvesCount() const { return m_Curves.size(); }
+    inline const BSplineCurveRange &GetCurve(std::size_t curve) const { return m_Curves[curve]; }
+    inline const ControlPointsSoA &GetControlPoints() const { return m_ControlPoints; }
+    inline const std::vector<float> &GetKnots() const { return m_Knots; }
+
+    /**
+     * @brief The samples of all the curves, the samples of a curve are [GetPointsOffset(curve), GetPointsOffset(curve + 1))
+     */
+    inline const std::vector<glm::vec3> &GetPoints() const { return m_Points; }
+    inline uint32_t GetPointsOffset(std::size_t curve) const { return m_PointsOffsets[curve]; }
+    inline uint32_t GetPointsCount(std::size_t curve) const { return m_PointsOffsets[curve + 1] - m_PointsOffsets[curve]; }
+    inline const std::vector<uint32_t> &GetPointsOffsets() const { return m_PointsOffsets; }
+
+private:
+    /**
+     * @brief Write the samples of a curve at out
+     */
+    void EvaluateCurve(const BSplineCurveRange &curve, glm::vec3 *out) const;
+
+private:
+    std::vector<BSplineCurveRange> m_Curves;
+    ControlPointsSoA m_ControlPoints; // homogeneous control points of all the curves
+    std::vector<float> m_Knots;       // knots of all the curves
+
+    std::vector<glm::vec3> m_Points;
+    std::vector<uint32_t> m_PointsOffsets; // one per curve, plus the total number of points
+
+    // reused by AddCurve to build the default weights and the typed knots vectors
+    std::vector<float> m_ScratchWeights;
+    std::vector<float> m_ScratchKnots;
+
+    uint16_t m_Precision = 64;
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "glm/glm.hpp"
+
+/**
+ * @brief Call function(0), function(1), ..., function(N - 1) with compile time indices (fully unrolled)
+ */
+template <int... Indices, typename Function>
+inline void UnrollLoop(std::integer_sequence<int, Indices...>, Function &&function)
+{
+    (function(std::integral_constant<int, Indices>{}), ...);
+}
+
+template <int Count, typename Function>
+inline void UnrollLoop(Function &&function)
+{
+    UnrollLoop(std::make_integer_sequence<int, Count>{}, std::forward<Function>(function));
+}
+
+/**
+ * @brief B-Spline evaluation core specialised at compile time on the degree
+ * @note Every loop has a compile time trip count and is unrolled, the basis functions live in registers
+ * @tparam Degree The degree of the B-Spline
+ * @tparam Dim The dimension of the control points (3 for positions, 4 for homogeneous points)
+ * @tparam Scalar The type used for the computations
+ */
+template <int Degree, int Dim = 3, typename Scalar = float>
+struct BSplineKernel
+{
+    using Point = glm::vec<Dim, Scalar, glm::defaultp>;
+
+    static constexpr int Order = Degree + 1;
+
+    /**
+     * @brief Compute the (Degree + 1) non-zero basis functions of a knot span at t (triangular Cox-de Boor scheme)
+     * @param knots The knots vector
+     * @param span The knot span containing t
+     * @param t
+     * @param basis Output, basis[i] is the weight of the control point (span - Degree + i)
+     */
+    static inline void ComputeBasisFunctions(const float *knots, int span, Scalar t, Scalar *basis)
+    {
+        Scalar left[Order];
+        Scalar right[Order];
+
+        basis[0] = Scalar(1);
+
+        UnrollLoop<Degree>([&](auto jMinusOne)
+        {
+            constexpr int j = decltype(jMinusOne)::value + 1;
+
+            left[j] = t - Scalar(knots[span + 1 - j]);
+            right[j] = Scalar(knots[span + j]) - t;
+
+            Scalar saved = Scalar(0);
+            UnrollLoop<j>([&](auto rConstant)
+            {
+                constexpr int r = decltype(rConstant)::value;
+
+                Scalar temp = basis[r] / (right[r + 1] + left[j - r]);
+                basis[r] = saved + right[r + 1] * temp;
+                saved = left[j - r] * temp;
+            });
+            basis[j] = saved;
+        });
+    }
+
+    /**
+     * @brief Evaluate the curve at t
+     * @param knots The knots vector
+     * @param controlPoints The control points of the whole curve
+     * @param span The knot span containing t
+     * @param t
+     */
+    static inline Point Evaluate(const float *knots, const Point *controlPoints, int span, Scalar t)
+    {
+        Scalar basis[Order];
+        ComputeBasisFunctions(knots, span, t, basis);
+
+        const Point *spanControlPoints = controlPoints + span - Degree;
+
+        Point point(Scalar(0));
+        UnrollLoop<Order>([&](auto iConstant)
+        {
+            constexpr int i = decltype(iConstant)::value;
+            point += basis[i] * spanControlPoints[i];
+        });
+
+        return point;
+    }
+};
+
+namespace BSplineKernels
+{
+    /**
+     * @brief Highest degree with a specialised kernel, the callers fall back to the generic path above it
+     */
+    constexpr uint8_t MaxSpecialisedDegree = 5;
+
+    /**
+     * @brief Turn the runtime degree into a compile time constant
+     * @param degree The runtime degree
+     * @param function Called with a std::integral_constant<int, degree>
+     * @return false when there is no specialised kernel for this degree
+     */
+    template <typename Function>
+    inline bool DispatchDegree(uint8_t degree, Function &&function)
+    {
+        switch (degree)
+        {
+        case 1:
+            function(std::integral_constant<int, 1>{});
+            return true;
+        case 2:
+            function(std::integral_constant<int, 2>{});
+            return true;
+        case 3:
+            function(std::integral_constant<int, 3>{});
+            return true;
+        case 4:
+            function(std::integral_constant<int, 4>{});
+            return true;
+        case 5:
+            function(std::integral_constant<int, 5>{});
+            return true;
+        default:
+            return false;
+        }
+    }
+}
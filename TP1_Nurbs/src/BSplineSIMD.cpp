@@ -0,0 +1,456 @@
+#include "BSplineSIMD.h"
+#include "BSplineBasis.h"
+#include "BSplineKernel.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BSPLINE_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define BSPLINE_SIMD_X86 0
+#endif
+
+// GCC and Clang only emit AVX instructions in functions flagged with the target attribute,
+// this way the file is compiled without -mavx2 and the kernels are selected at runtime
+#if defined(__GNUC__) || defined(__clang__)
+#define BSPLINE_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BSPLINE_TARGET(isa)
+#endif
+
+namespace BSplineSIMD
+{
+    static void EvaluateScalar(const BSplineBatchData &data, const float *ts, glm::vec3 *out, std::size_t count)
+    {
+        const ControlPointsSoA &controlPoints = data.ControlPoints;
+        uint8_t degree = data.Degree;
+        BSplineBasis::KnotSpanWalker walker(data.Spans);
+
+        // unrolled kernel for the common degrees, dispatched once for the whole batch
+        bool specialised = BSplineKernels::DispatchDegree(degree, [&](auto degreeConstant)
+        {
+            constexpr int Degree = decltype(degreeConstant)::value;
+            float basis[Degree + 1];
+
+            for (std::size_t i = 0; i < count; i++)
+            {
+                int span = walker.Find(ts[i]);
+                BSplineKernel<Degree>::ComputeBasisFunctions(data.Knots.data(), span, ts[i], basis);
+
+                int first = span - Degree;
+                glm::vec4 point(0.0f);
+                UnrollLoop<Degree + 1>([&](auto jConstant)
+                {
+                    constexpr int j = decltype(jConstant)::value;
+                    point += basis[j] * glm::vec4(controlPoints.X[first + j], controlPoints.Y[first + j], controlPoints.Z[first + j], controlPoints.W[first + j]);
+                });
+                out[i] = glm::vec3(point) / point.w;
+            }
+        });
+
+        if (specialised)
+            return;
+
+        float basis[BSplineBasis::MaxDegree + 1];
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            int span = walker.Find(ts[i]);
+            BSplineBasis::ComputeBasisFunctions(data.Knots, span, degree, ts[i], basis);
+
+            glm::vec4 point(0.0f);
+            for (int j = 0; j <= degree; j++)
+            {
+                int index = span - degree + j;
+                point += basis[j] * glm::vec4(controlPoints.X[index], controlPoints.Y[index], controlPoints.Z[index], controlPoints.W[index]);
+            }
+            out[i] = glm::vec3(point) / point.w;
+        }
+    }
+
+    // doubles the count points of in and fuses the first average: out[2i] = in[i], out[2i + 1] = the middle of in[i] and in[i + 1] (2 * count - 1 values)
+    static void SplitScalar(const float *in, std::size_t count, float *out)
+    {
+        for (std::size_t i = 0; i + 1 < count; i++)
+        {
+            out[2 * i] = in[i];
+            out[2 * i + 1] = 0.5f * (in[i] + in[i + 1]);
+        }
+        out[2 * (count - 1)] = in[count - 1];
+    }
+
+    // replaces each value by the middle of it and the next one, the count - 1 first values are written
+    // (reading ahead of the written value makes it safe in place)
+    static void AverageScalar(float *values, std::size_t count)
+    {
+        for (std::size_t i = 0; i + 1 < count; i++)
+            values[i] = 0.5f * (values[i] + values[i + 1]);
+    }
+
+    // writes the points [first, count) of out
+    static void ApplyStencilScalar(const ControlPointsSoA &points, const float *stencil, int stencilSize, glm::vec3 *out, std::size_t first, std::size_t count)
+    {
+        for (std::size_t i = first; i < count; i++)
+        {
+            glm::vec4 point(0.0f);
+            for (int j = 0; j < stencilSize; j++)
+                point += stencil[j] * glm::vec4(points.X[i + j], points.Y[i + j], points.Z[i + j], points.W[i + j]);
+            out[i] = glm::vec3(point) / point.w;
+        }
+    }
+
+#if BSPLINE_SIMD_X86
+    BSPLINE_TARGET("avx2")
+    static void ApplyStencilAVX2(const ControlPointsSoA &points, const float *stencil, int stencilSize, glm::vec3 *out, std::size_t count)
+    {
+        alignas(32) float x[8], y[8], z[8];
+
+        // consecutive points, the loads are contiguous
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 px = _mm256_setzero_ps();
+            __m256 py = _mm256_setzero_ps();
+            __m256 pz = _mm256_setzero_ps();
+            __m256 pw = _mm256_setzero_ps();
+            for (int j = 0; j < stencilSize; j++)
+            {
+                __m256 weight = _mm256_set1_ps(stencil[j]);
+                px = _mm256_add_ps(px, _mm256_mul_ps(weight, _mm256_loadu_ps(points.X.data() + i + j)));
+                py = _mm256_add_ps(py, _mm256_mul_ps(weight, _mm256_loadu_ps(points.Y.data() + i + j)));
+                pz = _mm256_add_ps(pz, _mm256_mul_ps(weight, _mm256_loadu_ps(points.Z.data() + i + j)));
+                pw = _mm256_add_ps(pw, _mm256_mul_ps(weight, _mm256_loadu_ps(points.W.data() + i + j)));
+            }
+
+            __m256 inverseW = _mm256_div_ps(_mm256_set1_ps(1.0f), pw);
+            _mm256_store_ps(x, _mm256_mul_ps(px, inverseW));
+            _mm256_store_ps(y, _mm256_mul_ps(py, inverseW));
+            _mm256_store_ps(z, _mm256_mul_ps(pz, inverseW));
+            for (int lane = 0; lane < 8; lane++)
+                out[i + lane] = glm::vec3(x[lane], y[lane], z[lane]);
+        }
+
+        _mm256_zeroupper();
+        ApplyStencilScalar(points, stencil, stencilSize, out, i, count);
+    }
+
+    BSPLINE_TARGET("avx2")
+    static void SplitAVX2(const float *in, std::size_t count, float *out)
+    {
+        __m256 half = _mm256_set1_ps(0.5f);
+
+        std::size_t i = 0;
+        for (; i + 8 < count; i += 8)
+        {
+            __m256 current = _mm256_loadu_ps(in + i);
+            __m256 middle = _mm256_mul_ps(half, _mm256_add_ps(current, _mm256_loadu_ps(in + i + 1)));
+
+            // interleave the points and the middles, the unpacks work on the 128 bits halves
+            __m256 low = _mm256_unpacklo_ps(current, middle);
+            __m256 high = _mm256_unpackhi_ps(current, middle);
+            _mm256_storeu_ps(out + 2 * i, _mm256_permute2f128_ps(low, high, 0x20));
+            _mm256_storeu_ps(out + 2 * i + 8, _mm256_permute2f128_ps(low, high, 0x31));
+        }
+
+        _mm256_zeroupper();
+        SplitScalar(in + i, count - i, out + 2 * i);
+    }
+
+    BSPLINE_TARGET("avx2")
+    static void AverageAVX2(float *values, std::size_t count)
+    {
+        __m256 half = _mm256_set1_ps(0.5f);
+
+        // the next block is loaded after the store, its first value is not written by it
+        std::size_t i = 0;
+        for (; i + 8 < count; i += 8)
+            _mm256_storeu_ps(values + i, _mm256_mul_ps(half, _mm256_add_ps(_mm256_loadu_ps(values + i), _mm256_loadu_ps(values + i + 1))));
+
+        _mm256_zeroupper();
+        AverageScalar(values + i, count - i);
+    }
+
+    BSPLINE_TARGET("avx2")
+    static void EvaluateAVX2(const BSplineBatchData &data, const float *ts, glm::vec3 *out, std::size_t count)
+    {
+        const float *knots = data.Knots.data();
+        const ControlPointsSoA &controlPoints = data.ControlPoints;
+        int degree = data.Degree;
+        BSplineBasis::KnotSpanWalker walker(data.Spans);
+
+        __m256 basis[BSplineBasis::MaxDegree + 1];
+        __m256 left[BSplineBasis::MaxDegree + 1];
+        __m256 right[BSplineBasis::MaxDegree + 1];
+
+        alignas(32) int spans[8];
+        alignas(32) float x[8], y[8], z[8];
+
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            // the span search stays scalar, on sorted parameters it is one comparison per lane
+            for (int lane = 0; lane < 8; lane++)
+                spans[lane] = walker.Find(ts[i + lane]);
+
+            __m256 t = _mm256_loadu_ps(ts + i);
+            __m256i span = _mm256_load_si256(reinterpret_cast<const __m256i *>(spans));
+
+            // triangular Cox-de Boor scheme, one lane per parameter
+            basis[0] = _mm256_set1_ps(1.0f);
+            for (int j = 1; j <= degree; j++)
+            {
+                __m256 leftKnot = _mm256_i32gather_ps(knots, _mm256_sub_epi32(span, _mm256_set1_epi32(j - 1)), 4);
+                __m256 rightKnot = _mm256_i32gather_ps(knots, _mm256_add_epi32(span, _mm256_set1_epi32(j)), 4);
+                left[j] = _mm256_sub_ps(t, leftKnot);
+                right[j] = _mm256_sub_ps(rightKnot, t);
+
+                __m256 saved = _mm256_setzero_ps();
+                for (int r = 0; r < j; r++)
+                {
+                    __m256 temp = _mm256_div_ps(basis[r], _mm256_add_ps(right[r + 1], left[j - r]));
+                    basis[r] = _mm256_add_ps(saved, _mm256_mul_ps(right[r + 1], temp));
+                    saved = _mm256_mul_ps(left[j - r], temp);
+                }
+                basis[j] = saved;
+            }
+
+            // weighted sum of the homogeneous control points of each lane span
+            __m256i first = _mm256_sub_epi32(span, _mm256_set1_epi32(degree));
+            __m256 px = _mm256_setzero_ps();
+            __m256 py = _mm256_setzero_ps();
+            __m256 pz = _mm256_setzero_ps();
+            __m256 pw = _mm256_setzero_ps();
+            for (int j = 0; j <= degree; j++)
+            {
+                __m256i index = _mm256_add_epi32(first, _mm256_set1_epi32(j));
+                px = _mm256_add_ps(px, _mm256_mul_ps(basis[j], _mm256_i32gather_ps(controlPoints.X.data(), index, 4)));
+                py = _mm256_add_ps(py, _mm256_mul_ps(basis[j], _mm256_i32gather_ps(controlPoints.Y.data(), index, 4)));
+                pz = _mm256_add_ps(pz, _mm256_mul_ps(basis[j], _mm256_i32gather_ps(controlPoints.Z.data(), index, 4)));
+                pw = _mm256_add_ps(pw, _mm256_mul_ps(basis[j], _mm256_i32gather_ps(controlPoints.W.data(), index, 4)));
+            }
+
+            // back from homogeneous coordinates
+            __m256 inverseW = _mm256_div_ps(_mm256_set1_ps(1.0f), pw);
+            px = _mm256_mul_ps(px, inverseW);
+            py = _mm256_mul_ps(py, inverseW);
+            pz = _mm256_mul_ps(pz, inverseW);
+
+            _mm256_store_ps(x, px);
+            _mm256_store_ps(y, py);
+            _mm256_store_ps(z, pz);
+            for (int lane = 0; lane < 8; lane++)
+                out[i + lane] = glm::vec3(x[lane], y[lane], z[lane]);
+        }
+
+        // avoid the AVX to SSE transition penalty in the scalar tail
+        _mm256_zeroupper();
+        EvaluateScalar(data, ts + i, out + i, count - i);
+    }
+
+    BSPLINE_TARGET("avx512f")
+    static void EvaluateAVX512(const BSplineBatchData &data, const float *ts, glm::vec3 *out, std::size_t count)
+    {
+        const float *knots = data.Knots.data();
+        const ControlPointsSoA &controlPoints = data.ControlPoints;
+        int degree = data.Degree;
+        BSplineBasis::KnotSpanWalker walker(data.Spans);
+
+        __m512 basis[BSplineBasis::MaxDegree + 1];
+        __m512 left[BSplineBasis::MaxDegree + 1];
+        __m512 right[BSplineBasis::MaxDegree + 1];
+
+        alignas(64) int spans[16];
+        alignas(64) float x[16], y[16], z[16];
+
+        std::size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            for (int lane = 0; lane < 16; lane++)
+                spans[lane] = walker.Find(ts[i + lane]);
+
+            __m512 t = _mm512_loadu_ps(ts + i);
+            __m512i span = _mm512_load_si512(spans);
+
+            basis[0] = _mm512_set1_ps(1.0f);
+            for (int j = 1; j <= degree; j++)
+            {
+                __m512 leftKnot = _mm512_i32gather_ps(_mm512_sub_epi32(span, _mm512_set1_epi32(j - 1)), knots, 4);
+                __m512 rightKnot = _mm512_i32gather_ps(_mm512_add_epi32(span, _mm512_set1_epi32(j)), knots, 4);
+                left[j] = _mm512_sub_ps(t, leftKnot);
+                right[j] = _mm512_sub_ps(rightKnot, t);
+
+                __m512 saved = _mm512_setzero_ps();
+                for (int r = 0; r < j; r++)
+                {
+                    __m512 temp = _mm512_div_ps(basis[r], _mm512_add_ps(right[r + 1], left[j - r]));
+                    basis[r] = _mm512_add_ps(saved, _mm512_mul_ps(right[r + 1], temp));
+                    saved = _mm512_mul_ps(left[j - r], temp);
+                }
+                basis[j] = saved;
+            }
+
+            __m512i first = _mm512_sub_epi32(span, _mm512_set1_epi32(degree));
+            __m512 px = _mm512_setzero_ps();
+            __m512 py = _mm512_setzero_ps();
+            __m512 pz = _mm512_setzero_ps();
+            __m512 pw = _mm512_setzero_ps();
+            for (int j = 0; j <= degree; j++)
+            {
+                __m512i index = _mm512_add_epi32(first, _mm512_set1_epi32(j));
+                px = _mm512_add_ps(px, _mm512_mul_ps(basis[j], _mm512_i32gather_ps(index, controlPoints.X.data(), 4)));
+                py = _mm512_add_ps(py, _mm512_mul_ps(basis[j], _mm512_i32gather_ps(index, controlPoints.Y.data(), 4)));
+                pz = _mm512_add_ps(pz, _mm512_mul_ps(basis[j], _mm512_i32gather_ps(index, controlPoints.Z.data(), 4)));
+                pw = _mm512_add_ps(pw, _mm512_mul_ps(basis[j], _mm512_i32gather_ps(index, controlPoints.W.data(), 4)));
+            }
+
+            // back from homogeneous coordinates
+            __m512 inverseW = _mm512_div_ps(_mm512_set1_ps(1.0f), pw);
+            px = _mm512_mul_ps(px, inverseW);
+            py = _mm512_mul_ps(py, inverseW);
+            pz = _mm512_mul_ps(pz, inverseW);
+
+            _mm512_store_ps(x, px);
+            _mm512_store_ps(y, py);
+            _mm512_store_ps(z, pz);
+            for (int lane = 0; lane < 16; lane++)
+                out[i + lane] = glm::vec3(x[lane], y[lane], z[lane]);
+        }
+
+        _mm256_zeroupper();
+        EvaluateScalar(data, ts + i, out + i, count - i);
+    }
+#endif
+
+    static InstructionSet DetectInstructionSet()
+    {
+#if BSPLINE_SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return InstructionSet::AVX512;
+        if (__builtin_cpu_supports("avx2"))
+            return InstructionSet::AVX2;
+#elif BSPLINE_SIMD_X86 && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return InstructionSet::Scalar;
+
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        if (!osxsave)
+            return InstructionSet::Scalar;
+
+        // the OS must save the YMM (and ZMM) registers on context switches
+        unsigned long long xcr0 = _xgetbv(0);
+
+        __cpuidex(info, 7, 0);
+        if ((info[1] & (1 << 16)) && (xcr0 & 0xE6) == 0xE6)
+            return InstructionSet::AVX512;
+        if ((info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6)
+            return InstructionSet::AVX2;
+#endif
+        return InstructionSet::Scalar;
+    }
+
+    InstructionSet GetInstructionSet()
+    {
+        static InstructionSet s_InstructionSet = DetectInstructionSet();
+        return s_InstructionSet;
+    }
+
+    const char *GetInstructionSetName(InstructionSet instructionSet)
+    {
+        switch (instructionSet)
+        {
+        case InstructionSet::AVX2:
+            return "AVX2";
+        case InstructionSet::AVX512:
+            return "AVX-512";
+        default:
+            return "Scalar";
+        }
+    }
+
+    void EvaluateBatch(const BSplineBatchData &data, const float *ts, glm::vec3 *out, std::size_t count)
+    {
+        EvaluateBatch(data, ts, out, count, GetInstructionSet());
+    }
+
+    void EvaluateBatch(const BSplineBatchData &data, const float *ts, glm::vec3 *out, std::size_t count, InstructionSet instructionSet)
+    {
+        if (count == 0 || data.ControlPoints.Size() <= data.Degree)
+            return;
+
+        // never run a kernel the CPU cannot execute
+        if (static_cast<int>(instructionSet) > static_cast<int>(GetInstructionSet()))
+            instructionSet = GetInstructionSet();
+
+        switch (instructionSet)
+        {
+#if BSPLINE_SIMD_X86
+        case InstructionSet::AVX512:
+            EvaluateAVX512(data, ts, out, count);
+            break;
+        case InstructionSet::AVX2:
+            EvaluateAVX2(data, ts, out, count);
+            break;
+#endif
+        default:
+            EvaluateScalar(data, ts, out, count);
+            break;
+        }
+    }
+
+    void SubdivideUniform(std::vector<float> &values, std::vector<float> &scratch, uint8_t degree, int levels)
+    {
+        SubdivideUniform(values, scratch, degree, levels, GetInstructionSet());
+    }
+
+    void SubdivideUniform(std::vector<float> &values, std::vector<float> &scratch, uint8_t degree, int levels, InstructionSet instructionSet)
+    {
+        if (degree == 0 || values.size() <= degree)
+            return;
+
+        if (static_cast<int>(instructionSet) > static_cast<int>(GetInstructionSet()))
+            instructionSet = GetInstructionSet();
+
+        // the passes are bound by the memory bandwidth, AVX-512 runs the AVX2 kernels
+        auto split = SplitScalar;
+        auto average = AverageScalar;
+#if BSPLINE_SIMD_X86
+        if (instructionSet != InstructionSet::Scalar)
+        {
+            split = SplitAVX2;
+            average = AverageAVX2;
+        }
+#endif
+
+        for (int level = 0; level < levels; level++)
+        {
+            std::size_t count = values.size();
+            scratch.resize(2 * count - 1);
+            split(values.data(), count, scratch.data());
+
+            // each remaining average drops the last value
+            for (int round = 1; round < degree; round++)
+                average(scratch.data(), scratch.size() - round + 1);
+            scratch.resize(2 * count - degree);
+
+            values.swap(scratch);
+        }
+    }
+
+    void ApplyStencil(const ControlPointsSoA &points, const float *stencil, int stencilSize, glm::vec3 *out, std::size_t count)
+    {
+#if BSPLINE_SIMD_X86
+        if (GetInstructionSet() != InstructionSet::Scalar)
+        {
+            ApplyStencilAVX2(points, stencil, stencilSize, out, count);
+            return;
+        }
+#endif
+        ApplyStencilScalar(points, stencil, stencilSize, out, 0, count);
+    }
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "BSplineBasis.h"
+
+/**
+ * @brief Homogeneous control points (w * x, w * y, w * z, w) stored as structure of arrays (one array per coordinate)
+ * @note This is the layout the vector kernels load from, one lane per parameter
+ */
+struct ControlPointsSoA
+{
+    std::vector<float> X;
+    std::vector<float> Y;
+    std::vector<float> Z;
+    std::vector<float> W;
+
+    void Assign(const std::vector<glm::vec3> &points, const std::vector<float> &weights)
+    {
+        X.resize(points.size());
+        Y.resize(points.size());
+        Z.resize(points.size());
+        W.resize(points.size());
+
+        for (std::size_t i = 0; i < points.size(); i++)
+            Set(i, points[i], weights[i]);
+    }
+
+    void Set(std::size_t index, const glm::vec3 &point, float weight)
+    {
+        X[index] = weight * point.x;
+        Y[index] = weight * point.y;
+        Z[index] = weight * point.z;
+        W[index] = weight;
+    }
+
+    void Insert(std::size_t index, const glm::vec3 &point, float weight)
+    {
+        X.insert(X.begin() + index, weight * point.x);
+        Y.insert(Y.begin() + index, weight * point.y);
+        Z.insert(Z.begin() + index, weight * point.z);
+        W.insert(W.begin() + index, weight);
+    }
+
+    /**
+     * @brief Add the points at the end of the arrays
+     */
+    void Append(const std::vector<glm::vec3> &points, const std::vector<float> &weights)
+    {
+        std::size_t first = X.size();
+        X.resize(first + points.size());
+        Y.resize(first + points.size());
+        Z.resize(first + points.size());
+        W.resize(first + points.size());
+
+        for (std::size_t i = 0; i < points.size(); i++)
+            Set(first + i, points[i], weights[i]);
+    }
+
+    void Reserve(std::size_t count)
+    {
+        X.reserve(count);
+        Y.reserve(count);
+        Z.reserve(count);
+        W.reserve(count);
+    }
+
+    void Resize(std::size_t count)
+    {
+        X.resize(count);
+        Y.resize(count);
+        Z.resize(count);
+        W.resize(count);
+    }
+
+    void Clear()
+    {
+        X.clear();
+        Y.clear();
+        Z.clear();
+        W.clear();
+    }
+
+    void Erase(std::size_t index)
+    {
+        X.erase(X.begin() + index);
+        Y.erase(Y.begin() + index);
+        Z.erase(Z.begin() + index);
+        W.erase(W.begin() + index);
+    }
+
+    inline std::size_t Size() const { return X.size(); }
+};
+
+/**
+ * @brief Everything a batch kernel needs to evaluate a B-Spline curve
+ */
+struct BSplineBatchData
+{
+    const std::vector<float> &Knots;
+    const ControlPointsSoA &ControlPoints;
+    uint8_t Degree;
+    const BSplineBasis::KnotSpanLookup &Spans; // built on Knots and Degree
+};
+
+namespace BSplineSIMD
+{
+    enum class InstructionSet
+    {
+        Scalar,
+        AVX2,  // 8 parameters per instruction
+        AVX512 // 16 parameters per instruction
+    };
+
+    /**
+     * @brief The widest instruction set supported by the running CPU (detected once)
+     */
+    InstructionSet GetInstructionSet();
+
+    const char *GetInstructionSetName(InstructionSet instructionSet);
+
+    /**
+     * @brief Evaluate the (rational) curve at count parameters with the widest instruction set available
+     * @note The homogeneous point is accumulated then projected, a single division per parameter
+     * @param data The curve to evaluate
+     * @param ts The parameters, values outside the knots range are extrapolated from the first/last span.
+     * Any order is valid, sorted parameters are the fastest (the span of each one is searched from the previous one)
+     * @param out Output, count points
+     * @param count
+     */
+    void EvaluateBatch(const BSplineBatchData &data, const float *ts, glm::vec3 *out, std::size_t count);
+
+    /**
+     * @brief Same as above with an explicit instruction set, falls back to scalar if the CPU does not support it
+     */
+    void EvaluateBatch(const BSplineBatchData &data, const float *ts, glm::vec3 *out, std::size_t count, InstructionSet instructionSet);
+
+    /**
+     * @brief Lane-Riesenfeld subdivision of one coordinate of the control points of a uniform B-Spline
+     * @note Each level doubles the points then averages the neighbours degree times (in place, one addition and one multiplication per point),
+     * the doubling and the first average are fused in a single pass to the scratch buffer which is then swapped with the values.
+     * n control points give 2^levels * (n - degree) + degree control points of the same curve, the buffers keep their capacity
+     * @param values In: the coordinate of the control points, out: the coordinate of the subdivided control points
+     * @param scratch Second buffer of the double buffering, its content is overwritten
+     * @param degree The degree of the curve, at least 1
+     * @param levels The number of subdivisions
+     */
+    void SubdivideUniform(std::vector<float> &values, std::vector<float> &scratch, uint8_t degree, int levels);
+
+    /**
+     * @brief Same as above with an explicit instruction set, falls back to scalar if the CPU does not support it
+     */
+    void SubdivideUniform(std::vector<float> &values, std::vector<float> &scratch, uint8_t degree, int levels, InstructionSet instructionSet);
+
+    /**
+     * @brief Apply a stencil to consecutive homogeneous points and project the results: out[i] = sum of stencil[j] * points[i + j]
+     * @note Moves the subdivided control points of a uniform B-Spline to the curve (see SubdivideUniform)
+     * @param points The homogeneous points, at least count + stencilSize - 1 of them
+     * @param stencil The weights
+     * @param stencilSize The number of weights
+     * @param out Output, count points
+     * @param count
+     */
+    void ApplyStencil(const ControlPointsSoA &points, const float *stencil, int stencilSize, glm::vec3 *out, std::size_t count);
+}
@@ -25,6 +25,13 @@ namespace TP1_Nurbs
             return points;
         }
 
+        std::size_t GetControlPointIndex(uint8_t id)
+        {
+            auto it = std::find_if(ControlPoints.begin(), ControlPoints.end(), [id](const ControlPoint &point)
+                                   { return point.ID == id; });
+            return std::distance(ControlPoints.begin(), it);
+        }
+
         ControlPoint &GetHoveredControlPoint()
         {
             auto it = std::find_if(ControlPoints.begin(), ControlPoints.end(), [](const ControlPoint &point)
@@ -42,6 +49,12 @@ namespace TP1_Nurbs
         bool ShowCurvature = true;
         bool ShowSurface = true;
 
+        int KnotsType = static_cast<int>(BSplineType::Uniform);
+
+        int TessellationMode = static_cast<int>(CurveTessellationMode::Uniform);
+        CurveTessellationTolerance TessellationTolerance;
+        int SubdivisionLevels = 6;
+
         bool IsExtruding = false;
         bool IsDragging = false;
     };
@@ -51,6 +64,9 @@ namespace TP1_Nurbs
     static EditorData s_EditorData;
     static glm::vec3 s_LastSelectedPointPosition;
 
+    // distance from the mouse ray under which a click picks the curve, per unit of distance from the camera
+    static constexpr float CurvePickingDistance = 0.05f;
+
     Editor::Editor() : Layer("Editor"), m_Spline(BSplineCurve(s_SplineData.Degree))
     {
         { // Init the camera
@@ -98,12 +114,13 @@ namespace TP1_Nurbs
 
         if (s_EditorData.ShowFrenetFrame || s_EditorData.ShowCurvature)
         {
-            glm::vec3 currentPoint = m_Spline.EvaluateAt(s_SplineData.T);
-            CurveFrenetFrameComponents frenetFrame = m_Spline.GetFrenetFrameAt(s_SplineData.T);
+            CurvePointDerivatives derivatives = m_Spline.EvaluateDerivativesAt(s_SplineData.T);
+            glm::vec3 currentPoint = derivatives.Position;
+            CurveFrenetFrameComponents frenetFrame = BSplineCurve::ComputeFrenetFrame(derivatives);
 
             if (s_EditorData.ShowCurvature) // curvature circle
             {
-                float curvature = m_Spline.GetCurvatureAt(s_SplineData.T);
+                float curvature = BSplineCurve::ComputeCurvature(derivatives);
                 Renderer::DrawCurvature(currentPoint, frenetFrame, curvature);
             }
 
@@ -111,11 +128,10 @@ namespace TP1_Nurbs
                 Renderer::DrawFrenetFrame(currentPoint, frenetFrame);
         }
 
-        if (s_EditorData.ShowSurface) // circles along the curve
+        if (s_EditorData.ShowSurface) // tube along the curve, rebuilt only when the curve changed
         {
-            float minT = m_Spline.GetMinT();
-            float maxT = m_Spline.GetMaxT();
-            Renderer::DrawSurfaceAlongCurve(m_Spline, minT, maxT);
+            m_SweepSurface.Update(m_Spline, m_Spline.GetMinT(), m_Spline.GetMaxT());
+            Renderer::DrawSweepSurface(m_SweepSurface);
         }
 
         Renderer::EndScene();
@@ -150,9 +166,50 @@ namespace TP1_Nurbs
         ImGui::Checkbox("Render curvature", &s_EditorData.ShowCurvature);
         ImGui::Separator();
         ImGui::Checkbox("Render surface", &s_EditorData.ShowSurface);
+        ImGui::Separator();
+        const char *knotsTypes[] = {"Uniform", "Open uniform", "Chord length", "Centripetal"};
+        if (ImGui::Combo("Knots", &s_EditorData.KnotsType, knotsTypes, IM_ARRAYSIZE(knotsTypes)))
+        {
+            m_Spline.SetType(static_cast<BSplineType>(s_EditorData.KnotsType));
+            m_Spline.Evaluate();
+            s_SplineData.T = glm::clamp(s_SplineData.T, m_Spline.GetMinT(), m_Spline.GetMaxT());
+        }
+        const char *tessellationModes[] = {"Uniform", "Adaptive", "Subdivision"};
+        if (ImGui::Combo("Tessellation", &s_EditorData.TessellationMode, tessellationModes, IM_ARRAYSIZE(tessellationModes)))
+        {
+            m_Spline.SetTessellationMode(static_cast<CurveTessellationMode>(s_EditorData.TessellationMode));
+            m_Spline.Evaluate();
+        }
+        if (s_EditorData.TessellationMode == static_cast<int>(CurveTessellationMode::Subdivision))
+        {
+            if (ImGui::SliderInt("Levels", &s_EditorData.SubdivisionLevels, 1, BSplineCurve::MaxSubdivisionLevels))
+            {
+                m_Spline.SetSubdivisionLevels(s_EditorData.SubdivisionLevels);
+                m_Spline.Evaluate();
+            }
+        }
+        if (s_EditorData.TessellationMode == static_cast<int>(CurveTessellationMode::Adaptive))
+        {
+            bool changed = ImGui::SliderFloat("Chordal deviation", &s_EditorData.TessellationTolerance.ChordalDeviation, 1e-5f, 1e-1f, "%.5f", ImGuiSliderFlags_Logarithmic);
+            changed |= ImGui::SliderAngle("Angle", &s_EditorData.TessellationTolerance.Angle, 0.5f, 45.0f);
+            if (changed)
+            {
+                m_Spline.SetTessellationTolerance(s_EditorData.TessellationTolerance);
+                m_Spline.Evaluate();
+            }
+        }
+        ImGui::Text("%zu points", m_Spline.GetPoints().size());
 
         if(s_SplineData.SelectedControlPoint)
         {
+            std::size_t index = s_SplineData.GetControlPointIndex(s_SplineData.SelectedControlPoint->ID);
+            float weight = m_Spline.GetWeights()[index];
+            if (ImGui::SliderFloat("Weight", &weight, 0.1f, 10.0f, "%.2f", ImGuiSliderFlags_Logarithmic))
+            {
+                m_Spline.SetWeight(index, weight);
+                m_Spline.Evaluate();
+            }
+
             ImGui::Text("Press 'G' to enable/disable dragging");
             ImGui::Text("Press 'E' to extrude a new control point");
             ImGui::Text("Press 'Delete' to delete a control point");
@@ -188,7 +245,7 @@ namespace TP1_Nurbs
         else // insert between two points
             new_it = s_SplineData.ControlPoints.insert(it + 1, newControlPoint);
 
-        m_Spline.SetControlPoints(s_SplineData.GetControlPoints());
+        m_Spline.InsertControlPoint(std::distance(s_SplineData.ControlPoints.begin(), new_it), newControlPoint.Position);
         m_Spline.Evaluate();
 
         s_SplineData.SelectedControlPoint = &(*new_it);
@@ -202,14 +259,12 @@ namespace TP1_Nurbs
         if (s_SplineData.SelectedControlPoint && s_SplineData.SelectedControlPoint->ID == id)
             s_SplineData.SelectedControlPoint = nullptr;
 
-        auto it = std::remove_if(
-            s_SplineData.ControlPoints.begin(),
-            s_SplineData.ControlPoints.end(),
-            [id](const ControlPoint &point)
-            { return point.ID == id; });
+        std::size_t index = s_SplineData.GetControlPointIndex(id);
+        if (index == s_SplineData.ControlPoints.size())
+            return;
 
-        s_SplineData.ControlPoints.erase(it, s_SplineData.ControlPoints.end());
-        m_Spline.SetControlPoints(s_SplineData.GetControlPoints());
+        s_SplineData.ControlPoints.erase(s_SplineData.ControlPoints.begin() + index);
+        m_Spline.RemoveControlPoint(index);
         m_Spline.Evaluate();
     }
 
@@ -231,7 +286,9 @@ namespace TP1_Nurbs
 
         s_SplineData.SelectedControlPoint->Position = projectedPoint;
 
-        m_Spline.SetControlPoints(s_SplineData.GetControlPoints());
+        // only the segments around the moved point are re-evaluated
+        std::size_t index = s_SplineData.GetControlPointIndex(s_SplineData.SelectedControlPoint->ID);
+        m_Spline.SetControlPoint(index, projectedPoint);
         m_Spline.Evaluate();
     }
 
@@ -244,13 +301,34 @@ namespace TP1_Nurbs
             return;
         }
 
+        std::size_t index = s_SplineData.GetControlPointIndex(s_SplineData.SelectedControlPoint->ID);
         s_SplineData.SelectedControlPoint->Position = s_LastSelectedPointPosition;
         s_SplineData.SelectedControlPoint->Selected = false;
         s_SplineData.SelectedControlPoint = nullptr;
-        m_Spline.SetControlPoints(s_SplineData.GetControlPoints());
+        m_Spline.SetControlPoint(index, s_LastSelectedPointPosition);
         m_Spline.Evaluate();
     }
 
+    bool Editor::PickCurvePoint()
+    {
+        glm::vec2 mousePosition = Input::GetMousePosition();
+
+        float width = Core::Application::Get().GetWindow().GetWidth();
+        float height = Core::Application::Get().GetWindow().GetHeight();
+
+        // ray from the camera through the mouse
+        glm::vec3 cameraPosition = m_CameraController->GetPosition();
+        glm::vec3 worldPoint = m_Camera->ScreenToWorld(mousePosition, {width, height});
+        glm::vec3 direction = glm::normalize(worldPoint - cameraPosition);
+
+        CurveProjection projection = m_Spline.ClosestPointToRay(cameraPosition, direction);
+        if (projection.Distance > CurvePickingDistance * glm::max(projection.RayParameter, 1.0f))
+            return false;
+
+        s_SplineData.T = projection.T;
+        return true;
+    }
+
     bool Editor::OnMouseMoved(const Events::MouseMovedEvent &e)
     {
         auto mousePosition = Input::GetMousePosition();
@@ -280,6 +358,9 @@ namespace TP1_Nurbs
                 return false;
             }
 
+            if (!point.Hovered && PickCurvePoint())
+                return false;
+
             if (s_SplineData.SelectedControlPoint)
                 s_SplineData.SelectedControlPoint->Selected = false;
             s_SplineData.SelectedControlPoint = nullptr;
@@ -29,6 +29,12 @@ namespace TP1_Nurbs
         void DragSelectedPoint();
         void CancelDragging();
 
+        /**
+         * @brief Move the t cursor to the point of the curve under the mouse
+         * @return false when the mouse is not over the curve
+         */
+        bool PickCurvePoint();
+
         bool OnMouseMoved(const Events::MouseMovedEvent &e);
         bool OnKeyPressed(const Events::KeyPressedEvent &e);
         bool OnMouseButtonPressed(const Events::MouseButtonPressedEvent &e);
@@ -36,6 +42,7 @@ namespace TP1_Nurbs
 
     private:
         BSplineCurve m_Spline;
+        TubeMesh m_SweepSurface;
         Shared<PerspectiveCamera> m_Camera;
         Shared<ArcBallCameraController> m_CameraController;
     };
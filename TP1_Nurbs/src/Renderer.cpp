@@ -2,6 +2,21 @@
 
 namespace TP1_Nurbs
 {
+    struct SweepSurfaceBuffers
+    {
+        Shared<VertexArray> VAO;
+        Shared<VertexBuffer> VBO;
+        Shared<IndexBuffer> IBO;
+        Shared<Shader> Program;
+
+        // the mesh in the buffers and the one to draw in this scene
+        const TubeMesh *UploadedMesh = nullptr;
+        uint64_t UploadedVersion = 0;
+        uint32_t IndicesCount = 0;
+        bool Submitted = false;
+    };
+
+    static SweepSurfaceBuffers s_SweepSurface;
     static RenderPass s_RenderPass;
 
     void Renderer::Init()
@@ -22,6 +37,9 @@ namespace TP1_Nurbs
         renderPassSpecs.ClearColor = {0.1f, 0.1f, 0.1f, 1.0f};
 
         s_RenderPass.SetSpecifications(renderPassSpecs);
+
+        std::string workingDirectory = Core::Application::Get().GetSpecification().WorkingDirectory;
+        s_SweepSurface.Program = CreateShared<Shader>("Sweep Surface Shader", workingDirectory + "shaders/sweep_surface.glsl");
     }
 
     void Renderer::BeginScene(const glm::mat4 &viewProjection)
@@ -42,6 +60,15 @@ namespace TP1_Nurbs
         // flush all draw calls
         Renderer2D::EndScene();
 
+        // the transparent surface is blended over everything else
+        if (s_SweepSurface.Submitted && s_SweepSurface.IndicesCount > 0)
+        {
+            s_SweepSurface.Program->Bind();
+            s_SweepSurface.Program->SetFloat4("u_Color", {1.0f, 0.0f, 0.0f, 0.5f});
+            RenderCommand::DrawIndexed(s_SweepSurface.VAO, s_SweepSurface.IndicesCount);
+        }
+        s_SweepSurface.Submitted = false;
+
         // unbind render pass framebuffer
         s_RenderPass.EndPass();
 
@@ -113,42 +140,38 @@ namespace TP1_Nurbs
         }
     }
 
-    void Renderer::DrawSurfaceAlongCurve(const BSplineCurve &spline, float fromT, float toT)
+    void Renderer::DrawSweepSurface(const TubeMesh &mesh)
     {
-        if (fromT == -1.0f)
-            fromT = spline.GetMinT();
-
-        if (toT == -1.0f)
-            toT = spline.GetMaxT();
+        s_SweepSurface.Submitted = true;
 
-        auto points = spline.GetPoints();
+        if (s_SweepSurface.UploadedMesh == &mesh && s_SweepSurface.UploadedVersion == mesh.GetVersion())
+            return;
 
-        glm::vec4 color = {1.0f, 0.0f, 0.0f, 0.5f};
-        float radius = 0.5f;
+        const std::vector<TubeVertex> &vertices = mesh.GetVertices();
+        const std::vector<uint32_t> &indices = mesh.GetIndices();
 
-        float t = fromT;
-        float deltaT = 0.01f;
-
-        int nbPointsPerCircle = 32;
-        float angleStep = 2 * M_PI / nbPointsPerCircle;
-
-        while (t < toT)
+        // the buffers grow with the mesh, they are created once
+        if (!s_SweepSurface.VAO)
         {
-            auto point = spline.EvaluateAt(t);
-            auto [tangent, normal, binormal] = spline.GetFrenetFrameAt(t);
-
-            float angle = 0.0f;
+            s_SweepSurface.VAO = CreateShared<VertexArray>();
+            s_SweepSurface.VBO = CreateShared<VertexBuffer>(vertices.size() * sizeof(TubeVertex));
+            BufferLayout layout = {
+                {ShaderDataType::Float3, "a_Position"},
+                {ShaderDataType::Float3, "a_Normal"},
+            };
+            s_SweepSurface.VBO->SetLayout(layout);
+            s_SweepSurface.VAO->AddVertexBuffer(s_SweepSurface.VBO);
+
+            s_SweepSurface.IBO = CreateShared<IndexBuffer>(indices.size());
+            s_SweepSurface.VAO->SetIndexBuffer(s_SweepSurface.IBO);
+        }
 
-            for (int i = 0; i < nbPointsPerCircle; i++)
-            {
-                glm::vec3 p1 = point + radius * normal * glm::cos(angle) + radius * binormal * glm::sin(angle);
-                glm::vec3 p2 = point + radius * normal * glm::cos(angle + angleStep) + radius * binormal * glm::sin(angle + angleStep);
-                Renderer2D::DrawLine(p1, p2, color);
+        s_SweepSurface.VBO->SetData(vertices.size() * sizeof(TubeVertex), vertices.data());
+        s_SweepSurface.IBO->SetData(indices.size(), indices.data());
 
-                angle += angleStep;
-            }
-            t += deltaT;
-        }
+        s_SweepSurface.UploadedMesh = &mesh;
+        s_SweepSurface.UploadedVersion = mesh.GetVersion();
+        s_SweepSurface.IndicesCount = indices.size();
     }
 #pragma endregion
 
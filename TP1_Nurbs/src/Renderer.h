@@ -2,6 +2,7 @@
 
 #include "SmartGL.h"
 #include "BSplineCurve.h"
+#include "TubeMesh.h"
 
 using namespace SmartGL;
 
@@ -33,7 +34,12 @@ namespace TP1_Nurbs
         static void DrawControlPoints(const std::vector<ControlPoint> &controlPoints);
         static void DrawFrenetFrame(const glm::vec3 curvePoint, const CurveFrenetFrameComponents &frenetFrame);
         static void DrawCurvature(const glm::vec3 curvePoint, const CurveFrenetFrameComponents &frenetFrame, float curvature);
-        static void DrawSurfaceAlongCurve(const BSplineCurve &spline, float fromT = -1.0f, float toT = -1.0f);
+
+        /**
+         * @brief Draw a tube swept along the curve, after the other draws (it is transparent)
+         * @note The mesh is uploaded to the GPU only when its version changed since the last upload
+         */
+        static void DrawSweepSurface(const TubeMesh &mesh);
 
         static void Resize(uint32_t width, uint32_t height);
 
@@ -0,0 +1,122 @@
+#include "TubeMesh.h"
+
+#include "glm/gtc/constants.hpp"
+
+// as many rings as with a 0.01 step in t, equally spaced along the curve
+static constexpr float RingsPerParameterUnit = 100.0f;
+
+bool TubeMesh::Update(const BSplineCurve &curve, float fromT, float toT)
+{
+    if (!m_Dirty && m_Curve == &curve && m_CurveVersion == curve.GetVersion() && m_FromT == fromT && m_ToT == toT)
+        return false;
+
+    Build(curve, fromT, toT);
+
+    m_Curve = &curve;
+    m_CurveVersion = curve.GetVersion();
+    m_FromT = fromT;
+    m_ToT = toT;
+    m_Dirty = false;
+    m_Version++;
+    return true;
+}
+
+void TubeMesh::ComputeRotationMinimizingFrames(const BSplineCurve &curve, const std::vector<float> &parameters, std::vector<CurveFrame> &frames)
+{
+    frames.resize(parameters.size());
+    if (parameters.empty())
+        return;
+
+    // one pass over the span gives the point and the tangent
+    for (std::size_t i = 0; i < parameters.size(); i++)
+    {
+        CurvePointDerivatives derivatives = curve.EvaluateDerivativesAt(parameters[i]);
+        float speed = glm::length(derivatives.Velocity);
+
+        frames[i].Position = derivatives.Position;
+        frames[i].Tangent = speed > 0.0f ? derivatives.Velocity / speed : (i > 0 ? frames[i - 1].Tangent : glm::vec3(1.0f, 0.0f, 0.0f));
+
+        if (i == 0)
+        {
+            // the Frenet normal if it is defined, any normal otherwise
+            glm::vec3 tangent = frames[0].Tangent;
+            glm::vec3 normal = derivatives.Acceleration - glm::dot(derivatives.Acceleration, tangent) * tangent;
+            if (glm::length(normal) < 1e-6f)
+            {
+                glm::vec3 axis = glm::abs(tangent.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                normal = glm::cross(tangent, axis);
+            }
+            frames[0].Normal = glm::normalize(normal);
+        }
+    }
+
+    // double reflection, the first reflection maps the point i to the point i + 1, the second one fixes the tangent
+    for (std::size_t i = 0; i + 1 < frames.size(); i++)
+    {
+        const CurveFrame &frame = frames[i];
+        CurveFrame &next = frames[i + 1];
+
+        glm::vec3 normal = frame.Normal;
+        glm::vec3 tangent = frame.Tangent;
+
+        glm::vec3 v1 = next.Position - frame.Position;
+        float c1 = glm::dot(v1, v1);
+        if (c1 > 0.0f)
+        {
+            normal -= (2.0f / c1) * glm::dot(v1, normal) * v1;
+            tangent -= (2.0f / c1) * glm::dot(v1, tangent) * v1;
+        }
+
+        glm::vec3 v2 = next.Tangent - tangent;
+        float c2 = glm::dot(v2, v2);
+        if (c2 > 0.0f)
+            normal -= (2.0f / c2) * glm::dot(v2, normal) * v2;
+
+        // the reflections keep the frame orthonormal up to rounding, which is removed before it accumulates
+        next.Normal = glm::normalize(normal - glm::dot(normal, next.Tangent) * next.Tangent);
+    }
+
+    for (CurveFrame &frame : frames)
+        frame.Binormal = glm::cross(frame.Tangent, frame.Normal);
+}
+
+void TubeMesh::Build(const BSplineCurve &curve, float fromT, float toT)
+{
+    m_Vertices.clear();
+    m_Indices.clear();
+    m_Frames.clear();
+
+    if (curve.GetPoints().empty() || !(toT > fromT))
+        return;
+
+    uint32_t nbRings = static_cast<uint32_t>((toT - fromT) * RingsPerParameterUnit) + 1;
+    curve.ResampleByLength(curve.LengthAtParameter(fromT), curve.LengthAtParameter(toT), nbRings, m_Parameters);
+    ComputeRotationMinimizingFrames(curve, m_Parameters, m_Frames);
+
+    // each ring shares the cosines and sines of its angles
+    uint32_t nbSides = m_SidesCount;
+    m_Vertices.resize(m_Frames.size() * nbSides);
+    for (std::size_t ring = 0; ring < m_Frames.size(); ring++)
+    {
+        const CurveFrame &frame = m_Frames[ring];
+        for (uint32_t side = 0; side < nbSides; side++)
+        {
+            float angle = glm::two_pi<float>() * side / nbSides;
+            glm::vec3 normal = glm::cos(angle) * frame.Normal + glm::sin(angle) * frame.Binormal;
+            m_Vertices[ring * nbSides + side] = {frame.Position + m_Radius * normal, normal};
+        }
+    }
+
+    // two triangles between each pair of consecutive rings and sides, the last side closes the ring
+    m_Indices.reserve((m_Frames.size() - 1) * nbSides * 6);
+    for (uint32_t ring = 0; ring + 1 < m_Frames.size(); ring++)
+        for (uint32_t side = 0; side < nbSides; side++)
+        {
+            uint32_t a = ring * nbSides + side;
+            uint32_t b = ring * nbSides + (side + 1) % nbSides;
+            uint32_t c = a + nbSides;
+            uint32_t d = b + nbSides;
+
+            m_Indices.insert(m_Indices.end(), {a, c, d, a, d, b});
+        }
+}
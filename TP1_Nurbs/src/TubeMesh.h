@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "BSplineCurve.h"
+
+struct TubeVertex
+{
+    glm::vec3 Position;
+    glm::vec3 Normal;
+};
+
+/**
+ * @brief Orthonormal frame attached to a point of a curve
+ */
+struct CurveFrame
+{
+    glm::vec3 Position;
+    glm::vec3 Tangent;
+    glm::vec3 Normal;
+    glm::vec3 Binormal;
+};
+
+/**
+ * @brief Indexed triangle mesh of a tube swept along a curve
+ * @note The rings follow rotation minimising frames: unlike the Frenet frame they do not flip at the inflection points
+ * and they are defined where the curvature vanishes. The mesh is only rebuilt when the curve (see BSplineCurve::GetVersion),
+ * its range or the settings of the tube change, the renderer uploads it once per version.
+ */
+class TubeMesh
+{
+public:
+    TubeMesh() = default;
+    ~TubeMesh() = default;
+
+    /**
+     * @brief Rebuild the mesh if the curve or the tube changed since the last call
+     * @param curve The evaluated curve to sweep
+     * @param fromT The parameter of the first ring
+     * @param toT The parameter of the last ring
+     * @return True if the mesh was rebuilt
+     */
+    bool Update(const BSplineCurve &curve, float fromT, float toT);
+
+    /**
+     * @brief Compute rotation minimising frames with the double reflection method (Wang et al.)
+     * @note Each frame is the previous one reflected in the bisector plane of the two points, then in the plane
+     * that brings the tangent to the new tangent. The first normal is the Frenet normal when the curvature is not null.
+     * One evaluation of the curve per frame
+     * @param curve The curve
+     * @param parameters Increasing parameters
+     * @param frames Output, one frame per parameter
+     */
+    static void ComputeRotationMinimizingFrames(const BSplineCurve &curve, const std::vector<float> &parameters, std::vector<CurveFrame> &frames);
+
+    inline void SetRadius(float radius)
+    {
+        m_Radius = radius;
+        m_Dirty = true;
+    }
+    inline float GetRadius() const { return m_Radius; }
+
+    /**
+     * @brief Set the number of vertices of each ring
+     */
+    inline void SetSidesCount(uint32_t sidesCount)
+    {
+        m_SidesCount = glm::max(sidesCount, 3u);
+        m_Dirty = true;
+    }
+    inline uint32_t GetSidesCount() const { return m_SidesCount; }
+
+    inline const std::vector<CurveFrame> &GetFrames() const { return m_Frames; }
+    inline const std::vector<TubeVertex> &GetVertices() const { return m_Vertices; }
+    inline const std::vector<uint32_t> &GetIndices() const { return m_Indices; }
+
+    /**
+     * @brief Incremented each time the mesh is rebuilt
+     */
+    inline uint64_t GetVersion() const { return m_Version; }
+
+private:
+    void Build(const BSplineCurve &curve, float fromT, float toT);
+
+private:
+    std::vector<float> m_Parameters;
+    std::vector<CurveFrame> m_Frames;
+    std::vector<TubeVertex> m_Vertices;
+    std::vector<uint32_t> m_Indices;
+
+    float m_Radius = 0.5f;
+    uint32_t m_SidesCount = 32;
+
+    // what the mesh was built from
+    const BSplineCurve *m_Curve = nullptr;
+    uint64_t m_CurveVersion = 0;
+    float m_FromT = 0.0f;
+    float m_ToT = 0.0f;
+    bool m_Dirty = true;
+
+    uint64_t m_Version = 0;
+};
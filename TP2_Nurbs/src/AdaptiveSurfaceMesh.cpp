@@ -0,0 +1,225 @@
+#include "AdaptiveSurfaceMesh.h"
+#include "Core/Assert.h"
+
+#include <algorithm>
+
+// distance to the camera under which a node is treated as touching it
+static constexpr float MinCameraDistance = 1e-4f;
+
+/**
+ * @brief The distinct knots of the range of a direction, they bound its non-empty spans
+ */
+static void FindSpanKnots(const BSplineAttributes &attributes, std::vector<float> &spanKnots)
+{
+    spanKnots.clear();
+
+    const std::vector<float> &knots = attributes.Knots;
+    if (knots.size() < 2u * attributes.Degree + 2)
+        return;
+
+    for (std::size_t k = attributes.Degree; k < knots.size() - attributes.Degree; k++)
+        if (spanKnots.empty() || knots[k] > spanKnots.back())
+            spanKnots.push_back(knots[k]);
+
+    if (spanKnots.size() < 2)
+        spanKnots.clear();
+}
+
+/**
+ * @brief The parameter of a lattice coordinate, a coordinate shared by two spans starts the second one
+ */
+static float LatticeParameter(const std::vector<float> &spanKnots, uint8_t depth, uint32_t coordinate)
+{
+    uint32_t span = std::min<uint32_t>(coordinate >> depth, spanKnots.size() - 2);
+    uint32_t local = coordinate - (span << depth);
+    return spanKnots[span] + (spanKnots[span + 1] - spanKnots[span]) * local / float(1u << depth);
+}
+
+bool AdaptiveSurfaceMesh::Update(const BSplineSurface &surface, const SurfaceTessellationView &view)
+{
+    bool surfaceChanged = m_Dirty || &surface != m_Surface || surface.GetVersion() != m_SurfaceVersion;
+    if (surfaceChanged)
+        Reset(surface);
+
+    m_Leaves.swap(m_PreviousLeaves);
+    m_Leaves.clear();
+
+    uint32_t spansU = m_SpanKnotsU.empty() ? 0 : m_SpanKnotsU.size() - 1;
+    uint32_t spansV = m_SpanKnotsV.empty() ? 0 : m_SpanKnotsV.size() - 1;
+    for (uint32_t spanU = 0; spanU < spansU; spanU++)
+        for (uint32_t spanV = 0; spanV < spansV; spanV++)
+            Refine(surface, view, 0, spanU << m_MaxDepth, spanV << m_MaxDepth);
+
+    // the camera moved without changing the leaves, the mesh is still the right one
+    if (!surfaceChanged && m_Leaves == m_PreviousLeaves)
+        return false;
+
+    Build(surface);
+    m_Version++;
+    return true;
+}
+
+void AdaptiveSurfaceMesh::Reset(const BSplineSurface &surface)
+{
+    m_Surface = &surface;
+    m_SurfaceVersion = surface.GetVersion();
+    m_Dirty = false;
+
+    m_LatticeVertices.clear();
+    m_NodeErrors.clear();
+
+    FindSpanKnots(surface.GetAttributes().U, m_SpanKnotsU);
+    FindSpanKnots(surface.GetAttributes().V, m_SpanKnotsV);
+    if (surface.GetControlPoints().empty())
+    {
+        m_SpanKnotsU.clear();
+        m_SpanKnotsV.clear();
+    }
+
+    SMART_ASSERT(((uint64_t)std::max(m_SpanKnotsU.size(), m_SpanKnotsV.size()) << m_MaxDepth) < (1ull << 29),
+                 "Too many spans for the lattice of the adaptive mesh, reduce its maximum depth");
+}
+
+void AdaptiveSurfaceMesh::Refine(const BSplineSurface &surface, const SurfaceTessellationView &view, uint8_t level, uint32_t x, uint32_t y)
+{
+    if (level < m_MaxDepth)
+    {
+        bool split = level < m_MinDepth;
+        if (!split)
+        {
+            const NodeError &node = GetNodeError(surface, level, x, y);
+            if (m_Criterion == SurfaceRefinementCriterion::Flatness)
+                split = node.Error > m_Tolerance;
+            else
+            {
+                float distance = glm::max(glm::sqrt(node.Bounds.Distance2(view.CameraPosition)), MinCameraDistance);
+                split = node.Error * view.PixelsPerUnit > m_Tolerance * distance;
+            }
+        }
+
+        if (split)
+        {
+            uint32_t half = 1u << (m_MaxDepth - level - 1);
+            Refine(surface, view, level + 1, x, y);
+            Refine(surface, view, level + 1, x + half, y);
+            Refine(surface, view, level + 1, x, y + half);
+            Refine(surface, view, level + 1, x + half, y + half);
+            return;
+        }
+    }
+
+    m_Leaves.push_back(NodeKey(level, x, y));
+}
+
+const SurfaceVertex &AdaptiveSurfaceMesh::GetLatticeVertex(const BSplineSurface &surface, uint32_t x, uint32_t y)
+{
+    auto [vertex, inserted] = m_LatticeVertices.try_emplace(PointKey(x, y));
+    if (inserted)
+    {
+        SurfacePointDerivatives derivatives = surface.EvaluateDerivativesAt(LatticeParameter(m_SpanKnotsU, m_MaxDepth, x),
+                                                                            LatticeParameter(m_SpanKnotsV, m_MaxDepth, y));
+        vertex->second = {derivatives.Position, BSplineSurface::ComputeCurvatures(derivatives).GaussianCurvature};
+    }
+    return vertex->second;
+}
+
+const AdaptiveSurfaceMesh::NodeError &AdaptiveSurfaceMesh::GetNodeError(const BSplineSurface &surface, uint8_t level, uint32_t x, uint32_t y)
+{
+    auto [node, inserted] = m_NodeErrors.try_emplace(NodeKey(level, x, y));
+    if (!inserted)
+        return node->second;
+
+    // the 3 x 3 points of the node, the bilinear patch of the corners is the surface of the leaf
+    uint32_t half = 1u << (m_MaxDepth - level - 1);
+    glm::vec3 points[3][3];
+    for (uint32_t i = 0; i < 3; i++)
+        for (uint32_t j = 0; j < 3; j++)
+            points[i][j] = GetLatticeVertex(surface, x + i * half, y + j * half).Position;
+
+    NodeError &error = node->second;
+    error.Error = 0.0f;
+    error.Bounds = {};
+    for (uint32_t i = 0; i < 3; i++)
+        for (uint32_t j = 0; j < 3; j++)
+        {
+            float s = 0.5f * i, t = 0.5f * j;
+            glm::vec3 bilinear = (1.0f - s) * ((1.0f - t) * points[0][0] + t * points[0][2]) + s * ((1.0f - t) * points[2][0] + t * points[2][2]);
+            error.Error = glm::max(error.Error, glm::distance(points[i][j], bilinear));
+            error.Bounds.Expand(points[i][j]);
+        }
+
+    // the surface between the samples may bulge up to about the error
+    error.Bounds.Min -= glm::vec3(error.Error);
+    error.Bounds.Max += glm::vec3(error.Error);
+    return error;
+}
+
+uint32_t AdaptiveSurfaceMesh::GetMeshIndex(const BSplineSurface &surface, uint32_t x, uint32_t y)
+{
+    auto [index, inserted] = m_MeshIndices.try_emplace(PointKey(x, y), (uint32_t)m_Vertices.size());
+    if (inserted)
+        m_Vertices.push_back(GetLatticeVertex(surface, x, y));
+    return index->second;
+}
+
+void AdaptiveSurfaceMesh::Build(const BSplineSurface &surface)
+{
+    m_Vertices.clear();
+    m_Indices.clear();
+    m_MeshIndices.clear();
+    m_Corners.clear();
+
+    auto decode = [this](uint64_t leaf, uint32_t &x, uint32_t &y, uint32_t &size)
+    {
+        uint8_t level = leaf >> 58;
+        x = (leaf >> 29) & ((1u << 29) - 1);
+        y = leaf & ((1u << 29) - 1);
+        size = 1u << (m_MaxDepth - level);
+    };
+
+    uint32_t x, y, size;
+    for (uint64_t leaf : m_Leaves)
+    {
+        decode(leaf, x, y, size);
+        m_Corners.insert(PointKey(x, y));
+        m_Corners.insert(PointKey(x + size, y));
+        m_Corners.insert(PointKey(x, y + size));
+        m_Corners.insert(PointKey(x + size, y + size));
+    }
+
+    m_Vertices.reserve(m_Corners.size());
+    m_Indices.reserve(6 * m_Leaves.size());
+
+    for (uint64_t leaf : m_Leaves)
+    {
+        decode(leaf, x, y, size);
+
+        // the corners of the leaf and of its finer neighbours around it, in the winding of the grid cells: along u, then v, then back
+        m_Boundary.clear();
+        auto walk = [&](uint32_t fromX, uint32_t fromY, int stepX, int stepY)
+        {
+            m_Boundary.push_back(GetMeshIndex(surface, fromX, fromY));
+            for (uint32_t k = 1; k < size; k++)
+            {
+                uint32_t pointX = fromX + stepX * (int)k, pointY = fromY + stepY * (int)k;
+                if (m_Corners.count(PointKey(pointX, pointY)))
+                    m_Boundary.push_back(GetMeshIndex(surface, pointX, pointY));
+            }
+        };
+        walk(x, y, 1, 0);
+        walk(x + size, y, 0, 1);
+        walk(x + size, y + size, -1, 0);
+        walk(x, y + size, 0, -1);
+
+        if (m_Boundary.size() == 4)
+        {
+            m_Indices.insert(m_Indices.end(), {m_Boundary[0], m_Boundary[1], m_Boundary[2], m_Boundary[0], m_Boundary[2], m_Boundary[3]});
+            continue;
+        }
+
+        // a finer neighbour: a leaf with a neighbour finer than itself is never at the maximum depth, its center is on the lattice
+        uint32_t center = GetMeshIndex(surface, x + size / 2, y + size / 2);
+        for (std::size_t k = 0; k < m_Boundary.size(); k++)
+            m_Indices.insert(m_Indices.end(), {center, m_Boundary[k], m_Boundary[(k + 1) % m_Boundary.size()]});
+    }
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "SmartGL.h"
+#include "BSplineSurface.h"
+#include "SurfaceGrid.h"
+
+enum class SurfaceRefinementCriterion
+{
+    /**
+     * @brief Split a node while the surface deviates from its bilinear patch by more than the tolerance (world units)
+     */
+    Flatness,
+
+    /**
+     * @brief Split a node while that deviation, projected at the distance of the node from the camera, exceeds the tolerance (pixels)
+     */
+    ScreenSpaceError,
+};
+
+/**
+ * @brief What the tessellator needs to know about the camera to project the errors on the screen
+ */
+struct SurfaceTessellationView
+{
+    glm::vec3 CameraPosition = glm::vec3(0.0f);
+    float PixelsPerUnit = 1.0f; // size in pixels of a unit length facing the camera at a distance of 1
+
+    /**
+     * @brief Build the view of a perspective camera
+     * @param cameraPosition The position of the camera
+     * @param projection The projection matrix of the camera, its [1][1] is 1 / tan(fov / 2)
+     * @param viewportHeight The height of the viewport in pixels
+     */
+    static inline SurfaceTessellationView FromCamera(const glm::vec3 &cameraPosition, const glm::mat4 &projection, float viewportHeight)
+    {
+        return {cameraPosition, 0.5f * viewportHeight * projection[1][1]};
+    }
+};
+
+/**
+ * @brief Indexed triangle mesh of a surface refined where it is curved or close to the camera
+ * @note Each non-empty knot span is the root of a quadtree, a node is split while it is too coarse for the criterion.
+ * The vertices lie on a lattice of (2^MaxDepth) x (2^MaxDepth) points per span shared by all the quadtrees, a vertex is evaluated
+ * once and a node measures its deviation once: both are cached until the surface changes (see BSplineSurface::GetVersion).
+ * A leaf with no finer neighbour is two triangles like a cell of the grid, a leaf touching finer ones is a fan around its center
+ * through every corner of its neighbours lying on its edges, so the mesh has no T-junction.
+ * The mesh is only rebuilt when the leaves change, moving the camera a little keeps it as it is.
+ */
+class AdaptiveSurfaceMesh
+{
+public:
+    AdaptiveSurfaceMesh() = default;
+    ~AdaptiveSurfaceMesh() = default;
+
+    /**
+     * @brief Refine the quadtrees for the surface seen from a view, then rebuild the mesh if the leaves changed
+     * @param surface The surface to tessellate
+     * @param view The camera, only read by the ScreenSpaceError criterion
+     * @return True if the mesh was rebuilt
+     */
+    bool Update(const BSplineSurface &surface, const SurfaceTessellationView &view = {});
+
+    inline void SetCriterion(SurfaceRefinementCriterion criterion) { m_Criterion = criterion; }
+    inline SurfaceRefinementCriterion GetCriterion() const { return m_Criterion; }
+
+    /**
+     * @brief Set the largest error left in the mesh, in world units (Flatness) or in pixels (ScreenSpaceError)
+     */
+    inline void SetTolerance(float tolerance) { m_Tolerance = glm::max(tolerance, 1e-6f); }
+    inline float GetTolerance() const { return m_Tolerance; }
+
+    /**
+     * @brief Set the depth every span is split to whatever its error, and the depth no span is split beyond
+     * @note A span has at least (2^minDepth)^2 and at most (2^maxDepth)^2 leaves
+     */
+    inline void SetDepths(uint8_t minDepth, uint8_t maxDepth)
+    {
+        maxDepth = glm::clamp(maxDepth, (uint8_t)1, MaxLatticeDepth);
+        minDepth = glm::min(minDepth, maxDepth);
+        m_Dirty |= maxDepth != m_MaxDepth;
+        m_MinDepth = minDepth;
+        m_MaxDepth = maxDepth;
+    }
+    inline uint8_t GetMinDepth() const { return m_MinDepth; }
+    inline uint8_t GetMaxDepth() const { return m_MaxDepth; }
+
+    /**
+     * @brief The vertices used by the mesh, with their Gaussian curvature like the grid of the surface
+     */
+    inline const std::vector<SurfaceVertex> &GetVertices() const { return m_Vertices; }
+    inline const std::vector<uint32_t> &GetIndices() const { return m_Indices; }
+    inline std::size_t GetLeavesCount() const { return m_Leaves.size(); }
+
+    /**
+     * @brief Incremented each time the mesh is rebuilt
+     */
+    inline uint64_t GetVersion() const { return m_Version; }
+
+    /**
+     * @brief The deepest supported quadtree, the coordinates of the lattice must fit the keys of the nodes
+     */
+    static constexpr uint8_t MaxLatticeDepth = 12;
+
+private:
+    /**
+     * @brief Deviation of the surface from the bilinear patch of the corners of a node, and the bounds of the node
+     */
+    struct NodeError
+    {
+        float Error;
+        SmartGL::Maths::BoundingBox Bounds;
+    };
+
+    /**
+     * @brief Forget the cached vertices and errors, and find the non-empty spans of the surface
+     */
+    void Reset(const BSplineSurface &surface);
+
+    /**
+     * @brief Add the leaves of a node to m_Leaves
+     * @param x The lattice coordinate along u of the first corner of the node
+     * @param y The lattice coordinate along v of the first corner of the node
+     */
+    void Refine(const BSplineSurface &surface, const SurfaceTessellationView &view, uint8_t level, uint32_t x, uint32_t y);
+
+    /**
+     * @brief The vertex at a point of the lattice, evaluated at the first request
+     */
+    const SurfaceVertex &GetLatticeVertex(const BSplineSurface &surface, uint32_t x, uint32_t y);
+
+    /**
+     * @brief The error of a node, measured at the first request from its corners, the middles of its edges and its center
+     */
+    const NodeError &GetNodeError(const BSplineSurface &surface, uint8_t level, uint32_t x, uint32_t y);
+
+    /**
+     * @brief The index in the mesh of a point of the lattice, its vertex is added to the mesh at the first request
+     */
+    uint32_t GetMeshIndex(const BSplineSurface &surface, uint32_t x, uint32_t y);
+
+    /**
+     * @brief Triangulate the leaves
+     */
+    void Build(const BSplineSurface &surface);
+
+    static inline uint64_t PointKey(uint32_t x, uint32_t y) { return ((uint64_t)x << 32) | y; }
+    static inline uint64_t NodeKey(uint8_t level, uint32_t x, uint32_t y) { return ((uint64_t)level << 58) | ((uint64_t)x << 29) | y; }
+
+private:
+    // the distinct knots bounding the non-empty spans along u and v, span k is [knots[k], knots[k + 1]]
+    std::vector<float> m_SpanKnotsU;
+    std::vector<float> m_SpanKnotsV;
+
+    std::unordered_map<uint64_t, SurfaceVertex> m_LatticeVertices; // by point key
+    std::unordered_map<uint64_t, NodeError> m_NodeErrors;          // by node key
+
+    // node keys of the leaves of the current and of the previous refinement, in the order of the traversal
+    std::vector<uint64_t> m_Leaves;
+    std::vector<uint64_t> m_PreviousLeaves;
+
+    // reused by Build: the corners of the leaves, the index of each point in the mesh and the boundary of a leaf
+    std::unordered_set<uint64_t> m_Corners;
+    std::unordered_map<uint64_t, uint32_t> m_MeshIndices;
+    std::vector<uint32_t> m_Boundary;
+
+    std::vector<SurfaceVertex> m_Vertices;
+    std::vector<uint32_t> m_Indices;
+
+    SurfaceRefinementCriterion m_Criterion = SurfaceRefinementCriterion::ScreenSpaceError;
+    float m_Tolerance = 1.0f;
+    uint8_t m_MinDepth = 1;
+    uint8_t m_MaxDepth = 6;
+
+    // what the caches were built from
+    const BSplineSurface *m_Surface = nullptr;
+    uint64_t m_SurfaceVersion = 0;
+    bool m_Dirty = true;
+
+    uint64_t m_Version = 0;
+};
@@ -1,17 +1,132 @@
 #include "BSplineSurface.h"
+#include "Core/JobSystem.h"
+
+#include <algorithm>
+
+// samples of a tile along u and v, the rows read by a tile ((its spans + degree) rows of TileSamplesV points) stay in cache
+static constexpr int TileSamplesU = 32;
+static constexpr int TileSamplesV = 64;
+
+// average number of samples given to each job of the pool
+static constexpr uint32_t SamplesPerJob = 4096;
+
+/**
+ * @brief Split a region of a grid in tiles and run function(firstRow, endRow, firstColumn, endColumn) on each tile in parallel
+ * @note The tiles are disjoint, the function can write its region of an output without lock
+ * @param firstRow The first row of the region
+ * @param endRow The row after the last one of the region
+ * @param firstColumn The first column of the region
+ * @param endColumn The column after the last one of the region
+ * @param function Called with the [first, end) rows and columns of a tile
+ */
+static void ParallelForTiles(int firstRow, int endRow, int firstColumn, int endColumn, const std::function<void(int, int, int, int)> &function)
+{
+    if (firstRow >= endRow || firstColumn >= endColumn)
+        return;
+
+    int tilesU = (endRow - firstRow + TileSamplesU - 1) / TileSamplesU;
+    int tilesV = (endColumn - firstColumn + TileSamplesV - 1) / TileSamplesV;
+    uint32_t tilesPerJob = std::max<uint32_t>(SamplesPerJob / (TileSamplesU * TileSamplesV), 1);
+
+    SmartGL::Core::JobSystem::ParallelFor(tilesU * tilesV, tilesPerJob, [&](uint32_t begin, uint32_t end)
+                                          {
+                                              for (uint32_t tile = begin; tile < end; tile++)
+                                              {
+                                                  int row = firstRow + (tile / tilesV) * TileSamplesU;
+                                                  int column = firstColumn + (tile % tilesV) * TileSamplesV;
+                                                  function(row, std::min(row + TileSamplesU, endRow),
+                                                           column, std::min(column + TileSamplesV, endColumn));
+                                              }
+                                          });
+}
+
+/**
+ * @brief The frenet frame of an iso-parametric curve from its first and second derivatives
+ */
+static CurveFrenetFrameComponents ComputeIsoCurveFrame(const glm::vec3 &velocity, const glm::vec3 &acceleration)
+{
+    glm::vec3 tangent = glm::normalize(velocity);
+    glm::vec3 normal = glm::normalize(glm::cross(velocity, glm::cross(acceleration, velocity)));
+    glm::vec3 binormal = glm::cross(tangent, normal);
+
+    return CurveFrenetFrameComponents{tangent, normal, binormal};
+}
 
 BSplineSurface::BSplineSurface(BSplineSurfaceAttributes attributes)
     : m_Attributes(attributes)
 {
+    UpdateSpanLookups();
 }
 
 BSplineSurface::~BSplineSurface()
 {
     m_ControlPoints.clear();
+    m_Weights.clear();
     m_Attributes.U.Knots.clear();
     m_Attributes.V.Knots.clear();
-    m_Points.clear();
-    m_Curvatures.clear();
+    m_CurvaturesComponents.clear();
+}
+
+void SurfaceBasisTable::Build(const std::vector<float> &knots, uint8_t degree, int nbSamples, const BSplineBasis::KnotSpanLookup &spanLookup)
+{
+    int order = degree + 1;
+    Parameters.resize(nbSamples);
+    Spans.resize(nbSamples);
+    Basis.resize(nbSamples * order);
+    FirstDerivatives.resize(nbSamples * order);
+    SecondDerivatives.resize(nbSamples * order);
+
+    int nbControlPoints = knots.size() - order;
+    float start = knots[degree];
+    float delta = knots[nbControlPoints] - start;
+
+    // the parameters increase, the span of each one is found by stepping from the previous one
+    BSplineBasis::KnotSpanWalker walker(spanLookup);
+    float derivatives[BSplineBasis::MaxDerivative + 1][BSplineBasis::MaxDegree + 1];
+    for (int i = 0; i < nbSamples; i++)
+    {
+        Parameters[i] = start + ((float)i * delta) / (float)nbSamples;
+        Spans[i] = walker.Find(Parameters[i]);
+        BSplineBasis::ComputeBasisFunctionsDerivatives(knots, Spans[i], degree, Parameters[i], 2, derivatives);
+
+        std::copy(derivatives[0], derivatives[0] + order, Basis.begin() + i * order);
+        std::copy(derivatives[1], derivatives[1] + order, FirstDerivatives.begin() + i * order);
+        std::copy(derivatives[2], derivatives[2] + order, SecondDerivatives.begin() + i * order);
+    }
+}
+
+void SurfaceBasisTable::FindSamples(int firstControlPoint, int lastControlPoint, uint8_t degree, int &firstSample, int &endSample) const
+{
+    // the spans of the samples increase
+    firstSample = std::lower_bound(Spans.begin(), Spans.end(), firstControlPoint) - Spans.begin();
+    endSample = std::upper_bound(Spans.begin(), Spans.end(), lastControlPoint + degree) - Spans.begin();
+}
+
+bool BSplineSurface::FindDirtySamples(const SurfaceDirtyRegion &region, int &firstRow, int &endRow, int &firstSampleU, int &endSampleU,
+                                      int &firstSampleV, int &endSampleV) const
+{
+    int nbPointsU = m_BasisTableU.Size();
+    int nbPointsV = m_BasisTableV.Size();
+
+    // a grid of another size is evaluated again entirely
+    if (region.Full || m_Grid.GetRowsCount() != (uint32_t)nbPointsU || m_Grid.GetColumnsCount() != (uint32_t)nbPointsV)
+    {
+        firstRow = firstSampleU = firstSampleV = 0;
+        endRow = m_ControlPoints.size();
+        endSampleU = nbPointsU;
+        endSampleV = nbPointsV;
+        return true;
+    }
+
+    if (region.IsEmpty())
+        return false;
+
+    // the rows along v only change for the modified control rows, the points for all the spans these rows influence
+    firstRow = region.FirstRow;
+    endRow = region.LastRow + 1;
+    m_BasisTableU.FindSamples(region.FirstRow, region.LastRow, m_Attributes.U.Degree, firstSampleU, endSampleU);
+    m_BasisTableV.FindSamples(region.FirstColumn, region.LastColumn, m_Attributes.V.Degree, firstSampleV, endSampleV);
+    return true;
 }
 
 void BSplineSurface::Evaluate()
@@ -23,30 +138,72 @@ void BSplineSurface::Evaluate()
 
     uint8_t degreeU = m_Attributes.U.Degree;
     uint8_t degreeV = m_Attributes.V.Degree;
-    auto knotsU = m_Attributes.U.Knots;
-    auto knotsV = m_Attributes.V.Knots;
 
-    m_Points.clear();
-    m_Points.resize(nbPointsU, std::vector<glm::vec3>(nbPointsV, glm::vec3(0.0f)));
-
-    float deltaU = knotsU[nbControlPointsU] - knotsU[degreeU];
-    float deltaV = knotsV[nbControlPointsV] - knotsV[degreeV];
+    UpdateBasisTables();
+
+    int firstRow, endRow, firstSampleU, endSampleU, firstSampleV, endSampleV;
+    if (!FindDirtySamples(m_DirtyPoints, firstRow, endRow, firstSampleU, endSampleU, firstSampleV, endSampleV))
+        return;
+
+    // every control row evaluated at the v samples, (degreeV + 1) control points per value
+    m_RowsAlongV.resize(nbControlPointsU * nbPointsV);
+    ParallelForTiles(firstRow, endRow, firstSampleV, endSampleV, [&](int firstRow, int endRow, int firstSample, int endSample)
+                     {
+                         for (int i = firstRow; i < endRow; i++)
+                         {
+                             const glm::vec4 *row = m_HomogeneousControlPoints.data() + i * nbControlPointsV;
+                             glm::vec4 *rowAlongV = m_RowsAlongV.data() + i * nbPointsV;
+
+                             for (int sampleV = firstSample; sampleV < endSample; sampleV++)
+                             {
+                                 const float *basisV = m_BasisTableV.Basis.data() + sampleV * (degreeV + 1);
+                                 const glm::vec4 *controlPoints = row + m_BasisTableV.Spans[sampleV] - degreeV;
+
+                                 glm::vec4 point(0.0f);
+                                 for (int j = 0; j <= degreeV; j++)
+                                     point += basisV[j] * controlPoints[j];
+                                 rowAlongV[sampleV] = point;
+                             }
+                         }
+                     });
+
+    // then these rows at the u samples, (degreeU + 1) rows per point
+    m_Grid.Resize(nbPointsU, nbPointsV);
+    ParallelForTiles(firstSampleU, endSampleU, firstSampleV, endSampleV, [&](int firstSampleU, int endSampleU, int firstSampleV, int endSampleV)
+                     {
+                         for (int sampleU = firstSampleU; sampleU < endSampleU; sampleU++)
+                         {
+                             const float *basisU = m_BasisTableU.Basis.data() + sampleU * (degreeU + 1);
+                             const glm::vec4 *rows = m_RowsAlongV.data() + (m_BasisTableU.Spans[sampleU] - degreeU) * nbPointsV;
+
+                             SurfaceGridView<SurfaceVertex> vertices = m_Grid.Row(sampleU);
+                             for (int sampleV = firstSampleV; sampleV < endSampleV; sampleV++)
+                             {
+                                 glm::vec4 point(0.0f);
+                                 for (int i = 0; i <= degreeU; i++)
+                                     point += basisU[i] * rows[i * nbPointsV + sampleV];
+                                 vertices[sampleV].Position = glm::vec3(point) / point.w;
+                             }
+                         }
+                     });
+
+    // a resized grid is already entirely modified
+    m_Grid.MarkModified(firstSampleU, endSampleU);
+    m_DirtyPoints.Clear();
+}
 
-    for (int tDeltaU = 0; tDeltaU < nbPointsU; tDeltaU++) // precision
-        for (int u = 0; u < nbControlPointsU; u++)
-        {
-            float tU = knotsU[degreeU] + ((float)tDeltaU * deltaU) / (float)nbPointsU;
+void BSplineSurface::UpdateBasisTables()
+{
+    std::size_t nbPointsU = m_ControlPoints.size() * m_Precision;
+    std::size_t nbPointsV = m_ControlPoints[0].size() * m_Precision;
 
-            for (int tDeltaV = 0; tDeltaV < nbPointsV; tDeltaV++) // precision
-                for (int v = 0; v < nbControlPointsV; v++)
-                {
-                    float tV = knotsV[degreeV] + ((float)tDeltaV * deltaV) / (float)nbPointsV;
+    // the tables also follow the size of the net, which gives the number of samples
+    if (m_BasisTablesValid && m_BasisTableU.Size() == nbPointsU && m_BasisTableV.Size() == nbPointsV)
+        return;
 
-                    float weight_u = ComputeWeight(knotsU, u, degreeU, tU);
-                    float weight_v = ComputeWeight(knotsV, v, degreeV, tV);
-                    m_Points[tDeltaU][tDeltaV] += weight_u * weight_v * m_ControlPoints[u][v];
-                }
-        }
+    m_BasisTableU.Build(m_Attributes.U.Knots, m_Attributes.U.Degree, nbPointsU, m_SpanLookupU);
+    m_BasisTableV.Build(m_Attributes.V.Knots, m_Attributes.V.Degree, nbPointsV, m_SpanLookupV);
+    m_BasisTablesValid = true;
 }
 
 void BSplineSurface::EvaluateCurvatures()
@@ -58,148 +215,274 @@ void BSplineSurface::EvaluateCurvatures()
 
     uint8_t degreeU = m_Attributes.U.Degree;
     uint8_t degreeV = m_Attributes.V.Degree;
-    auto knotsU = m_Attributes.U.Knots;
-    auto knotsV = m_Attributes.V.Knots;
 
-    float deltaU = knotsU[nbControlPointsU] - knotsU[degreeU];
-    float deltaV = knotsV[nbControlPointsV] - knotsV[degreeV];
-
-    m_Curvatures.clear();
-    m_Curvatures.resize(m_Points.size(), std::vector<float>(m_Points[0].size(), 0.0f));
+    UpdateBasisTables();
+
+    int firstRow, endRow, firstSampleU, endSampleU, firstSampleV, endSampleV;
+    if (!FindDirtySamples(m_DirtyCurvatures, firstRow, endRow, firstSampleU, endSampleU, firstSampleV, endSampleV))
+        return;
+
+    // every control row and its derivatives along v at the v samples
+    m_RowsAlongV.resize(nbControlPointsU * nbPointsV);
+    m_RowsAlongVDerivatives.resize(nbControlPointsU * nbPointsV);
+    m_RowsAlongVSecondDerivatives.resize(nbControlPointsU * nbPointsV);
+    ParallelForTiles(firstRow, endRow, firstSampleV, endSampleV, [&](int firstRow, int endRow, int firstSample, int endSample)
+                     {
+                         for (int i = firstRow; i < endRow; i++)
+                         {
+                             const glm::vec4 *row = m_HomogeneousControlPoints.data() + i * nbControlPointsV;
+
+                             for (int sampleV = firstSample; sampleV < endSample; sampleV++)
+                             {
+                                 int first = sampleV * (degreeV + 1);
+                                 const glm::vec4 *controlPoints = row + m_BasisTableV.Spans[sampleV] - degreeV;
+
+                                 glm::vec4 point(0.0f), derivative(0.0f), secondDerivative(0.0f);
+                                 for (int j = 0; j <= degreeV; j++)
+                                 {
+                                     point += m_BasisTableV.Basis[first + j] * controlPoints[j];
+                                     derivative += m_BasisTableV.FirstDerivatives[first + j] * controlPoints[j];
+                                     secondDerivative += m_BasisTableV.SecondDerivatives[first + j] * controlPoints[j];
+                                 }
+
+                                 m_RowsAlongV[i * nbPointsV + sampleV] = point;
+                                 m_RowsAlongVDerivatives[i * nbPointsV + sampleV] = derivative;
+                                 m_RowsAlongVSecondDerivatives[i * nbPointsV + sampleV] = secondDerivative;
+                             }
+                         }
+                     });
+
+    // then the homogeneous point and its five partial derivatives at each sample, projected with the quotient rule
+    m_Grid.Resize(nbPointsU, nbPointsV);
+    m_CurvaturesComponents.resize(nbPointsU * nbPointsV);
+    ParallelForTiles(firstSampleU, endSampleU, firstSampleV, endSampleV, [&](int firstSampleU, int endSampleU, int firstSampleV, int endSampleV)
+                     {
+                         for (int sampleU = firstSampleU; sampleU < endSampleU; sampleU++)
+                         {
+                             int first = sampleU * (degreeU + 1);
+                             int offset = (m_BasisTableU.Spans[sampleU] - degreeU) * nbPointsV;
+
+                             for (int sampleV = firstSampleV; sampleV < endSampleV; sampleV++)
+                             {
+                                 // A, Au, Av, Auu, Auv, Avv
+                                 glm::vec4 homogeneous[6] = {glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f)};
+                                 for (int i = 0; i <= degreeU; i++)
+                                 {
+                                     int index = offset + i * nbPointsV + sampleV;
+                                     float basis = m_BasisTableU.Basis[first + i];
+                                     float derivative = m_BasisTableU.FirstDerivatives[first + i];
+
+                                     homogeneous[0] += basis * m_RowsAlongV[index];
+                                     homogeneous[1] += derivative * m_RowsAlongV[index];
+                                     homogeneous[2] += basis * m_RowsAlongVDerivatives[index];
+                                     homogeneous[3] += m_BasisTableU.SecondDerivatives[first + i] * m_RowsAlongV[index];
+                                     homogeneous[4] += derivative * m_RowsAlongVDerivatives[index];
+                                     homogeneous[5] += basis * m_RowsAlongVSecondDerivatives[index];
+                                 }
+
+                                 SurfaceCurvaturesComponents curvatures = ComputeCurvatures(ProjectDerivatives(homogeneous));
+                                 m_CurvaturesComponents[sampleU * nbPointsV + sampleV] = curvatures;
+                                 m_Grid.At(sampleU, sampleV).Curvature = curvatures.GaussianCurvature;
+                             }
+                         }
+                     });
+
+    // a resized grid is already entirely modified
+    m_Grid.MarkModified(firstSampleU, endSampleU);
+    m_DirtyCurvatures.Clear();
+}
 
-     for (int tDeltaU = 0; tDeltaU < nbPointsU; tDeltaU++) // precision
-        for (int u = 0; u < nbControlPointsU; u++)
-        {
-            float tU = knotsU[degreeU] + ((float)tDeltaU * deltaU) / (float)nbPointsU;
+glm::vec3 BSplineSurface::EvaluateAt(float u, float v) const
+{
+    uint8_t degreeU = m_Attributes.U.Degree;
+    uint8_t degreeV = m_Attributes.V.Degree;
 
-            for (int tDeltaV = 0; tDeltaV < nbPointsV; tDeltaV++) // precision
-                for (int v = 0; v < nbControlPointsV; v++)
-                {
-                    float tV = knotsV[degreeV] + ((float)tDeltaV * deltaV) / (float)nbPointsV;
+    // only the basis functions of the spans containing u and v are non-zero
+    float basisU[BSplineBasis::MaxDegree + 1];
+    float basisV[BSplineBasis::MaxDegree + 1];
+    int spanU = m_SpanLookupU.Find(u);
+    int spanV = m_SpanLookupV.Find(v);
+    BSplineBasis::ComputeBasisFunctions(m_Attributes.U.Knots, spanU, degreeU, u, basisU);
+    BSplineBasis::ComputeBasisFunctions(m_Attributes.V.Knots, spanV, degreeV, v, basisV);
 
-                    m_Curvatures[tDeltaU][tDeltaV] = GetCurvaturesAt(tU, tV).GaussianCurvature;
-                }
-        }
+    glm::vec4 point = EvaluateHomogeneous(spanU, basisU, spanV, basisV);
+    return glm::vec3(point) / point.w;
 }
 
-glm::vec3 BSplineSurface::EvaluateAt(float u, float v) const
+glm::vec4 BSplineSurface::EvaluateHomogeneous(int spanU, const float *basisU, int spanV, const float *basisV) const
 {
-    glm::vec3 point(0.0f);
-
-    int nbControlPointsU = m_ControlPoints.size();
-    int nbControlPointsV = m_ControlPoints[0].size();
     uint8_t degreeU = m_Attributes.U.Degree;
     uint8_t degreeV = m_Attributes.V.Degree;
 
-    for (int i = 0; i < nbControlPointsU; i++)
+    int nbControlPointsV = m_ControlPoints[0].size();
+
+    // sum of the homogeneous control points (w * P, w) weighted by the basis functions
+    glm::vec4 point(0.0f);
+    for (int i = 0; i <= degreeU; i++)
     {
-        float weightU = ComputeWeight(m_Attributes.U.Knots, i, degreeU, u);
+        const glm::vec4 *row = m_HomogeneousControlPoints.data() + (spanU - degreeU + i) * nbControlPointsV + spanV - degreeV;
 
-        for (int j = 0; j < nbControlPointsV; j++)
-        {
-            float weightV = ComputeWeight(m_Attributes.V.Knots, j, degreeV, v);
-            point += weightU * weightV * m_ControlPoints[i][j];
-        }
+        glm::vec4 rowPoint(0.0f);
+        for (int j = 0; j <= degreeV; j++)
+            rowPoint += basisV[j] * row[j];
+        point += basisU[i] * rowPoint;
     }
 
     return point;
 }
 
-float BSplineSurface::ComputeWeight(const std::vector<float> &knots, int index, uint8_t degree, float t) const
+void BSplineSurface::SetControlPoints(const std::vector<std::vector<glm::vec3>> &controlPoints)
 {
-    // get the knots of the current segment
-    float currentKnot = knots[index];
-    float nextKnot = knots[index + 1];
-
-    // if the degree is 0, the weight is 1 if t is between the current knot and the next knot, 0 otherwise
-    // that's the stopping condition of the recursive function
-    if (degree == 0)
-        return (t >= currentKnot && t < nextKnot) ? 1.0f : 0.0f;
-
-    float weight = 0.0f;
+    bool sameSize = m_Weights.size() == controlPoints.size();
+    for (std::size_t i = 0; sameSize && i < controlPoints.size(); i++)
+        sameSize = m_Weights[i].size() == controlPoints[i].size();
 
-    // the Box-Cox formula
-
-    float denominator = knots[index + degree] - currentKnot;
+    m_ControlPoints = controlPoints;
+    if (!sameSize)
+    {
+        m_Weights.clear();
+        for (const std::vector<glm::vec3> &row : controlPoints)
+            m_Weights.push_back(std::vector<float>(row.size(), 1.0f));
+    }
 
-    // current knot
-    if (denominator != 0.0f)
-        weight = (t - currentKnot) / denominator * ComputeWeight(knots, index, degree - 1, t);
+    UpdateHomogeneousControlPoints();
+}
 
-    denominator = knots[index + degree + 1] - nextKnot;
+void BSplineSurface::SetControlPoints(const std::vector<std::vector<glm::vec3>> &controlPoints, const std::vector<std::vector<float>> &weights)
+{
+    m_ControlPoints = controlPoints;
+    m_Weights = weights;
+    UpdateHomogeneousControlPoints();
+}
 
-    // next knot
-    if (denominator != 0.0f)
-        weight += (knots[index + degree + 1] - t) / denominator * ComputeWeight(knots, index + 1, degree - 1, t);
+void BSplineSurface::SetControlPoint(int i, int j, const glm::vec3 &position)
+{
+    float weight = m_Weights[i][j];
+    m_ControlPoints[i][j] = position;
+    m_HomogeneousControlPoints[i * m_ControlPoints[i].size() + j] = glm::vec4(weight * position, weight);
 
-    return weight;
+    m_DirtyPoints.Expand(i, j);
+    m_DirtyCurvatures.Expand(i, j);
+    m_Version++;
 }
 
-SurfaceFrenetFrameComponents BSplineSurface::GetFrenetFrameAt(float u, float v)
+void BSplineSurface::UpdateHomogeneousControlPoints()
 {
-    SurfaceFrenetFrameComponents surfaceFrenetFrame;
-    CurveFrenetFrameComponents frentFrameU;
-    CurveFrenetFrameComponents frenetFrameV;
-
-    SurfaceDerivativesComponenets derivatives = GetFiniteDifferencesPartialDerivatives(u, v);
+    InvalidateSamples();
+    m_Version++;
 
-    auto velocityU = derivatives.U.Velocity;
-    auto velocityV = derivatives.V.Velocity;
-    auto accelerationU = derivatives.U.Acceleration;
-    auto accelerationV = derivatives.V.Acceleration;
+    m_HomogeneousControlPoints.clear();
+    for (std::size_t i = 0; i < m_ControlPoints.size(); i++)
+        for (std::size_t j = 0; j < m_ControlPoints[i].size(); j++)
+            m_HomogeneousControlPoints.push_back(glm::vec4(m_Weights[i][j] * m_ControlPoints[i][j], m_Weights[i][j]));
+}
 
-    frentFrameU.Tangent = glm::normalize(velocityU);
-    frenetFrameV.Tangent = glm::normalize(velocityV);
+SurfacePointDerivatives BSplineSurface::EvaluateDerivativesAt(float u, float v) const
+{
+    uint8_t degreeU = m_Attributes.U.Degree;
+    uint8_t degreeV = m_Attributes.V.Degree;
+    int nbControlPointsV = m_ControlPoints[0].size();
 
-    frentFrameU.Normal = glm::normalize(glm::cross(velocityU, glm::cross(accelerationU, velocityU)));
-    frenetFrameV.Normal = glm::normalize(glm::cross(velocityV, glm::cross(accelerationV, velocityV)));
+    // the basis functions and their derivatives share the same span and the same triangular table
+    float derivativesU[BSplineBasis::MaxDerivative + 1][BSplineBasis::MaxDegree + 1];
+    float derivativesV[BSplineBasis::MaxDerivative + 1][BSplineBasis::MaxDegree + 1];
+    int spanU = m_SpanLookupU.Find(u);
+    int spanV = m_SpanLookupV.Find(v);
+    BSplineBasis::ComputeBasisFunctionsDerivatives(m_Attributes.U.Knots, spanU, degreeU, u, 2, derivativesU);
+    BSplineBasis::ComputeBasisFunctionsDerivatives(m_Attributes.V.Knots, spanV, degreeV, v, 2, derivativesV);
+
+    // A, Au, Av, Auu, Auv, Avv of the homogeneous surface, each row is first contracted along v
+    glm::vec4 homogeneous[6] = {glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f)};
+    for (int i = 0; i <= degreeU; i++)
+    {
+        const glm::vec4 *row = m_HomogeneousControlPoints.data() + (spanU - degreeU + i) * nbControlPointsV + spanV - degreeV;
 
-    frentFrameU.Binormal = glm::cross(frentFrameU.Tangent, frentFrameU.Normal);
-    frenetFrameV.Binormal = glm::cross(frenetFrameV.Tangent, frenetFrameV.Normal);
+        glm::vec4 point(0.0f), derivative(0.0f), secondDerivative(0.0f);
+        for (int j = 0; j <= degreeV; j++)
+        {
+            point += derivativesV[0][j] * row[j];
+            derivative += derivativesV[1][j] * row[j];
+            secondDerivative += derivativesV[2][j] * row[j];
+        }
 
-    surfaceFrenetFrame.U = frentFrameU;
-    surfaceFrenetFrame.V = frenetFrameV;
+        homogeneous[0] += derivativesU[0][i] * point;
+        homogeneous[1] += derivativesU[1][i] * point;
+        homogeneous[2] += derivativesU[0][i] * derivative;
+        homogeneous[3] += derivativesU[2][i] * point;
+        homogeneous[4] += derivativesU[1][i] * derivative;
+        homogeneous[5] += derivativesU[0][i] * secondDerivative;
+    }
 
-    return surfaceFrenetFrame;
+    return ProjectDerivatives(homogeneous);
 }
 
-SurfaceCurvaturesComponents BSplineSurface::GetCurvaturesAt(float u, float v)
+SurfacePointDerivatives BSplineSurface::ProjectDerivatives(const glm::vec4 homogeneous[6])
 {
-    SurfaceCurvaturesComponents curvatures;
-
-    SurfaceFrenetFrameComponents frenetFrame = GetFrenetFrameAt(u, v);
-    SurfaceDerivativesComponenets partialDerivatives = GetFiniteDifferencesPartialDerivatives(u, v);
-    CurveDerivativesComponenets derivatives = GetFiniteDifferencesDerivatives(u, v);
+    // quotient rule: w * S = A, so w * Su = Au - wu * S, w * Suu = Auu - 2 * wu * Su - wuu * S
+    // and w * Suv = Auv - wu * Sv - wv * Su - wuv * S
+    SurfacePointDerivatives point;
+    float weight = homogeneous[0].w;
+    point.Position = glm::vec3(homogeneous[0]) / weight;
+    point.DerivativeU = (glm::vec3(homogeneous[1]) - homogeneous[1].w * point.Position) / weight;
+    point.DerivativeV = (glm::vec3(homogeneous[2]) - homogeneous[2].w * point.Position) / weight;
+    point.DerivativeUU = (glm::vec3(homogeneous[3]) - 2.0f * homogeneous[1].w * point.DerivativeU - homogeneous[3].w * point.Position) / weight;
+    point.DerivativeUV = (glm::vec3(homogeneous[4]) - homogeneous[1].w * point.DerivativeV - homogeneous[2].w * point.DerivativeU - homogeneous[4].w * point.Position) / weight;
+    point.DerivativeVV = (glm::vec3(homogeneous[5]) - 2.0f * homogeneous[2].w * point.DerivativeV - homogeneous[5].w * point.Position) / weight;
 
-    auto tangentU = frenetFrame.U.Tangent;
-    auto tangentV = frenetFrame.V.Tangent;
-
-    glm::vec3 tangentPlaneNormal = glm::normalize(glm::cross(tangentU, tangentV));
+    return point;
+}
 
-    auto velocityU = glm::normalize(partialDerivatives.U.Velocity);
-    auto velocityV = glm::normalize(partialDerivatives.V.Velocity);
-    auto accelerationU = glm::normalize(partialDerivatives.U.Acceleration);
-    auto accelerationV = glm::normalize(partialDerivatives.V.Acceleration);
+SurfaceFrenetFrameComponents BSplineSurface::ComputeFrenetFrame(const SurfacePointDerivatives &derivatives)
+{
+    // the frames of the iso-parametric curves through the point
+    SurfaceFrenetFrameComponents surfaceFrenetFrame;
+    surfaceFrenetFrame.U = ComputeIsoCurveFrame(derivatives.DerivativeU, derivatives.DerivativeUU);
+    surfaceFrenetFrame.V = ComputeIsoCurveFrame(derivatives.DerivativeV, derivatives.DerivativeVV);
 
-    float E = glm::dot(velocityU, velocityU);
-    float F = glm::dot(velocityU, velocityV);
-    float G = glm::dot(velocityV, velocityV);
+    return surfaceFrenetFrame;
+}
 
-    glm::vec3 nextPoint = EvaluateAt(u + 1e-2f, v + 1e-2f);
-    glm::vec3 nextUPoint = EvaluateAt(u, v + 1e-2f);
+SurfaceCurvaturesComponents BSplineSurface::ComputeCurvatures(const SurfacePointDerivatives &derivatives)
+{
+    SurfaceCurvaturesComponents curvatures = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+
+    glm::vec3 normal = glm::cross(derivatives.DerivativeU, derivatives.DerivativeV);
+    float normalLength = glm::length(normal);
+    if (!(normalLength > 0.0f))
+        return curvatures;
+    normal /= normalLength;
+
+    // first fundamental form, its determinant is the squared length of Su x Sv
+    float E = glm::dot(derivatives.DerivativeU, derivatives.DerivativeU);
+    float F = glm::dot(derivatives.DerivativeU, derivatives.DerivativeV);
+    float G = glm::dot(derivatives.DerivativeV, derivatives.DerivativeV);
+    float determinant = normalLength * normalLength;
+
+    // second fundamental form
+    float L = glm::dot(derivatives.DerivativeUU, normal);
+    float M = glm::dot(derivatives.DerivativeUV, normal);
+    float N = glm::dot(derivatives.DerivativeVV, normal);
+
+    curvatures.GaussianCurvature = (L * N - M * M) / determinant;
+    curvatures.MeanCurvature = (E * N + G * L - 2.0f * F * M) / (2.0f * determinant);
+    curvatures.AbsoluteCurvature = (4 * curvatures.MeanCurvature * curvatures.MeanCurvature) - (2 * curvatures.GaussianCurvature);
 
-    glm::vec3 dU = (nextPoint - nextUPoint) / 1e-2f;
-    glm::vec3 f = glm::normalize((dU - velocityU) / 1e-2f);
+    // the principal curvatures are the roots of k^2 - 2 * H * k + K
+    float discriminant = glm::sqrt(glm::max(curvatures.MeanCurvature * curvatures.MeanCurvature - curvatures.GaussianCurvature, 0.0f));
+    curvatures.MaxPrincipalCurvature = curvatures.MeanCurvature + discriminant;
+    curvatures.MinPrincipalCurvature = curvatures.MeanCurvature - discriminant;
 
-    float L = glm::dot(accelerationU, tangentPlaneNormal);
-    float M = glm::dot(f, tangentPlaneNormal);
-    float N = glm::dot(accelerationV, tangentPlaneNormal);
+    return curvatures;
+}
 
-    curvatures.GaussianCurvature = (L * N - M * M) / (E * G - F * F);
-    curvatures.MeanCurvature = (E * N + G * L - 2.0f * F * M) / (2.0f * (E * G - F * F));
-    curvatures.AbsoluteCurvature = (4 * curvatures.MeanCurvature * curvatures.MeanCurvature) - (2 * curvatures.GaussianCurvature);
+SurfaceFrenetFrameComponents BSplineSurface::GetFrenetFrameAt(float u, float v) const
+{
+    return ComputeFrenetFrame(EvaluateDerivativesAt(u, v));
+}
 
-    return curvatures;
+SurfaceCurvaturesComponents BSplineSurface::GetCurvaturesAt(float u, float v) const
+{
+    return ComputeCurvatures(EvaluateDerivativesAt(u, v));
 }
 
 void BSplineSurface::InitKnotVector()
@@ -219,8 +502,35 @@ void BSplineSurface::InitKnotVector()
     m_Attributes.U.Knots.resize(numKnotsU);
     m_Attributes.V.Knots.resize(numKnotsV);
 
-    auto setKnots = [this](int numKnots, int degree, int nbControlPoints, auto &knots)
+    // parameters of the rows (along u) and of the columns (along v) of the net, averaged
+    auto averageParameters = [this](int nbRows, int nbPoints, bool alongU)
     {
+        float exponent = m_Type == BSplineType::ChordLength ? 1.0f : 0.5f;
+        std::vector<float> parameters(nbPoints, 0.0f);
+        std::vector<glm::vec3> row(nbPoints);
+        std::vector<float> rowParameters;
+
+        for (int r = 0; r < nbRows; r++)
+        {
+            for (int i = 0; i < nbPoints; i++)
+                row[i] = alongU ? m_ControlPoints[i][r] : m_ControlPoints[r][i];
+
+            BSplineBasis::ComputeChordParameters(row, exponent, rowParameters);
+            for (int i = 0; i < nbPoints; i++)
+                parameters[i] += rowParameters[i] / nbRows;
+        }
+        return parameters;
+    };
+
+    auto setKnots = [this, &averageParameters](int numKnots, int degree, int nbControlPoints, int nbRows, bool alongU, auto &knots)
+    {
+        if (m_Type == BSplineType::ChordLength || m_Type == BSplineType::Centripetal)
+        {
+            float end = static_cast<float>(std::max(nbControlPoints - degree, 1));
+            BSplineBasis::ComputeAveragedKnots(averageParameters(nbRows, nbControlPoints, alongU), degree, end, knots);
+            return;
+        }
+
         for (int i = 0; i < numKnots; i++)
         {
             switch (m_Type)
@@ -246,51 +556,8 @@ void BSplineSurface::InitKnotVector()
         }
     };
 
-    setKnots(numKnotsU, m_Attributes.U.Degree, nbControlPointsU, m_Attributes.U.Knots);
-    setKnots(numKnotsV, m_Attributes.V.Degree, nbControlPointsV, m_Attributes.V.Knots);
-}
-
-SurfaceDerivativesComponenets BSplineSurface::GetFiniteDifferencesPartialDerivatives(float u, float v) const
-{
-    float epsilon = 1e-2f;
-
-    glm::vec3 currentPoint = EvaluateAt(u, v);
-
-    glm::vec3 nextU = EvaluateAt(u + epsilon, v);
-    glm::vec3 nextV = EvaluateAt(u, v + epsilon);
-    glm::vec3 prevU = EvaluateAt(u - epsilon, v);
-    glm::vec3 prevV = EvaluateAt(u, v - epsilon);
-
-    glm::vec3 velocityU = (nextU - prevU) / (2.0f * epsilon);
-    glm::vec3 velocityV = (nextV - prevV) / (2.0f * epsilon);
-
-    glm::vec3 nextNextU = EvaluateAt(u + 2.0f * epsilon, v);
-    glm::vec3 nextNextV = EvaluateAt(u, v + 2.0f * epsilon);
-
-    // glm::vec3 accelerationU = (nextU - 2.0f * currentPoint + prevU) / (epsilon * epsilon);
-    // glm::vec3 accelerationV = (nextV - 2.0f * currentPoint + prevV) / (epsilon * epsilon);
-
-    glm::vec3 accelerationU = (nextNextU - (2.0f * nextU) + currentPoint) / (epsilon * epsilon);
-    glm::vec3 accelerationV = (nextNextV - (2.0f * nextV) + currentPoint) / (epsilon * epsilon);
-
-    return {
-        CurveDerivativesComponenets{velocityU, accelerationU},
-        CurveDerivativesComponenets{velocityV, accelerationV}
-    };
-}
-
-CurveDerivativesComponenets BSplineSurface::GetFiniteDifferencesDerivatives(float u, float v) const
-{
-    float epsilon = 1e-2f;
-
-    glm::vec3 currentPoint = EvaluateAt(u, v);
-
-    glm::vec3 next = EvaluateAt(u + epsilon, v + epsilon);
-    glm::vec3 prev = EvaluateAt(u - epsilon, v - epsilon);
-
-    glm::vec3 velocity = (next - prev) / (2.0f * epsilon);
-
-    glm::vec3 acceleration = (next - 2.0f * currentPoint + prev) / (epsilon * epsilon);
+    setKnots(numKnotsU, m_Attributes.U.Degree, nbControlPointsU, nbControlPointsV, true, m_Attributes.U.Knots);
+    setKnots(numKnotsV, m_Attributes.V.Degree, nbControlPointsV, nbControlPointsU, false, m_Attributes.V.Knots);
 
-    return CurveDerivativesComponenets{velocity, acceleration};
+    UpdateSpanLookups();
 }
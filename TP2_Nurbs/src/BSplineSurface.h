@@ -2,6 +2,7 @@
 
 #include "SmartGL.h"
 #include "BSplineCurve.h"
+#include "SurfaceGrid.h"
 
 /**
  * @brief Data used to store the attributes of the BSpline surface
@@ -25,12 +26,16 @@ struct SurfaceFrenetFrameComponents
 };
 
 /**
- * @brief Data used to store the components of the surface derivatives
+ * @brief A point of the surface with its partial derivatives up to the second order, computed in one pass
  */
-struct SurfaceDerivativesComponenets
+struct SurfacePointDerivatives
 {
-    CurveDerivativesComponenets U;
-    CurveDerivativesComponenets V;
+    glm::vec3 Position;
+    glm::vec3 DerivativeU;
+    glm::vec3 DerivativeV;
+    glm::vec3 DerivativeUU;
+    glm::vec3 DerivativeUV;
+    glm::vec3 DerivativeVV;
 };
 
 /**
@@ -40,7 +45,74 @@ struct SurfaceCurvaturesComponents
 {
     float MeanCurvature;
     float GaussianCurvature;
-    float AbsoluteCurvature;
+    float AbsoluteCurvature; // sum of the squared principal curvatures (4 * H^2 - 2 * K)
+    float MaxPrincipalCurvature;
+    float MinPrincipalCurvature;
+};
+
+/**
+ * @brief The samples along one direction of a surface: their parameter, knot span and non-zero basis functions
+ * @note Depends only on the knots, the degree and the number of samples, it is kept while the control points move
+ */
+struct SurfaceBasisTable
+{
+    std::vector<float> Parameters;
+    std::vector<int> Spans;
+    std::vector<float> Basis;             // (degree + 1) values per sample
+    std::vector<float> FirstDerivatives;  // their first derivatives
+    std::vector<float> SecondDerivatives; // their second derivatives
+
+    /**
+     * @brief Fill the table with nbSamples parameters uniformly spaced from the start of the range (its end is excluded)
+     * @param knots The knots vector of the direction
+     * @param degree The degree of the direction
+     * @param nbSamples The number of samples
+     * @param spanLookup The span lookup built on the knots
+     */
+    void Build(const std::vector<float> &knots, uint8_t degree, int nbSamples, const BSplineBasis::KnotSpanLookup &spanLookup);
+
+    /**
+     * @brief The samples influenced by a range of control points, the spans [firstControlPoint, lastControlPoint + degree]
+     * @param firstControlPoint The first control point of the range
+     * @param lastControlPoint The last control point of the range
+     * @param degree The degree of the direction
+     * @param firstSample Output, the first influenced sample
+     * @param endSample Output, the sample after the last influenced one
+     */
+    void FindSamples(int firstControlPoint, int lastControlPoint, uint8_t degree, int &firstSample, int &endSample) const;
+
+    inline std::size_t Size() const { return Parameters.size(); }
+};
+
+/**
+ * @brief Rectangle of control points modified since the last evaluation of a grid
+ */
+struct SurfaceDirtyRegion
+{
+    int FirstRow = 0;
+    int LastRow = -1;
+    int FirstColumn = 0;
+    int LastColumn = -1;
+    bool Full = true; // every sample must be evaluated again
+
+    inline bool IsEmpty() const { return !Full && FirstRow > LastRow; }
+
+    inline void Expand(int row, int column)
+    {
+        if (FirstRow > LastRow)
+        {
+            FirstRow = LastRow = row;
+            FirstColumn = LastColumn = column;
+            return;
+        }
+
+        FirstRow = std::min(FirstRow, row);
+        LastRow = std::max(LastRow, row);
+        FirstColumn = std::min(FirstColumn, column);
+        LastColumn = std::max(LastColumn, column);
+    }
+
+    inline void Clear() { *this = {0, -1, 0, -1, false}; }
 };
 
 class BSplineSurface
@@ -52,16 +124,26 @@ public:
 
     /**
      * @brief Evaluate all the points of the B-Spline surface
+     * @note The basis functions of the samples are tabulated once per knots or precision change (see SurfaceBasisTable),
+     * the grid is then two small contractions of the homogeneous net: every control row at the v samples, then these rows at the u samples.
+     * O(nbControlPointsU * nbPointsV * (degreeV + 1) + nbPointsU * nbPointsV * (degreeU + 1)) instead of a full basis evaluation per point.
+     * Both passes are split in cache sized tiles run by the job system, each tile writes its own region of the output.
+     * Only the samples influenced by the control points modified since the last call are evaluated again (see SetControlPoint).
      */
     void Evaluate();
 
     /**
-     * @brief Evaluate the Frenet frame at all the points of the B-Spline surface to compute the curvatures (Mean, Gaussian, Absolute)
-    */
+     * @brief Evaluate the curvatures at all the points of the B-Spline surface (see GetGrid and GetCurvaturesComponents)
+     * @note The point and its first and second partial derivatives are contracted together from the basis tables and their derivatives
+     * (the same two passes as Evaluate), the curvatures follow from the fundamental forms of each point.
+     * Like Evaluate, only the samples influenced by the control points modified since the last call are evaluated again.
+     */
     void EvaluateCurvatures();
 
     /**
      * @brief Evaluate the B-Spline surface at a given u and v
+     * @note Only the (degreeU + 1) x (degreeV + 1) control points of the spans containing u and v are read,
+     * the homogeneous point is evaluated then divided by its weight (rational surface)
      * @param u A value between the minimum value and the maximum value of the knots vector
      * @param v A value between the minimum value and the maximum value of the knots vector
      * @return The point on the surface at u and v
@@ -69,12 +151,21 @@ public:
     glm::vec3 EvaluateAt(float u, float v) const;
 
     /**
-     * @brief Evaluate the Frenet frame at a given u and v
+     * @brief Evaluate the point and its partial derivatives up to the second order at a given u and v from the basis functions derivatives
+     * @note The derivatives of the rational surface are exact, they are obtained from the homogeneous ones with the quotient rule
+     * @param u A value between the minimum value and the maximum value of the knots vector
+     * @param v A value between the minimum value and the maximum value of the knots vector
+     * @return The position, first and second partial derivatives at u and v
+     */
+    SurfacePointDerivatives EvaluateDerivativesAt(float u, float v) const;
+
+    /**
+     * @brief Evaluate the Frenet frames of the iso-parametric curves at a given u and v
      * @param u A value between the minimum value and the maximum value of the knots vector
      * @param v A value between the minimum value and the maximum value of the knots vector
      * @return The tangent, normal and binormal vectors at u and v
      */
-    SurfaceFrenetFrameComponents GetFrenetFrameAt(float u, float v);
+    SurfaceFrenetFrameComponents GetFrenetFrameAt(float u, float v) const;
 
     /**
      * @brief Compute the curvature at a given u and v
@@ -82,29 +173,117 @@ public:
      * @param v A value between the minimum value and the maximum value of the knots vector
      * @return The curvature at u and v
      */
-    SurfaceCurvaturesComponents GetCurvaturesAt(float u, float v);
+    SurfaceCurvaturesComponents GetCurvaturesAt(float u, float v) const;
+
+    /**
+     * @brief Compute the Frenet frames of the iso-parametric curves from already evaluated derivatives
+     * @param derivatives The derivatives at the point (see EvaluateDerivativesAt)
+     */
+    static SurfaceFrenetFrameComponents ComputeFrenetFrame(const SurfacePointDerivatives &derivatives);
+
+    /**
+     * @brief Compute the curvatures from already evaluated derivatives
+     * @note From the first (E, F, G) and second (L, M, N) fundamental forms, the normal is Su x Sv.
+     * The curvatures of a degenerate point (Su and Sv parallel) are 0
+     * @param derivatives The derivatives at the point (see EvaluateDerivativesAt)
+     */
+    static SurfaceCurvaturesComponents ComputeCurvatures(const SurfacePointDerivatives &derivatives);
 
     /**
-     * @brief Compute the knots vector based on the type of B-Spline (uniform, open uniform)
+     * @brief Compute the knots vectors based on the type of B-Spline (uniform, open uniform, chord length, centripetal)
+     * @note The chord length and centripetal parameters of each direction are averaged over the rows of the net
      */
     void InitKnotVector();
 
-    inline void SetAttributes(const BSplineSurfaceAttributes &attributes) { m_Attributes = attributes; }
-    inline void SetControlPoints(const std::vector<std::vector<glm::vec3>> &controlPoints) { m_ControlPoints = controlPoints; }
+    /**
+     * @brief Change the type of the knots vectors, to apply with InitKnotVector
+     */
+    inline void SetType(BSplineType type) { m_Type = type; }
+    inline BSplineType GetType() const { return m_Type; }
+
+    inline void SetAttributes(const BSplineSurfaceAttributes &attributes)
+    {
+        m_Attributes = attributes;
+        UpdateSpanLookups();
+    }
+    /**
+     * @brief Set the control points, the weights are kept if the net keeps its size and reset to 1 otherwise
+     */
+    void SetControlPoints(const std::vector<std::vector<glm::vec3>> &controlPoints);
+
+    /**
+     * @brief Set the control points and their weights
+     * @param controlPoints The control points net
+     * @param weights The weight of each control point (strictly positive), same size as the net
+     */
+    void SetControlPoints(const std::vector<std::vector<glm::vec3>> &controlPoints, const std::vector<std::vector<float>> &weights);
+
+    /**
+     * @brief Move a control point, the next evaluations only update the (degreeU + 1) x (degreeV + 1) spans it influences
+     * @param i The index of the control point along u
+     * @param j The index of the control point along v
+     * @param position The new position of the control point
+     */
+    void SetControlPoint(int i, int j, const glm::vec3 &position);
+
+    /**
+     * @brief Change the weight of a control point, it pulls the surface towards the point when greater than the others
+     */
+    inline void SetWeight(int i, int j, float weight)
+    {
+        m_Weights[i][j] = weight;
+        m_HomogeneousControlPoints[i * m_Weights[i].size() + j] = glm::vec4(weight * m_ControlPoints[i][j], weight);
+        m_DirtyPoints.Expand(i, j);
+        m_DirtyCurvatures.Expand(i, j);
+        m_Version++;
+    }
     inline void SetKnots(const std::vector<float> &knotsU, const std::vector<float> &knotsV)
     {
         m_Attributes.U.Knots = knotsU;
         m_Attributes.V.Knots = knotsV;
+        UpdateSpanLookups();
+    }
+    inline void SetKnotsV(const std::vector<float> &knotsV)
+    {
+        m_Attributes.U.Knots = knotsV;
+        UpdateSpanLookups();
+    }
+    inline void SetKnotsU(const std::vector<float> &knotsU)
+    {
+        m_Attributes.V.Knots = knotsU;
+        UpdateSpanLookups();
     }
-    inline void SetKnotsV(const std::vector<float> &knotsV) { m_Attributes.U.Knots = knotsV; }
-    inline void SetKnotsU(const std::vector<float> &knotsU) { m_Attributes.V.Knots = knotsU; }
 
     inline const BSplineSurfaceAttributes &GetAttributes() const { return m_Attributes; }
     inline const std::vector<std::vector<glm::vec3>> &GetControlPoints() const { return m_ControlPoints; }
-    inline const std::vector<std::vector<glm::vec3>> &GetPoints() const { return m_Points; }
-    inline const std::vector<std::vector<float>> &GetCurvatures() const { return m_Curvatures; }
+    inline const std::vector<std::vector<float>> &GetWeights() const { return m_Weights; }
 
-    inline void SetPrecision(uint32_t precision) { m_Precision = precision; }
+    /**
+     * @brief The control points multiplied by their weight (w * P, w), row major
+     */
+    inline const std::vector<glm::vec4> &GetHomogeneousControlPoints() const { return m_HomogeneousControlPoints; }
+
+    /**
+     * @brief The points of the surface filled by Evaluate, with their Gaussian curvature filled by EvaluateCurvatures
+     */
+    inline const SurfaceGrid &GetGrid() const { return m_Grid; }
+
+    /**
+     * @brief All the curvatures at each point of the grid (row major like the grid), filled by EvaluateCurvatures
+     */
+    inline const std::vector<SurfaceCurvaturesComponents> &GetCurvaturesComponents() const { return m_CurvaturesComponents; }
+
+    /**
+     * @brief Incremented each time the shape of the surface changes (control points, weights, knots or degrees), not with the precision
+     */
+    inline uint64_t GetVersion() const { return m_Version; }
+
+    inline void SetPrecision(uint32_t precision)
+    {
+        m_Precision = precision;
+        m_BasisTablesValid = false;
+        InvalidateSamples();
+    }
 
     inline float GetMinT_U() const { return m_Attributes.U.Knots[m_Attributes.U.Degree]; }
     inline float GetMaxT_U() const { return m_Attributes.U.Knots[m_Attributes.U.Knots.size() - m_Attributes.U.Degree - 1]; }
@@ -113,34 +292,86 @@ public:
 
 private:
     /**
-     * @brief Compute the weight of a control point at a given index and a given t
-     * @param knots The knots vector
-     * @param index The index of the control point
-     * @param degree The degree of the B-Spline
-     * @param t The value of t
+     * @brief Sum the homogeneous control points of the spans weighted by their basis functions
+     * @param spanU The knot span along u
+     * @param basisU The (degreeU + 1) non-zero basis functions along u
+     * @param spanV The knot span along v
+     * @param basisV The (degreeV + 1) non-zero basis functions along v
+     * @return The point (w * P, w)
+     */
+    glm::vec4 EvaluateHomogeneous(int spanU, const float *basisU, int spanV, const float *basisV) const;
+
+    /**
+     * @brief Rebuild the span lookups of both knots vectors, the basis tables will be rebuilt by the next Evaluate
+     */
+    inline void UpdateSpanLookups()
+    {
+        m_SpanLookupU.Build(m_Attributes.U.Knots, m_Attributes.U.Degree);
+        m_SpanLookupV.Build(m_Attributes.V.Knots, m_Attributes.V.Degree);
+        m_BasisTablesValid = false;
+        InvalidateSamples();
+        m_Version++;
+    }
+
+    /**
+     * @brief Evaluate every sample again at the next evaluations
+     */
+    inline void InvalidateSamples()
+    {
+        m_DirtyPoints.Full = true;
+        m_DirtyCurvatures.Full = true;
+    }
+
+    /**
+     * @brief The samples to evaluate again for a dirty region, the rows along v of the control rows [firstRow, endRow)
+     * at the v samples [firstSampleV, endSampleV), then the grid at the u samples [firstSampleU, endSampleU)
+     * @return False if there is nothing to evaluate
      */
-    float ComputeWeight(const std::vector<float> &knots, int index, uint8_t degree, float t) const;
+    bool FindDirtySamples(const SurfaceDirtyRegion &region, int &firstRow, int &endRow, int &firstSampleU, int &endSampleU,
+                          int &firstSampleV, int &endSampleV) const;
 
     /**
-     * @brief Comute the partial derivatives of the B-Spline surface at a given u and v
-     * @param u The value of u
-     * @param v The value of v
+     * @brief Rebuild the basis tables if the knots, the degrees, the precision or the size of the net changed
      */
-    SurfaceDerivativesComponenets GetFiniteDifferencesPartialDerivatives(float u, float v) const;
+    void UpdateBasisTables();
 
     /**
-     * @brief Comute the derivatives of the B-Spline surface at a given u and v
-     * @param u The value of u
-     * @param v The value of v
+     * @brief Copy the control points and their weights to the homogeneous net, every sample will be evaluated again
      */
-    CurveDerivativesComponenets GetFiniteDifferencesDerivatives(float u, float v) const;
+    void UpdateHomogeneousControlPoints();
+
+    /**
+     * @brief Apply the quotient rule to the homogeneous point and its partial derivatives
+     * @param homogeneous A, Au, Av, Auu, Auv, Avv
+     */
+    static SurfacePointDerivatives ProjectDerivatives(const glm::vec4 homogeneous[6]);
 
 private:
     BSplineSurfaceAttributes m_Attributes;
+    BSplineBasis::KnotSpanLookup m_SpanLookupU;
+    BSplineBasis::KnotSpanLookup m_SpanLookupV;
     std::vector<std::vector<glm::vec3>> m_ControlPoints;
-    std::vector<std::vector<glm::vec3>> m_Points;
-    std::vector<std::vector<float>> m_Curvatures;
+    std::vector<std::vector<float>> m_Weights;
+    SurfaceGrid m_Grid;
+    std::vector<SurfaceCurvaturesComponents> m_CurvaturesComponents;
+
+    // basis functions of the samples along u and v, valid until the knots, the degrees or the precision change
+    SurfaceBasisTable m_BasisTableU;
+    SurfaceBasisTable m_BasisTableV;
+    bool m_BasisTablesValid = false;
+
+    std::vector<glm::vec4> m_HomogeneousControlPoints; // (w * P, w) row major, updated with the control points and the weights
+
+    // control points modified since the last Evaluate and the last EvaluateCurvatures
+    SurfaceDirtyRegion m_DirtyPoints;
+    SurfaceDirtyRegion m_DirtyCurvatures;
+
+    // reused by Evaluate and EvaluateCurvatures: each control row contracted at the v samples, and its first and second derivatives along v
+    std::vector<glm::vec4> m_RowsAlongV;
+    std::vector<glm::vec4> m_RowsAlongVDerivatives;
+    std::vector<glm::vec4> m_RowsAlongVSecondDerivatives;
 
+    uint64_t m_Version = 0;
     uint32_t m_Precision = 6;
     BSplineType m_Type = BSplineType::Uniform;
 };
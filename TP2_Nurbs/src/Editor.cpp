@@ -40,6 +40,18 @@ namespace TP2_Nurbs
             return points;
         }
 
+        /**
+         * @brief The (u, v) indices of a control point of the net, (-1, -1) if it is not in the net
+         */
+        glm::ivec2 GetIndices(const ControlPoint *point) const
+        {
+            for (std::size_t i = 0; i < ControlPoints.size(); i++)
+                for (std::size_t j = 0; j < ControlPoints[i].size(); j++)
+                    if (&ControlPoints[i][j] == point)
+                        return glm::ivec2(i, j);
+            return {-1, -1};
+        }
+
         ControlPoint *GetHoveredControlPoint()
         {
             for (auto &row : ControlPoints)
@@ -59,6 +71,9 @@ namespace TP2_Nurbs
 
         bool ShowFrenetFrame = false;
         bool ShowCurvatureMap = false;
+        bool UseTriangleStrips = false;
+        bool UseAdaptiveTessellation = false;
+        float ScreenSpaceError = 1.0f; // in pixels
 
         bool IsDragging = false;
     };
@@ -150,15 +165,18 @@ namespace TP2_Nurbs
 
         Renderer::DrawControlPoints(s_SurfaceData.ControlPoints);
 
-        auto surfacePoints = m_Surface.GetPoints();
-
-        if (s_EditorData.ShowCurvatureMap)
+        if (s_EditorData.UseAdaptiveTessellation)
         {
-            auto surfaceCurvatures = m_Surface.GetCurvatures();
-            Renderer::DrawSurface(surfacePoints, surfaceCurvatures, s_EditorData.ShowCurvatureMap);
+            // refined again each frame, the mesh is only rebuilt when the camera or the surface changed its leaves
+            float height = Core::Application::Get().GetWindow().GetHeight();
+            m_AdaptiveMesh.Update(m_Surface, SurfaceTessellationView::FromCamera(m_Camera->GetPosition(), m_Camera->GetProjectionMatrix(), height));
+            Renderer::DrawSurface(m_AdaptiveMesh, s_EditorData.ShowCurvatureMap);
         }
         else
-            Renderer::DrawSurface(surfacePoints);
+        {
+            SurfaceGridPrimitive primitive = s_EditorData.UseTriangleStrips ? SurfaceGridPrimitive::TriangleStrips : SurfaceGridPrimitive::Triangles;
+            Renderer::DrawSurface(m_Surface.GetGrid(), s_EditorData.ShowCurvatureMap, primitive);
+        }
 
         if (s_EditorData.ShowFrenetFrame)
         {
@@ -175,11 +193,9 @@ namespace TP2_Nurbs
 
         Renderer::EndScene();
 
+        // the curvatures are cheap enough to follow the dragged point
         if (s_EditorData.IsDragging && s_SurfaceData.SelectedControlPoint)
-        {
-            s_EditorData.ShowCurvatureMap = false;
             DragSelectedPoint();
-        }
     }
 
     void Editor::OnEvent(Events::Event &event)
@@ -201,7 +217,7 @@ namespace TP2_Nurbs
     {
         ImGui::Begin("Surface Editor", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
 
-        if (ImGui::SliderInt("Suface Precision", &s_EditorData.SurfacePrecision, 1, 6))
+        if (ImGui::SliderInt("Suface Precision", &s_EditorData.SurfacePrecision, 1, 20))
         {
             m_Surface.SetPrecision(s_EditorData.SurfacePrecision);
             m_Surface.Evaluate();
@@ -211,6 +227,15 @@ namespace TP2_Nurbs
         ImGui::SliderFloat("T_V", &s_SurfaceData.T_V, m_Surface.GetMinT_V(), m_Surface.GetMaxT_V());
 
         ImGui::Checkbox("Show Frenet Frame", &s_EditorData.ShowFrenetFrame);
+        ImGui::Checkbox("Triangle Strips", &s_EditorData.UseTriangleStrips);
+
+        ImGui::Checkbox("Adaptive Tessellation", &s_EditorData.UseAdaptiveTessellation);
+        if (s_EditorData.UseAdaptiveTessellation)
+        {
+            if (ImGui::SliderFloat("Screen Space Error (px)", &s_EditorData.ScreenSpaceError, 0.25f, 16.0f))
+                m_AdaptiveMesh.SetTolerance(s_EditorData.ScreenSpaceError);
+            ImGui::Text("Triangles : %zu", m_AdaptiveMesh.GetIndices().size() / 3);
+        }
 
         if (ImGui::Checkbox("Show Curvature Map", &s_EditorData.ShowCurvatureMap))
         {
@@ -259,13 +284,37 @@ namespace TP2_Nurbs
 
         s_SurfaceData.SelectedControlPoint->Position = projectedPoint;
 
-        m_Surface.SetControlPoints(s_SurfaceData.GetControlPoints());
+        // only the spans of the moved point are evaluated again and uploaded
+        glm::ivec2 indices = s_SurfaceData.GetIndices(s_SurfaceData.SelectedControlPoint);
+        m_Surface.SetControlPoint(indices.x, indices.y, projectedPoint);
         m_Surface.Evaluate();
 
         if (s_EditorData.ShowCurvatureMap)
             m_Surface.EvaluateCurvatures();
     }
 
+    bool Editor::PickSurfacePoint()
+    {
+        glm::vec2 mousePosition = Input::GetMousePosition();
+
+        float width = Core::Application::Get().GetWindow().GetWidth();
+        float height = Core::Application::Get().GetWindow().GetHeight();
+
+        // ray from the camera through the mouse, the patches are only extracted again after an edit
+        glm::vec3 cameraPosition = m_CameraController->GetPosition();
+        glm::vec3 worldPoint = m_Camera->ScreenToWorld(mousePosition, {width, height});
+        glm::vec3 direction = glm::normalize(worldPoint - cameraPosition);
+
+        m_PatchHierarchy.Update(m_Surface);
+        SurfaceRayHit hit = m_PatchHierarchy.Intersect(cameraPosition, direction);
+        if (!hit.Hit)
+            return false;
+
+        s_SurfaceData.T_U = hit.U;
+        s_SurfaceData.T_V = hit.V;
+        return true;
+    }
+
     bool Editor::OnMouseMoved(const Events::MouseMovedEvent &e)
     {
         auto mousePosition = Input::GetMousePosition();
@@ -298,6 +347,10 @@ namespace TP2_Nurbs
                 s_SurfaceData.SelectedControlPoint->Selected = false;
             s_SurfaceData.SelectedControlPoint = nullptr;
 
+            // a click beside the control points moves the (u, v) cursor to the surface point under the mouse
+            if (!s_SurfaceData.GetHoveredControlPoint())
+                PickSurfacePoint();
+
             return false;
         }
 
@@ -320,8 +373,6 @@ namespace TP2_Nurbs
         {
         case Events::Key::G:
             s_EditorData.IsDragging = !s_EditorData.IsDragging;
-            if (!s_EditorData.IsDragging)
-                s_EditorData.ShowCurvatureMap = false;
             break;
         }
 
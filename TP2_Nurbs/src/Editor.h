@@ -30,9 +30,17 @@ namespace TP2_Nurbs
         bool OnWindowResize(const Events::WindowResizeEvent &e);
         void DragSelectedPoint();
 
+        /**
+         * @brief Move the (u, v) cursor to the point of the surface under the mouse
+         * @return false when the mouse is not over the surface
+         */
+        bool PickSurfacePoint();
+
 
     private:
         BSplineSurface m_Surface;
+        AdaptiveSurfaceMesh m_AdaptiveMesh;
+        SurfacePatchHierarchy m_PatchHierarchy;
         Shared<PerspectiveCamera> m_Camera;
         Shared<ArcBallCameraController> m_CameraController;
     };
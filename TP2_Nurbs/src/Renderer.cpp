@@ -4,16 +4,35 @@ namespace TP2_Nurbs
 {
     struct SurfaceBuffers
     {
-        const uint32_t MaxVertices = 10000;
-        const uint32_t MaxIndices = 10000 * 6;
+        // initial capacities, the buffers grow with the grid
+        const uint32_t InitialVertices = 10000;
+        const uint32_t InitialIndices = 10000 * 6;
 
         Shared<VertexArray> VAO;
         Shared<VertexBuffer> VBO;
         Shared<IndexBuffer> IBO;
         Shared<Shader> Program;
+
+        // what the buffers hold, to upload only the changes
+        SurfaceGridTopology Topology;
+        uint64_t UploadedTopologyVersion = 0;
+        const SurfaceGrid *UploadedGrid = nullptr;
+        uint64_t UploadedGridVersion = 0;
+    };
+
+    struct AdaptiveMeshBuffers
+    {
+        // drawn with the program of the surface buffers
+        Shared<VertexArray> VAO;
+        Shared<VertexBuffer> VBO;
+        Shared<IndexBuffer> IBO;
+
+        const AdaptiveSurfaceMesh *UploadedMesh = nullptr;
+        uint64_t UploadedMeshVersion = 0;
     };
 
     static SurfaceBuffers s_SurfaceBuffers;
+    static AdaptiveMeshBuffers s_AdaptiveMeshBuffers;
     static RenderPass s_RenderPass;
     static bool s_isWireframe = false;
 
@@ -45,16 +64,27 @@ namespace TP2_Nurbs
         // setup surface buffers
         s_SurfaceBuffers.VAO = CreateShared<VertexArray>();
 
-        s_SurfaceBuffers.VBO = CreateShared<VertexBuffer>(s_SurfaceBuffers.MaxVertices * sizeof(glm::vec4));
+        s_SurfaceBuffers.VBO = CreateShared<VertexBuffer>(s_SurfaceBuffers.InitialVertices * sizeof(SurfaceVertex));
+        s_SurfaceBuffers.VBO->SetStreaming(); // re-uploaded while a control point is dragged, fine grids weigh megabytes
         BufferLayout layout = {
             {ShaderDataType::Float4, "a_PositionAndCurvature"},
         };
         s_SurfaceBuffers.VBO->SetLayout(layout);
         s_SurfaceBuffers.VAO->AddVertexBuffer(s_SurfaceBuffers.VBO);
 
-        s_SurfaceBuffers.IBO = CreateShared<IndexBuffer>(s_SurfaceBuffers.MaxIndices);
+        s_SurfaceBuffers.IBO = CreateShared<IndexBuffer>(s_SurfaceBuffers.InitialIndices);
         s_SurfaceBuffers.VAO->SetIndexBuffer(s_SurfaceBuffers.IBO);
 
+        // setup adaptive mesh buffers, same layout as the grid
+        s_AdaptiveMeshBuffers.VAO = CreateShared<VertexArray>();
+
+        s_AdaptiveMeshBuffers.VBO = CreateShared<VertexBuffer>(s_SurfaceBuffers.InitialVertices * sizeof(SurfaceVertex));
+        s_AdaptiveMeshBuffers.VBO->SetLayout(layout);
+        s_AdaptiveMeshBuffers.VAO->AddVertexBuffer(s_AdaptiveMeshBuffers.VBO);
+
+        s_AdaptiveMeshBuffers.IBO = CreateShared<IndexBuffer>(s_SurfaceBuffers.InitialIndices);
+        s_AdaptiveMeshBuffers.VAO->SetIndexBuffer(s_AdaptiveMeshBuffers.IBO);
+
         shaderPath = workingDirectory + "shaders/surface.glsl";
         s_SurfaceBuffers.Program = CreateShared<Shader>("Suface Shader", shaderPath);
     }
@@ -89,49 +119,59 @@ namespace TP2_Nurbs
             }
     }
 
-    void Renderer::DrawSurface(std::vector<std::vector<glm::vec3>> &points, std::vector<std::vector<float>> curvatures, bool showCurvatureMap)
+    void Renderer::DrawSurface(const SurfaceGrid &grid, bool showCurvatureMap, SurfaceGridPrimitive primitive)
     {
-        std::vector<float> vertices;
+        if (grid.GetRowsCount() < 2 || grid.GetColumnsCount() < 2)
+            return;
 
-        for(int i = 0; i < points.size(); i++)
-            for(int j = 0; j < points[i].size(); j++)
+        // the grid is laid out like the vertex buffer, it is uploaded as it is (only its modified rows if they are known)
+        if (&grid != s_SurfaceBuffers.UploadedGrid || grid.GetVersion() != s_SurfaceBuffers.UploadedGridVersion)
+        {
+            uint32_t firstRow, endRow;
+            if (&grid == s_SurfaceBuffers.UploadedGrid && grid.GetModifiedRows(s_SurfaceBuffers.UploadedGridVersion, firstRow, endRow))
             {
-                glm::vec3 point = points[i][j];
-                vertices.push_back(point.x);
-                vertices.push_back(point.y);
-                vertices.push_back(point.z);
-
-                if(curvatures.size() == 0)
-                {
-                    vertices.push_back(1.0f);
-                    continue;
-                }
-
-                float curvature = curvatures[i][j];
-                vertices.push_back(curvature);
+                uint32_t rowSize = grid.GetColumnsCount() * sizeof(SurfaceVertex);
+                s_SurfaceBuffers.VBO->UpdateData(firstRow * rowSize, (endRow - firstRow) * rowSize, grid.Row(firstRow).First);
             }
+            else
+                s_SurfaceBuffers.VBO->SetData(grid.GetVerticesCount() * sizeof(SurfaceVertex), grid.GetData());
 
-        uint32_t bufferSize = vertices.size() * sizeof(float);
-        s_SurfaceBuffers.VBO->SetData(bufferSize, vertices.data());
+            s_SurfaceBuffers.UploadedGrid = &grid;
+            s_SurfaceBuffers.UploadedGridVersion = grid.GetVersion();
+        }
 
-        std::vector<uint32_t> indices;
-        for (uint32_t i = 0; i < points.size() - 1; i++)
-            for (uint32_t j = 0; j < points[i].size() - 1; j++)
-            {
-                indices.push_back(i * points[i].size() + j);
-                indices.push_back((i + 1) * points[i].size() + j);
-                indices.push_back((i + 1) * points[i].size() + j + 1);
+        SurfaceGridTopology &topology = s_SurfaceBuffers.Topology;
+        topology.Update(grid.GetRowsCount(), grid.GetColumnsCount(), primitive);
+        if (topology.GetVersion() != s_SurfaceBuffers.UploadedTopologyVersion)
+        {
+            s_SurfaceBuffers.IBO->SetData(topology.GetCount(), topology.GetData(), topology.GetIndexType());
+            s_SurfaceBuffers.UploadedTopologyVersion = topology.GetVersion();
+        }
 
-                indices.push_back(i * points[i].size() + j);
-                indices.push_back((i + 1) * points[i].size() + j + 1);
-                indices.push_back(i * points[i].size() + j + 1);
-            }
+        s_SurfaceBuffers.Program->Bind();
+        s_SurfaceBuffers.Program->SetFloat("u_ShowCurvatureMap", showCurvatureMap);
+        if (primitive == SurfaceGridPrimitive::TriangleStrips)
+            RenderCommand::DrawIndexedStrips(s_SurfaceBuffers.VAO, topology.GetCount());
+        else
+            RenderCommand::DrawIndexed(s_SurfaceBuffers.VAO, topology.GetCount());
+    }
+
+    void Renderer::DrawSurface(const AdaptiveSurfaceMesh &mesh, bool showCurvatureMap)
+    {
+        if (mesh.GetIndices().empty())
+            return;
 
-        s_SurfaceBuffers.IBO->SetData(indices.size(), indices.data());
+        if (&mesh != s_AdaptiveMeshBuffers.UploadedMesh || mesh.GetVersion() != s_AdaptiveMeshBuffers.UploadedMeshVersion)
+        {
+            s_AdaptiveMeshBuffers.VBO->SetData(mesh.GetVertices().size() * sizeof(SurfaceVertex), mesh.GetVertices().data());
+            s_AdaptiveMeshBuffers.IBO->SetData(mesh.GetIndices().size(), mesh.GetIndices().data(), IndexType::UInt32);
+            s_AdaptiveMeshBuffers.UploadedMesh = &mesh;
+            s_AdaptiveMeshBuffers.UploadedMeshVersion = mesh.GetVersion();
+        }
 
         s_SurfaceBuffers.Program->Bind();
         s_SurfaceBuffers.Program->SetFloat("u_ShowCurvatureMap", showCurvatureMap);
-        RenderCommand::DrawIndexed(s_SurfaceBuffers.VAO, indices.size());
+        RenderCommand::DrawIndexed(s_AdaptiveMeshBuffers.VAO, mesh.GetIndices().size());
     }
 
     void Renderer::BeginScene(const glm::mat4 &viewProjection)
@@ -2,6 +2,8 @@
 
 #include "SmartGL.h"
 #include "BSplineSurface.h"
+#include "AdaptiveSurfaceMesh.h"
+#include "SurfacePatchHierarchy.h"
 
 using namespace SmartGL;
 
@@ -28,7 +30,23 @@ namespace TP2_Nurbs
 
         static void BeginScene(const glm::mat4 &viewProjection);
         static void DrawControlPoints(const std::vector<std::vector<ControlPoint>> &controlPoints);
-        static void DrawSurface(std::vector<std::vector<glm::vec3>> &points, std::vector<std::vector<float>> curvatures = {}, bool showCurvatureMap = false);
+
+        /**
+         * @brief Draw the grid of a surface
+         * @note The vertices are uploaded only when the grid changed and the indices only when its dimensions or the primitive changed
+         * @param grid The grid, its curvatures are only read when showCurvatureMap is set
+         * @param showCurvatureMap Color the surface with the curvature of its vertices
+         * @param primitive The triangles or the strips of the grid
+         */
+        static void DrawSurface(const SurfaceGrid &grid, bool showCurvatureMap = false, SurfaceGridPrimitive primitive = SurfaceGridPrimitive::Triangles);
+
+        /**
+         * @brief Draw an adaptive tessellation of a surface
+         * @note The mesh is uploaded only when it was rebuilt
+         * @param mesh The mesh
+         * @param showCurvatureMap Color the surface with the curvature of its vertices
+         */
+        static void DrawSurface(const AdaptiveSurfaceMesh &mesh, bool showCurvatureMap = false);
         static void EndScene();
 
         static void Resize(uint32_t width, uint32_t height);
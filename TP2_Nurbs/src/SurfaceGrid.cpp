@@ -0,0 +1,103 @@
+#include "SurfaceGrid.h"
+
+#include <algorithm>
+#include <limits>
+
+void SurfaceGrid::MarkModified(uint32_t firstRow, uint32_t endRow)
+{
+    m_Version++;
+    m_ModifiedRows[m_Version % ModifiedRowsHistorySize] = {firstRow, endRow};
+}
+
+bool SurfaceGrid::GetModifiedRows(uint64_t version, uint32_t &firstRow, uint32_t &endRow) const
+{
+    firstRow = endRow = 0;
+    if (version >= m_Version)
+        return true;
+
+    // every version after the caller's one must be a remembered partial modification
+    if (version < m_FullVersion || m_Version - version > ModifiedRowsHistorySize)
+        return false;
+
+    firstRow = m_RowsCount;
+    for (uint64_t modification = version + 1; modification <= m_Version; modification++)
+    {
+        const ModifiedRows &rows = m_ModifiedRows[modification % ModifiedRowsHistorySize];
+        firstRow = std::min(firstRow, rows.FirstRow);
+        endRow = std::max(endRow, rows.EndRow);
+    }
+    firstRow = std::min(firstRow, endRow);
+    return true;
+}
+
+bool SurfaceGridTopology::Update(uint32_t rowsCount, uint32_t columnsCount, SurfaceGridPrimitive primitive)
+{
+    if (rowsCount == m_RowsCount && columnsCount == m_ColumnsCount && primitive == m_Primitive && m_Version > 0)
+        return false;
+
+    m_RowsCount = rowsCount;
+    m_ColumnsCount = columnsCount;
+    m_Primitive = primitive;
+    m_Version++;
+
+    m_Indices16.clear();
+    m_Indices32.clear();
+
+    // the largest index is the primitive restart one
+    if ((uint64_t)rowsCount * columnsCount < std::numeric_limits<uint16_t>::max())
+    {
+        m_IndexType = SmartGL::IndexType::UInt16;
+        Build(m_Indices16);
+    }
+    else
+    {
+        m_IndexType = SmartGL::IndexType::UInt32;
+        Build(m_Indices32);
+    }
+
+    return true;
+}
+
+template <typename Index>
+void SurfaceGridTopology::Build(std::vector<Index> &indices)
+{
+    if (m_RowsCount < 2 || m_ColumnsCount < 2)
+        return;
+
+    auto vertex = [this](uint32_t row, uint32_t column)
+    { return static_cast<Index>(row * m_ColumnsCount + column); };
+
+    if (m_Primitive == SurfaceGridPrimitive::TriangleStrips)
+    {
+        // (row, column) then (row + 1, column) for each column: the cells of the row, same winding as the list but split along the other diagonal
+        indices.reserve((m_RowsCount - 1) * (2 * m_ColumnsCount + 1));
+        for (uint32_t row = 0; row + 1 < m_RowsCount; row++)
+        {
+            for (uint32_t column = 0; column < m_ColumnsCount; column++)
+            {
+                indices.push_back(vertex(row, column));
+                indices.push_back(vertex(row + 1, column));
+            }
+            indices.push_back(std::numeric_limits<Index>::max());
+        }
+        return;
+    }
+
+    indices.reserve(6 * (m_RowsCount - 1) * (m_ColumnsCount - 1));
+    for (uint32_t firstColumn = 0; firstColumn + 1 < m_ColumnsCount; firstColumn += ColumnsPerBand)
+    {
+        uint32_t lastColumn = std::min(firstColumn + ColumnsPerBand, m_ColumnsCount - 1);
+
+        for (uint32_t row = 0; row + 1 < m_RowsCount; row++)
+            for (uint32_t column = firstColumn; column < lastColumn; column++)
+            {
+                indices.push_back(vertex(row, column));
+                indices.push_back(vertex(row + 1, column));
+                indices.push_back(vertex(row + 1, column + 1));
+
+                indices.push_back(vertex(row, column));
+                indices.push_back(vertex(row + 1, column + 1));
+                indices.push_back(vertex(row, column + 1));
+            }
+    }
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "SmartGL.h"
+
+/**
+ * @brief A sample of the surface, laid out like the a_PositionAndCurvature attribute of the surface shader
+ */
+struct SurfaceVertex
+{
+    glm::vec3 Position;
+    float Curvature;
+};
+
+/**
+ * @brief Strided view of a line of a grid (a row is contiguous, a column jumps a row at each element)
+ */
+template <typename T>
+struct SurfaceGridView
+{
+    T *First;
+    uint32_t Count;
+    uint32_t Stride;
+
+    inline T &operator[](uint32_t index) const { return First[index * Stride]; }
+    inline uint32_t size() const { return Count; }
+};
+
+/**
+ * @brief The samples of a surface stored contiguously, row major (a row follows v at a fixed u)
+ * @note The vertices are uploaded as they are, the version tells the renderer when they changed
+ * and the last modified rows ranges let it upload only these rows
+ */
+class SurfaceGrid
+{
+public:
+    SurfaceGrid() = default;
+    ~SurfaceGrid() = default;
+
+    /**
+     * @brief Resize the grid, the vertices are kept only if the dimensions do not change
+     * @param rowsCount The number of samples along u
+     * @param columnsCount The number of samples along v
+     */
+    inline void Resize(uint32_t rowsCount, uint32_t columnsCount)
+    {
+        if (rowsCount == m_RowsCount && columnsCount == m_ColumnsCount)
+            return;
+
+        m_RowsCount = rowsCount;
+        m_ColumnsCount = columnsCount;
+        m_Vertices.assign(rowsCount * columnsCount, SurfaceVertex{glm::vec3(0.0f), 0.0f});
+        MarkModified();
+    }
+
+    /**
+     * @brief Tell the users of the grid that its vertices changed
+     */
+    inline void MarkModified()
+    {
+        m_Version++;
+        m_FullVersion = m_Version;
+    }
+
+    /**
+     * @brief Tell the users of the grid that the vertices of some rows changed
+     * @param firstRow The first modified row
+     * @param endRow The row after the last modified one
+     */
+    void MarkModified(uint32_t firstRow, uint32_t endRow);
+
+    /**
+     * @brief The rows modified since a version of the grid
+     * @param version The version known by the caller
+     * @param firstRow Output, the first modified row
+     * @param endRow Output, the row after the last modified one (equal to firstRow if nothing changed)
+     * @return False if the whole grid may have changed (resized, fully modified or too many modifications ago)
+     */
+    bool GetModifiedRows(uint64_t version, uint32_t &firstRow, uint32_t &endRow) const;
+
+    inline uint64_t GetVersion() const { return m_Version; }
+
+    /**
+     * @brief Number of partial modifications remembered by the grid
+     */
+    static constexpr uint32_t ModifiedRowsHistorySize = 8;
+
+    inline SurfaceVertex &At(uint32_t row, uint32_t column) { return m_Vertices[row * m_ColumnsCount + column]; }
+    inline const SurfaceVertex &At(uint32_t row, uint32_t column) const { return m_Vertices[row * m_ColumnsCount + column]; }
+
+    inline SurfaceGridView<SurfaceVertex> Row(uint32_t row) { return {m_Vertices.data() + row * m_ColumnsCount, m_ColumnsCount, 1}; }
+    inline SurfaceGridView<const SurfaceVertex> Row(uint32_t row) const { return {m_Vertices.data() + row * m_ColumnsCount, m_ColumnsCount, 1}; }
+    inline SurfaceGridView<SurfaceVertex> Column(uint32_t column) { return {m_Vertices.data() + column, m_RowsCount, m_ColumnsCount}; }
+    inline SurfaceGridView<const SurfaceVertex> Column(uint32_t column) const { return {m_Vertices.data() + column, m_RowsCount, m_ColumnsCount}; }
+
+    inline uint32_t GetRowsCount() const { return m_RowsCount; }
+    inline uint32_t GetColumnsCount() const { return m_ColumnsCount; }
+    inline uint32_t GetVerticesCount() const { return m_Vertices.size(); }
+    inline const SurfaceVertex *GetData() const { return m_Vertices.data(); }
+    inline bool IsEmpty() const { return m_Vertices.empty(); }
+
+private:
+    struct ModifiedRows
+    {
+        uint32_t FirstRow;
+        uint32_t EndRow;
+    };
+
+private:
+    std::vector<SurfaceVertex> m_Vertices;
+    uint32_t m_RowsCount = 0;
+    uint32_t m_ColumnsCount = 0;
+    uint64_t m_Version = 0;
+    uint64_t m_FullVersion = 0; // the last version where every vertex changed
+
+    // the rows of the partial modifications, the one making the version v is at v % ModifiedRowsHistorySize
+    std::array<ModifiedRows, ModifiedRowsHistorySize> m_ModifiedRows;
+};
+
+enum class SurfaceGridPrimitive
+{
+    /**
+     * @brief Two triangles per cell, the cells are ordered by bands of columns so that the vertices shared
+     * by consecutive rows are still in the post-transform cache
+     */
+    Triangles,
+
+    /**
+     * @brief One triangle strip per pair of rows, separated by the primitive restart index
+     */
+    TriangleStrips,
+};
+
+/**
+ * @brief The indices of the triangles of a grid, they only depend on its dimensions and are rebuilt when these change
+ * @note 16 bits indices are used when the vertices allow it (the largest value is kept for the primitive restart)
+ */
+class SurfaceGridTopology
+{
+public:
+    SurfaceGridTopology() = default;
+    ~SurfaceGridTopology() = default;
+
+    /**
+     * @brief Rebuild the indices if the dimensions or the primitive changed
+     * @param rowsCount The number of rows of the grid
+     * @param columnsCount The number of columns of the grid
+     * @param primitive The primitive of the indices
+     * @return True if the indices were rebuilt
+     */
+    bool Update(uint32_t rowsCount, uint32_t columnsCount, SurfaceGridPrimitive primitive);
+
+    inline const void *GetData() const { return m_IndexType == SmartGL::IndexType::UInt16 ? (const void *)m_Indices16.data() : (const void *)m_Indices32.data(); }
+    inline uint32_t GetCount() const { return m_IndexType == SmartGL::IndexType::UInt16 ? m_Indices16.size() : m_Indices32.size(); }
+    inline SmartGL::IndexType GetIndexType() const { return m_IndexType; }
+    inline SurfaceGridPrimitive GetPrimitive() const { return m_Primitive; }
+
+    /**
+     * @brief Incremented each time the indices are rebuilt
+     */
+    inline uint64_t GetVersion() const { return m_Version; }
+
+    /**
+     * @brief Number of columns of cells in a band of the Triangles primitive
+     * @note Two rows of a band (2 * (ColumnsPerBand + 1) vertices) fit in the post-transform cache of most GPUs
+     */
+    static constexpr uint32_t ColumnsPerBand = 8;
+
+private:
+    template <typename Index>
+    void Build(std::vector<Index> &indices);
+
+private:
+    std::vector<uint16_t> m_Indices16;
+    std::vector<uint32_t> m_Indices32;
+    SmartGL::IndexType m_IndexType = SmartGL::IndexType::UInt32;
+    SurfaceGridPrimitive m_Primitive = SurfaceGridPrimitive::Triangles;
+    uint32_t m_RowsCount = 0;
+    uint32_t m_ColumnsCount = 0;
+    uint64_t m_Version = 0;
+};
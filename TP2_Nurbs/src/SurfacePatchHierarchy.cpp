@@ -0,0 +1,591 @@
+#include "SurfacePatchHierarchy.h"
+#include "Core/Assert.h"
+#include "Core/JobSystem.h"
+
+#include <algorithm>
+
+// number of rays given to each job of the pool by the batched queries
+static constexpr uint32_t RayQueriesPerJob = 256;
+
+// a patch is cut in pieces until their control net deviates from a plane by less than this part of their diagonal
+static constexpr float PieceFlatness = 0.05f;
+static constexpr int MaxPieceDepth = 3;
+
+// a ray cuts the pieces it reaches until they are this flat, then finds the hit with Newton steps
+static constexpr float RayFlatness = 0.01f;
+static constexpr int MaxRaySubdivisions = 8;
+static constexpr int RayNewtonSteps = 16;
+
+// residual (part of the diagonal of the net) under which the ray hits the surface
+static constexpr float RayHitTolerance = 1e-4f;
+
+// part of a net around it where the Newton steps may end, the nets overlap a little so that no ray slips between them
+static constexpr float NetMargin = 0.01f;
+
+// largest control net of a patch
+static constexpr int NetCapacity = (BSplineBasis::MaxDegree + 1) * (BSplineBasis::MaxDegree + 1);
+
+/**
+ * @brief A ray, the two planes it is the intersection of, and the degrees of the patches it is tested against
+ */
+struct PatchRay
+{
+    glm::vec3 Origin;
+    glm::vec3 Direction;
+    glm::vec3 Normal1;
+    glm::vec3 Normal2;
+    uint8_t DegreeU;
+    uint8_t DegreeV;
+};
+
+/**
+ * @brief Interleave the bits of two span indices, neighbouring spans get close codes
+ */
+static uint64_t MortonCode(uint32_t x, uint32_t y)
+{
+    uint64_t code = 0;
+    for (int bit = 0; bit < 32; bit++)
+        code |= (uint64_t)((x >> bit) & 1) << (2 * bit) | (uint64_t)((y >> bit) & 1) << (2 * bit + 1);
+    return code;
+}
+
+/**
+ * @brief The Bernstein polynomials of a degree at t and their derivatives
+ * @param basis Output, degree + 1 values
+ * @param derivatives Output, degree + 1 values
+ */
+static void ComputeBernstein(uint8_t degree, float t, float *basis, float *derivatives)
+{
+    if (degree == 0)
+    {
+        basis[0] = 1.0f;
+        derivatives[0] = 0.0f;
+        return;
+    }
+
+    // the polynomials of degree - 1, raised once more: B(j, n) = (1 - t) B(j, n - 1) + t B(j - 1, n - 1) and B'(j, n) = n (B(j - 1, n - 1) - B(j, n - 1))
+    float lower[BSplineBasis::MaxDegree + 1];
+    lower[0] = 1.0f;
+    for (int k = 1; k < degree; k++)
+    {
+        float saved = 0.0f;
+        for (int j = 0; j < k; j++)
+        {
+            float temp = lower[j];
+            lower[j] = saved + (1.0f - t) * temp;
+            saved = t * temp;
+        }
+        lower[k] = saved;
+    }
+
+    for (int j = 0; j <= degree; j++)
+    {
+        float left = j > 0 ? lower[j - 1] : 0.0f;
+        float right = j < degree ? lower[j] : 0.0f;
+        basis[j] = t * left + (1.0f - t) * right;
+        derivatives[j] = degree * (left - right);
+    }
+}
+
+/**
+ * @brief Evaluate a rational Bezier patch and its first partial derivatives
+ * @param net The (degreeU + 1) x (degreeV + 1) homogeneous control points, row major
+ */
+static void EvaluatePatch(const glm::vec4 *net, uint8_t degreeU, uint8_t degreeV, float u, float v, glm::vec3 &position, glm::vec3 &derivativeU, glm::vec3 &derivativeV)
+{
+    float basisU[BSplineBasis::MaxDegree + 1], derivativesU[BSplineBasis::MaxDegree + 1];
+    float basisV[BSplineBasis::MaxDegree + 1], derivativesV[BSplineBasis::MaxDegree + 1];
+    ComputeBernstein(degreeU, u, basisU, derivativesU);
+    ComputeBernstein(degreeV, v, basisV, derivativesV);
+
+    glm::vec4 point(0.0f), pointU(0.0f), pointV(0.0f);
+    for (int i = 0; i <= degreeU; i++)
+    {
+        const glm::vec4 *row = net + i * (degreeV + 1);
+
+        glm::vec4 rowPoint(0.0f), rowDerivative(0.0f);
+        for (int j = 0; j <= degreeV; j++)
+        {
+            rowPoint += basisV[j] * row[j];
+            rowDerivative += derivativesV[j] * row[j];
+        }
+
+        point += basisU[i] * rowPoint;
+        pointU += derivativesU[i] * rowPoint;
+        pointV += basisU[i] * rowDerivative;
+    }
+
+    // quotient rule of the rational patch
+    position = glm::vec3(point) / point.w;
+    derivativeU = (glm::vec3(pointU) - pointU.w * position) / point.w;
+    derivativeV = (glm::vec3(pointV) - pointV.w * position) / point.w;
+}
+
+/**
+ * @brief Split a Bezier curve in two with the de Casteljau algorithm
+ * @param points The degree + 1 control points, stride apart
+ * @param t Where to split, between 0 and 1
+ * @param left Output, the control points of [0, t], stride apart
+ * @param right Output, the control points of [t, 1], stride apart
+ */
+static void SplitBezier(const glm::vec4 *points, int stride, uint8_t degree, float t, glm::vec4 *left, glm::vec4 *right)
+{
+    glm::vec4 levels[BSplineBasis::MaxDegree + 1];
+    for (int i = 0; i <= degree; i++)
+        levels[i] = points[i * stride];
+
+    left[0] = levels[0];
+    right[degree * stride] = levels[degree];
+    for (int r = 1; r <= degree; r++)
+    {
+        for (int i = 0; i <= degree - r; i++)
+            levels[i] = (1.0f - t) * levels[i] + t * levels[i + 1];
+        left[r * stride] = levels[0];
+        right[(degree - r) * stride] = levels[degree - r];
+    }
+}
+
+/**
+ * @brief The control points of the part [t0, t1] of a Bezier curve
+ * @param points The degree + 1 control points, stride apart
+ * @param out Output, degree + 1 control points, stride apart
+ */
+static void RestrictBezier(const glm::vec4 *points, int stride, uint8_t degree, float t0, float t1, glm::vec4 *out)
+{
+    glm::vec4 left[BSplineBasis::MaxDegree + 1], right[BSplineBasis::MaxDegree + 1];
+    for (int i = 0; i <= degree; i++)
+        right[i] = points[i * stride];
+
+    // [t0, 1], then its part up to t1
+    if (t0 > 0.0f)
+        SplitBezier(right, 1, degree, t0, left, right);
+    if (t1 < 1.0f)
+        SplitBezier(right, 1, degree, (t1 - t0) / (1.0f - t0), right, left);
+
+    for (int i = 0; i <= degree; i++)
+        out[i * stride] = right[i];
+}
+
+/**
+ * @brief The control net of the part [u0, u1] x [v0, v1] of a Bezier patch
+ * @param out Output, (degreeU + 1) x (degreeV + 1) control points row major
+ */
+static void RestrictNet(const glm::vec4 *net, uint8_t degreeU, uint8_t degreeV, float u0, float u1, float v0, float v1, glm::vec4 *out)
+{
+    int stride = degreeV + 1;
+    glm::vec4 columns[NetCapacity];
+    for (int j = 0; j <= degreeV; j++)
+        RestrictBezier(net + j, stride, degreeU, u0, u1, columns + j);
+    for (int i = 0; i <= degreeU; i++)
+        RestrictBezier(columns + i * stride, 1, degreeV, v0, v1, out + i * stride);
+}
+
+/**
+ * @brief Split a Bezier patch in its four halves
+ * @param children Output, the nets of (low u, low v), (high u, low v), (low u, high v) and (high u, high v) one after the other
+ */
+static void SplitNet(const glm::vec4 *net, uint8_t degreeU, uint8_t degreeV, glm::vec4 *children)
+{
+    int stride = degreeV + 1;
+    int netSize = (degreeU + 1) * stride;
+
+    glm::vec4 halves[2 * NetCapacity];
+    for (int j = 0; j <= degreeV; j++)
+        SplitBezier(net + j, stride, degreeU, 0.5f, halves + j, halves + netSize + j);
+    for (int half = 0; half < 2; half++)
+        for (int i = 0; i <= degreeU; i++)
+            SplitBezier(halves + half * netSize + i * stride, 1, degreeV, 0.5f, children + half * netSize + i * stride,
+                        children + (half + 2) * netSize + i * stride);
+}
+
+/**
+ * @brief Deviation of a control net from the plane of its corners (the plane of its diagonals through their center)
+ * @note With positive weights the patch is in the box of its projected control points
+ * @param bounds Output, the box of the projected control points
+ * @return The deviation, infinite if the diagonals are parallel
+ */
+static float MeasureNet(const glm::vec4 *net, uint8_t degreeU, uint8_t degreeV, SmartGL::Maths::BoundingBox &bounds)
+{
+    int stride = degreeV + 1;
+    auto project = [net, stride](int i, int j)
+    { return glm::vec3(net[i * stride + j]) / net[i * stride + j].w; };
+
+    glm::vec3 corners[4] = {project(0, 0), project(degreeU, 0), project(degreeU, degreeV), project(0, degreeV)};
+    glm::vec3 center = 0.25f * (corners[0] + corners[1] + corners[2] + corners[3]);
+    glm::vec3 normal = glm::cross(corners[2] - corners[0], corners[3] - corners[1]);
+    float normalLength = glm::length(normal);
+
+    float deviation = normalLength > 0.0f ? 0.0f : std::numeric_limits<float>::max();
+    for (int i = 0; i <= degreeU; i++)
+        for (int j = 0; j <= degreeV; j++)
+        {
+            glm::vec3 point = project(i, j);
+            if (normalLength > 0.0f)
+                deviation = glm::max(deviation, glm::abs(glm::dot(point - center, normal)) / normalLength);
+            bounds.Expand(point);
+        }
+    return deviation;
+}
+
+/**
+ * @brief Intersect a ray with a triangle (Moller-Trumbore), both faces
+ * @param b1 Output, the barycentric coordinate of b
+ * @param b2 Output, the barycentric coordinate of c
+ * @return False if the ray misses the triangle or is parallel to it
+ */
+static bool IntersectTriangle(const glm::vec3 &origin, const glm::vec3 &direction, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, float &b1, float &b2)
+{
+    glm::vec3 edge1 = b - a;
+    glm::vec3 edge2 = c - a;
+    glm::vec3 p = glm::cross(direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (glm::abs(determinant) < 1e-12f)
+        return false;
+
+    float inverse = 1.0f / determinant;
+    glm::vec3 offset = origin - a;
+    b1 = glm::dot(offset, p) * inverse;
+    glm::vec3 q = glm::cross(offset, edge1);
+    b2 = glm::dot(direction, q) * inverse;
+    return b1 >= 0.0f && b2 >= 0.0f && b1 + b2 <= 1.0f;
+}
+
+/**
+ * @brief Find the hit of a ray on a flat net, from its corners quad then with Newton steps
+ * @note The ray is the intersection of two planes, the hit is a zero of the distances of the patch to both
+ * @param u0, u1, v0, v1 The part of the patch covered by the net
+ * @param distance Input, the distance of the best hit so far, output the distance of the hit on the net if it is closer
+ * @param u Output, the parameter of the hit on the patch if it is closer
+ * @param v Output, the parameter of the hit on the patch if it is closer
+ */
+static bool IntersectFlatNet(const PatchRay &ray, const glm::vec4 *net, float u0, float u1, float v0, float v1, float diagonal, float &distance, float &u, float &v)
+{
+    int stride = ray.DegreeV + 1;
+    auto project = [net, stride](int i, int j)
+    { return glm::vec3(net[i * stride + j]) / net[i * stride + j].w; };
+    glm::vec3 corners[4] = {project(0, 0), project(ray.DegreeU, 0), project(ray.DegreeU, ray.DegreeV), project(0, ray.DegreeV)};
+
+    // first guess from the two triangles of the corners, the center of the net if the ray misses them
+    float b1, b2;
+    float s = 0.5f, t = 0.5f;
+    if (IntersectTriangle(ray.Origin, ray.Direction, corners[0], corners[1], corners[2], b1, b2))
+    {
+        s = b1 + b2;
+        t = b2;
+    }
+    else if (IntersectTriangle(ray.Origin, ray.Direction, corners[0], corners[2], corners[3], b1, b2))
+    {
+        s = b1;
+        t = b1 + b2;
+    }
+
+    // the steps stay on the net and its margin, but not beyond the patch
+    float lowS = glm::max(-NetMargin, -u0 / (u1 - u0)), highS = glm::min(1.0f + NetMargin, (1.0f - u0) / (u1 - u0));
+    float lowT = glm::max(-NetMargin, -v0 / (v1 - v0)), highT = glm::min(1.0f + NetMargin, (1.0f - v0) / (v1 - v0));
+    float tolerance = RayHitTolerance * diagonal + 1e-6f * glm::length(corners[0] - ray.Origin);
+
+    glm::vec3 position, derivativeS, derivativeT;
+    for (int step = 0; step <= RayNewtonSteps; step++)
+    {
+        EvaluatePatch(net, ray.DegreeU, ray.DegreeV, s, t, position, derivativeS, derivativeT);
+        glm::vec3 offset = position - ray.Origin;
+        glm::vec2 residual(glm::dot(ray.Normal1, offset), glm::dot(ray.Normal2, offset));
+
+        if (glm::length(residual) <= tolerance)
+        {
+            float hitDistance = glm::dot(offset, ray.Direction);
+            if (hitDistance < 0.0f || hitDistance >= distance)
+                return false;
+
+            distance = hitDistance;
+            u = u0 + s * (u1 - u0);
+            v = v0 + t * (v1 - v0);
+            return true;
+        }
+
+        // J = [n1.Ss n1.St; n2.Ss n2.St], the step solves J d = residual
+        float j11 = glm::dot(ray.Normal1, derivativeS), j12 = glm::dot(ray.Normal1, derivativeT);
+        float j21 = glm::dot(ray.Normal2, derivativeS), j22 = glm::dot(ray.Normal2, derivativeT);
+        float determinant = j11 * j22 - j12 * j21;
+        if (step == RayNewtonSteps || glm::abs(determinant) < 1e-20f)
+            break;
+
+        s = glm::clamp(s - (j22 * residual.x - j12 * residual.y) / determinant, lowS, highS);
+        t = glm::clamp(t - (j11 * residual.y - j21 * residual.x) / determinant, lowT, highT);
+    }
+
+    return false;
+}
+
+/**
+ * @brief Find the first hit of a ray on a part of a patch, its net is cut until it is flat (Bezier subdivision)
+ * @note The part is in the convex hull of its projected control points: seen along the ray they must surround it,
+ * and along the ray at least one of them must be in front of the origin and one before the best hit so far.
+ * The halves are visited nearest first
+ * @param u0, u1, v0, v1 The part of the patch covered by the net
+ * @param depth The number of subdivisions of the net
+ */
+static bool IntersectNet(const PatchRay &ray, const glm::vec4 *net, float u0, float u1, float v0, float v1, int depth, float &distance, float &u, float &v)
+{
+    int netSize = (ray.DegreeU + 1) * (ray.DegreeV + 1);
+
+    glm::vec2 low(std::numeric_limits<float>::max()), high(-std::numeric_limits<float>::max());
+    float nearest = std::numeric_limits<float>::max(), farthest = -std::numeric_limits<float>::max();
+    for (int k = 0; k < netSize; k++)
+    {
+        glm::vec3 offset = glm::vec3(net[k]) / net[k].w - ray.Origin;
+        glm::vec2 projected(glm::dot(ray.Normal1, offset), glm::dot(ray.Normal2, offset));
+        low = glm::min(low, projected);
+        high = glm::max(high, projected);
+        float along = glm::dot(ray.Direction, offset);
+        nearest = glm::min(nearest, along);
+        farthest = glm::max(farthest, along);
+    }
+    if (low.x > 0.0f || high.x < 0.0f || low.y > 0.0f || high.y < 0.0f || nearest >= distance || farthest < 0.0f)
+        return false;
+
+    SmartGL::Maths::BoundingBox bounds;
+    float deviation = MeasureNet(net, ray.DegreeU, ray.DegreeV, bounds);
+    float diagonal = glm::length(bounds.GetSize());
+    if (depth >= MaxRaySubdivisions || deviation <= RayFlatness * diagonal)
+        return IntersectFlatNet(ray, net, u0, u1, v0, v1, diagonal, distance, u, v);
+
+    glm::vec4 children[4 * NetCapacity];
+    SplitNet(net, ray.DegreeU, ray.DegreeV, children);
+
+    // the halves by the distance along the ray of their nearest control point
+    float uMiddle = 0.5f * (u0 + u1), vMiddle = 0.5f * (v0 + v1);
+    float ranges[4][4] = {{u0, uMiddle, v0, vMiddle}, {uMiddle, u1, v0, vMiddle}, {u0, uMiddle, vMiddle, v1}, {uMiddle, u1, vMiddle, v1}};
+    std::pair<float, int> order[4];
+    for (int child = 0; child < 4; child++)
+    {
+        float childNearest = std::numeric_limits<float>::max();
+        for (int k = 0; k < netSize; k++)
+            childNearest = glm::min(childNearest, glm::dot(ray.Direction, glm::vec3(children[child * netSize + k]) / children[child * netSize + k].w - ray.Origin));
+        order[child] = {childNearest, child};
+    }
+    std::sort(order, order + 4);
+
+    bool found = false;
+    for (const auto &[childNearest, child] : order)
+    {
+        if (childNearest >= distance)
+            break;
+        const float *range = ranges[child];
+        found |= IntersectNet(ray, children + child * netSize, range[0], range[1], range[2], range[3], depth + 1, distance, u, v);
+    }
+    return found;
+}
+
+bool SurfacePatchHierarchy::Update(const BSplineSurface &surface)
+{
+    if (&surface == m_Surface && surface.GetVersion() == m_SurfaceVersion)
+        return false;
+
+    m_Surface = &surface;
+    m_SurfaceVersion = surface.GetVersion();
+
+    m_BezierPoints.clear();
+    m_Patches.clear();
+    m_Pieces.clear();
+    m_PiecesBounds.clear();
+
+    const BSplineSurfaceAttributes &attributes = surface.GetAttributes();
+    const std::vector<glm::vec4> &controlPoints = surface.GetHomogeneousControlPoints();
+    int nbControlPointsU = surface.GetControlPoints().size();
+    int nbControlPointsV = nbControlPointsU > 0 ? surface.GetControlPoints()[0].size() : 0;
+    m_DegreeU = attributes.U.Degree;
+    m_DegreeV = attributes.V.Degree;
+
+    if (nbControlPointsU <= m_DegreeU || nbControlPointsV <= m_DegreeV || attributes.U.Knots.size() != (std::size_t)(nbControlPointsU + m_DegreeU + 1) ||
+        attributes.V.Knots.size() != (std::size_t)(nbControlPointsV + m_DegreeV + 1))
+    {
+        BuildTree();
+        return true;
+    }
+
+    // the non-empty spans, the patches follow the Morton order of their spans
+    const std::vector<float> &knotsU = attributes.U.Knots;
+    const std::vector<float> &knotsV = attributes.V.Knots;
+    std::vector<int> spansU, spansV;
+    for (int span = m_DegreeU; span < nbControlPointsU; span++)
+        if (knotsU[span + 1] > knotsU[span])
+            spansU.push_back(span);
+    for (int span = m_DegreeV; span < nbControlPointsV; span++)
+        if (knotsV[span + 1] > knotsV[span])
+            spansV.push_back(span);
+
+    std::vector<std::pair<uint64_t, glm::ivec2>> order;
+    order.reserve(spansU.size() * spansV.size());
+    for (uint32_t i = 0; i < spansU.size(); i++)
+        for (uint32_t j = 0; j < spansV.size(); j++)
+            order.push_back({MortonCode(i, j), glm::ivec2(spansU[i], spansV[j])});
+    std::sort(order.begin(), order.end(), [](const auto &a, const auto &b)
+              { return a.first < b.first; });
+
+    uint32_t netSize = (m_DegreeU + 1) * (m_DegreeV + 1);
+    m_BezierPoints.resize(order.size() * netSize);
+    m_Patches.reserve(order.size());
+    m_ScratchColumn.resize(nbControlPointsU);
+    m_ScratchRows.resize(netSize);
+
+    for (const auto &[code, spans] : order)
+    {
+        int spanU = spans.x, spanV = spans.y;
+        BezierPatch patch = {(uint32_t)(m_Patches.size() * netSize), knotsU[spanU], knotsU[spanU + 1], knotsV[spanV], knotsV[spanV + 1]};
+        glm::vec4 *net = m_BezierPoints.data() + patch.FirstPoint;
+
+        // the Bezier form of each control row of the span along v, then of each column of these rows along u
+        for (int r = 0; r <= m_DegreeU; r++)
+            BSplineBasis::ExtractBezierSegment(knotsV, controlPoints.data() + (spanU - m_DegreeU + r) * nbControlPointsV, spanV, m_DegreeV,
+                                               m_ScratchRows.data() + r * (m_DegreeV + 1));
+
+        glm::vec4 column[BSplineBasis::MaxDegree + 1];
+        for (int c = 0; c <= m_DegreeV; c++)
+        {
+            for (int r = 0; r <= m_DegreeU; r++)
+                m_ScratchColumn[spanU - m_DegreeU + r] = m_ScratchRows[r * (m_DegreeV + 1) + c];
+            BSplineBasis::ExtractBezierSegment(knotsU, m_ScratchColumn.data(), spanU, m_DegreeU, column);
+            for (int r = 0; r <= m_DegreeU; r++)
+                net[r * (m_DegreeV + 1) + c] = column[r];
+        }
+
+        m_Patches.push_back(patch);
+        Subdivide(m_Patches.size() - 1, net, 0.0f, 1.0f, 0.0f, 1.0f, 0);
+    }
+
+    BuildTree();
+    return true;
+}
+
+void SurfacePatchHierarchy::Subdivide(uint32_t patch, const glm::vec4 *net, float u0, float u1, float v0, float v1, int depth)
+{
+    SmartGL::Maths::BoundingBox bounds;
+    float deviation = MeasureNet(net, m_DegreeU, m_DegreeV, bounds);
+    if (depth >= MaxPieceDepth || deviation <= PieceFlatness * glm::length(bounds.GetSize()))
+    {
+        m_Pieces.push_back({patch, u0, u1, v0, v1});
+        m_PiecesBounds.push_back(bounds);
+        return;
+    }
+
+    int netSize = (m_DegreeU + 1) * (m_DegreeV + 1);
+    std::vector<glm::vec4> children(4 * netSize);
+    SplitNet(net, m_DegreeU, m_DegreeV, children.data());
+
+    float uMiddle = 0.5f * (u0 + u1), vMiddle = 0.5f * (v0 + v1);
+    Subdivide(patch, children.data(), u0, uMiddle, v0, vMiddle, depth + 1);
+    Subdivide(patch, children.data() + netSize, uMiddle, u1, v0, vMiddle, depth + 1);
+    Subdivide(patch, children.data() + 2 * netSize, u0, uMiddle, vMiddle, v1, depth + 1);
+    Subdivide(patch, children.data() + 3 * netSize, uMiddle, u1, vMiddle, v1, depth + 1);
+}
+
+void SurfacePatchHierarchy::BuildTree()
+{
+    int nbPieces = m_Pieces.size();
+    int nbLeaves = 1;
+    while (nbLeaves < nbPieces)
+        nbLeaves *= 2;
+
+    m_Tree.assign(2 * nbLeaves, SmartGL::Maths::BoundingBox());
+    std::copy(m_PiecesBounds.begin(), m_PiecesBounds.end(), m_Tree.begin() + nbLeaves);
+    for (int node = nbLeaves - 1; node >= 1; node--)
+    {
+        m_Tree[node] = m_Tree[2 * node];
+        m_Tree[node].Expand(m_Tree[2 * node + 1]);
+    }
+}
+
+bool SurfacePatchHierarchy::IntersectPiece(const PatchPiece &piece, const PatchRay &ray, float &distance, float &u, float &v) const
+{
+    glm::vec4 net[NetCapacity];
+    RestrictNet(m_BezierPoints.data() + m_Patches[piece.Patch].FirstPoint, m_DegreeU, m_DegreeV, piece.U0, piece.U1, piece.V0, piece.V1, net);
+    return IntersectNet(ray, net, piece.U0, piece.U1, piece.V0, piece.V1, 0, distance, u, v);
+}
+
+SurfaceRayHit SurfacePatchHierarchy::Intersect(const glm::vec3 &origin, const glm::vec3 &direction) const
+{
+    SurfaceRayHit hit = {false, 0.0f, 0.0f, glm::vec3(0.0f), std::numeric_limits<float>::max()};
+    if (m_Pieces.empty())
+        return hit;
+
+    int nbLeaves = m_Tree.size() / 2;
+    glm::vec3 inverseDirection = 1.0f / direction;
+
+    float bestDistance = std::numeric_limits<float>::max();
+    float bestU = 0.0f, bestV = 0.0f;
+    int bestPiece = -1;
+
+    // the ray is the intersection of two planes, the hits are the zeros of the distances of the patches to both
+    glm::vec3 normal = glm::abs(direction.x) > glm::abs(direction.y) ? glm::vec3(direction.z, 0.0f, -direction.x) : glm::vec3(0.0f, direction.z, -direction.y);
+    normal = glm::normalize(normal);
+    PatchRay ray = {origin, direction, normal, glm::cross(direction, normal), m_DegreeU, m_DegreeV};
+
+    // depth first, the nearest child is visited first and the other one kept with its entry distance
+    struct Node
+    {
+        int Index;
+        float Enter;
+    };
+    Node stack[64];
+    int stackSize = 0;
+
+    float enter;
+    if (m_Tree[1].IntersectRay(origin, inverseDirection, bestDistance, enter))
+        stack[stackSize++] = {1, enter};
+
+    while (stackSize > 0)
+    {
+        Node node = stack[--stackSize];
+        if (node.Enter >= bestDistance)
+            continue;
+
+        if (node.Index >= nbLeaves)
+        {
+            int piece = node.Index - nbLeaves;
+            if (IntersectPiece(m_Pieces[piece], ray, bestDistance, bestU, bestV))
+                bestPiece = piece;
+            continue;
+        }
+
+        Node children[2];
+        int nbChildren = 0;
+        for (int child = 2 * node.Index; child <= 2 * node.Index + 1; child++)
+            if (m_Tree[child].IntersectRay(origin, inverseDirection, bestDistance, enter))
+                children[nbChildren++] = {child, enter};
+
+        if (nbChildren == 2 && children[0].Enter < children[1].Enter)
+            std::swap(children[0], children[1]);
+        for (int child = 0; child < nbChildren; child++)
+            stack[stackSize++] = children[child];
+    }
+
+    if (bestPiece < 0)
+        return hit;
+
+    const BezierPatch &patch = m_Patches[m_Pieces[bestPiece].Patch];
+    glm::vec3 derivativeU, derivativeV;
+    EvaluatePatch(m_BezierPoints.data() + patch.FirstPoint, m_DegreeU, m_DegreeV, bestU, bestV, hit.Position, derivativeU, derivativeV);
+
+    hit.Hit = true;
+    hit.U = patch.StartU + bestU * (patch.EndU - patch.StartU);
+    hit.V = patch.StartV + bestV * (patch.EndV - patch.StartV);
+    hit.Distance = bestDistance;
+    return hit;
+}
+
+void SurfacePatchHierarchy::Intersect(const glm::vec3 *origins, const glm::vec3 *directions, SurfaceRayHit *out, std::size_t count) const
+{
+    SmartGL::Core::JobSystem::ParallelFor(count, RayQueriesPerJob, [&](uint32_t begin, uint32_t end)
+                                          {
+                                              for (uint32_t i = begin; i < end; i++)
+                                                  out[i] = Intersect(origins[i], directions[i]);
+                                          });
+}
+
+void SurfacePatchHierarchy::Intersect(const std::vector<glm::vec3> &origins, const std::vector<glm::vec3> &directions, std::vector<SurfaceRayHit> &out) const
+{
+    SMART_ASSERT(origins.size() == directions.size(), "One direction per origin is expected");
+    out.resize(origins.size());
+    Intersect(origins.data(), directions.data(), out.data(), origins.size());
+}
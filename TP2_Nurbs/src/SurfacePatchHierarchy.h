@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "SmartGL.h"
+#include "BSplineSurface.h"
+
+/**
+ * @brief Result of a ray query on a surface
+ */
+struct SurfaceRayHit
+{
+    bool Hit;           // false if the ray misses the surface, the other members are then meaningless
+    float U;            // parameters of the hit point
+    float V;
+    glm::vec3 Position; // hit point
+    float Distance;     // distance along the ray of the hit point
+};
+
+struct PatchRay;
+
+/**
+ * @brief The surface cut in rational Bezier patches, one per pair of non-empty knot spans, with a hierarchy of boxes for ray queries
+ * @note Each patch is subdivided (de Casteljau) into pieces until their control net is nearly planar, the box of the projected control points
+ * of a piece contains it (convex hull property, valid for positive weights). The boxes of the pieces are stored in an implicit
+ * complete binary tree, the pieces of a patch and the patches following a Morton order so that neighbouring pieces share subtrees.
+ * A ray walks the tree nearest box first. The net of a piece it enters is cut again, nearest half first, while the ray crosses
+ * the hull of the net and the net is not flat (Bezier subdivision), then the hit is found with Newton steps from the corners quad.
+ * The patches are extracted again when the surface changes (see BSplineSurface::GetVersion).
+ */
+class SurfacePatchHierarchy
+{
+public:
+    SurfacePatchHierarchy() = default;
+    ~SurfacePatchHierarchy() = default;
+
+    /**
+     * @brief Extract the patches and build the hierarchy if the surface changed since the last call
+     * @return True if the hierarchy was rebuilt
+     */
+    bool Update(const BSplineSurface &surface);
+
+    /**
+     * @brief Find the first hit of a ray on the surface
+     * @param origin The origin of the ray
+     * @param direction The normalized direction of the ray
+     */
+    SurfaceRayHit Intersect(const glm::vec3 &origin, const glm::vec3 &direction) const;
+
+    /**
+     * @brief Intersect of many rays, large batches are split between the threads of the job system
+     * @param origins The origins of the rays
+     * @param directions The normalized directions of the rays
+     * @param out Output, count hits
+     * @param count
+     */
+    void Intersect(const glm::vec3 *origins, const glm::vec3 *directions, SurfaceRayHit *out, std::size_t count) const;
+
+    /**
+     * @brief Same as above on vectors, out is resized to the number of rays
+     */
+    void Intersect(const std::vector<glm::vec3> &origins, const std::vector<glm::vec3> &directions, std::vector<SurfaceRayHit> &out) const;
+
+    inline std::size_t GetPatchesCount() const { return m_Patches.size(); }
+    inline std::size_t GetPiecesCount() const { return m_Pieces.size(); }
+
+private:
+    /**
+     * @brief A rational Bezier patch, (degreeU + 1) x (degreeV + 1) homogeneous control points row major from FirstPoint
+     */
+    struct BezierPatch
+    {
+        uint32_t FirstPoint;
+        float StartU, EndU; // the knot spans of the patch
+        float StartV, EndV;
+    };
+
+    /**
+     * @brief A nearly planar piece of a patch, [U0, U1] x [V0, V1] in the parameters of the patch (0 to 1)
+     */
+    struct PatchPiece
+    {
+        uint32_t Patch;
+        float U0, U1;
+        float V0, V1;
+    };
+
+    /**
+     * @brief Cut a patch in nearly flat pieces, in Morton order
+     * @param net The homogeneous control net of the piece
+     * @param depth The number of subdivisions of the piece
+     */
+    void Subdivide(uint32_t patch, const glm::vec4 *net, float u0, float u1, float v0, float v1, int depth);
+
+    /**
+     * @brief Find the first hit of a ray on a piece
+     * @param distance Input, the distance of the best hit so far, output the distance of the hit on the piece if it is closer
+     * @param u Output, the parameter of the hit on the patch (0 to 1) if it is closer
+     * @param v Output, the parameter of the hit on the patch (0 to 1) if it is closer
+     * @return True if the piece has a hit closer than distance
+     */
+    bool IntersectPiece(const PatchPiece &piece, const PatchRay &ray, float &distance, float &u, float &v) const;
+
+    /**
+     * @brief Build the boxes of the tree from the boxes of the pieces
+     */
+    void BuildTree();
+
+private:
+    std::vector<glm::vec4> m_BezierPoints;
+    std::vector<BezierPatch> m_Patches;
+    std::vector<PatchPiece> m_Pieces;
+    std::vector<SmartGL::Maths::BoundingBox> m_PiecesBounds;
+    std::vector<SmartGL::Maths::BoundingBox> m_Tree; // node n has the children 2n and 2n + 1, the pieces are the leaves from the middle
+
+    // reused by Update: a column of the net and the control rows of a patch after the extraction along v
+    std::vector<glm::vec4> m_ScratchColumn;
+    std::vector<glm::vec4> m_ScratchRows;
+
+    uint8_t m_DegreeU = 0;
+    uint8_t m_DegreeV = 0;
+
+    // what the hierarchy was built from
+    const BSplineSurface *m_Surface = nullptr;
+    uint64_t m_SurfaceVersion = 0;
+};
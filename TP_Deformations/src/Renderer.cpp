@@ -56,8 +56,9 @@ namespace TP_Deformations
 
         Shared<Shader> BlinnPhongShader;
 
-        const int MaxGeometryVerticesCount = 10000;
-        const int MaxGeometryIndicesCount = 10000;
+        // initial capacities of the geometry buffers, they grow with the geometry
+        const int InitialGeometryVerticesCount = 10000;
+        const int InitialGeometryIndicesCount = 10000;
         int GeometryIndicesCount = 0;
     };
 
@@ -110,13 +111,13 @@ namespace TP_Deformations
         }
 
         { // Vao and buffers geometry pass
-            s_Data.GeometryBuffers.Vbo = CreateShared<VertexBuffer>(s_Data.MaxGeometryVerticesCount * sizeof(float));
+            s_Data.GeometryBuffers.Vbo = CreateShared<VertexBuffer>(s_Data.InitialGeometryVerticesCount * 8 * sizeof(float));
             s_Data.GeometryBuffers.Vbo->SetLayout({{ShaderDataType::Float3, "a_Position"},
                                                    {ShaderDataType::Float3, "a_Normal"},
                                                    {ShaderDataType::Float2, "a_TexCoord"}});
             s_Data.GeometryBuffers.Vao->AddVertexBuffer(s_Data.GeometryBuffers.Vbo);
 
-            s_Data.GeometryBuffers.Ibo = CreateShared<IndexBuffer>(s_Data.MaxGeometryIndicesCount);
+            s_Data.GeometryBuffers.Ibo = CreateShared<IndexBuffer>(s_Data.InitialGeometryIndicesCount);
             s_Data.GeometryBuffers.Vao->SetIndexBuffer(s_Data.GeometryBuffers.Ibo);
         }
 
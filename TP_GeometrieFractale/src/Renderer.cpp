@@ -8,10 +8,10 @@ namespace TP_GeometrieFractale
 {
     struct RendererData
     {
-        // used to initialize the mountain vbo and ibo
-        // with enough space if user add iterations to the mountain
-        const uint32_t MaxVertices = 10000;
-        const uint32_t MaxIndices = MaxVertices * 3;
+        // initial capacities of the mountain vbo and ibo,
+        // they grow if the user adds iterations to the mountain
+        const uint32_t InitialVertices = 10000;
+        const uint32_t InitialIndices = InitialVertices * 3;
 
         // mountain and sea buffers
         struct Buffers
@@ -86,13 +86,13 @@ namespace TP_GeometrieFractale
         { // init mountain buffers
             s_Data.MountainBuffers.Vao = CreateShared<VertexArray>();
 
-            uint32_t size = s_Data.MaxVertices * sizeof(float) * 2;
+            uint32_t size = s_Data.InitialVertices * sizeof(float) * 6;
             s_Data.MountainBuffers.Vbo = CreateShared<VertexBuffer>(size);
             s_Data.MountainBuffers.Vbo->SetLayout({{ShaderDataType::Float3, "a_Position"},
                                                    {ShaderDataType::Float3, "a_Normal"}});
             s_Data.MountainBuffers.Vao->AddVertexBuffer(s_Data.MountainBuffers.Vbo);
 
-            uint32_t count = s_Data.MaxIndices;
+            uint32_t count = s_Data.InitialIndices;
             s_Data.MountainBuffers.Ibo = CreateShared<IndexBuffer>(count);
             s_Data.MountainBuffers.Vao->SetIndexBuffer(s_Data.MountainBuffers.Ibo);
 